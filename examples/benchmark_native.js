@@ -0,0 +1,87 @@
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const { execSync } = require('child_process');
+
+// Per-pass microbenchmarks for the native C and C++ processors.
+//
+// Usage: node examples/benchmark_native.js [--out=FILE] [--sizes=KB,KB,...] [--iterations=N]
+//
+// Builds examples/benchmarks/*_processor_bench with the system compilers,
+// runs them and writes one JSON file (default: benchmark-results.json) with
+// the commit it was measured on, so results can be diffed across commits.
+
+const rootDir = path.join(__dirname, '..');
+const benchDir = path.join(__dirname, 'benchmarks');
+
+const benchmarks = [
+  {
+    name: 'c',
+    source: 'c_processor_bench.c',
+    compile: (source, binary) => `gcc -O2 -DPROCESSOR_NO_MAIN "${source}" -o "${binary}" -lcrypto -pthread`
+  },
+  {
+    name: 'cpp',
+    source: 'cpp_processor_bench.cpp',
+    compile: (source, binary) => `g++ -std=c++17 -O2 -DPROCESSOR_NO_MAIN "${source}" -o "${binary}" -lcrypto -pthread`
+  }
+];
+
+function parseArgs(argv) {
+  const args = { out: path.join(rootDir, 'benchmark-results.json'), passThrough: [] };
+  for (const arg of argv) {
+    if (arg.startsWith('--out=')) {
+      args.out = path.resolve(arg.slice('--out='.length));
+    } else if (arg.startsWith('--sizes=') || arg.startsWith('--iterations=')) {
+      args.passThrough.push(arg);
+    }
+  }
+  return args;
+}
+
+function gitCommit() {
+  try {
+    return execSync('git rev-parse HEAD', { cwd: rootDir, stdio: ['ignore', 'pipe', 'ignore'] }).toString().trim();
+  } catch (error) {
+    return null;
+  }
+}
+
+function runBenchmark(benchmark, buildDir, passThrough) {
+  const source = path.join(benchDir, benchmark.source);
+  const binary = path.join(buildDir, `${benchmark.name}_processor_bench`);
+  const json = path.join(buildDir, `${benchmark.name}.json`);
+
+  console.log(`Building ${benchmark.source}...`);
+  execSync(benchmark.compile(source, binary), { stdio: 'inherit' });
+
+  console.log(`Running ${benchmark.name} benchmark...`);
+  execSync(`"${binary}" --json="${json}" ${passThrough.join(' ')}`, { stdio: 'inherit' });
+  return JSON.parse(fs.readFileSync(json, 'utf8'));
+}
+
+function main() {
+  const args = parseArgs(process.argv.slice(2));
+  const buildDir = fs.mkdtempSync(path.join(os.tmpdir(), 'obfuscator-bench-'));
+
+  const report = {
+    commit: gitCommit(),
+    date: new Date().toISOString(),
+    host: { platform: os.platform(), arch: os.arch(), cpus: os.cpus().length, cpu: os.cpus()[0] && os.cpus()[0].model },
+    results: []
+  };
+
+  try {
+    for (const benchmark of benchmarks) {
+      report.results.push(...runBenchmark(benchmark, buildDir, args.passThrough));
+      console.log('');
+    }
+  } finally {
+    fs.rmSync(buildDir, { recursive: true, force: true });
+  }
+
+  fs.writeFileSync(args.out, JSON.stringify(report, null, 2) + '\n');
+  console.log(`Results written to ${args.out}`);
+}
+
+main();
@@ -0,0 +1,241 @@
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const { execSync, spawnSync } = require('child_process');
+
+// Runtime cost of obfuscation for the native C and C++ processors.
+//
+// Usage: node examples/benchmark_runtime.js [--out=FILE] [--iterations=N] [--runs=N]
+//
+// Each sample under examples/benchmarks/samples is obfuscated once per
+// feature (--passes=<feature>) and once with every pass. The original and
+// every variant are compiled with the local compiler. Each build is then
+// measured for startup time (a run with no work), steady-state throughput
+// (the sample's timed loop) and binary size. Results are written as JSON
+// (default: runtime-results.json) with deltas against the original build,
+// and the measured slowdowns of the two --profile protection levels, to be
+// passed as --full-cost and --light-cost.
+
+const rootDir = path.join(__dirname, '..');
+const samplesDir = path.join(__dirname, 'benchmarks', 'samples');
+
+const processors = {
+  c: {
+    source: 'src/processors/CProcessor.c',
+    sample: 'runtime_sample.c',
+    build: (source, binary) => `gcc -O2 "${source}" -o "${binary}" -lcrypto -pthread`,
+    compile: (source, binary) => `gcc -std=c11 -O2 "${source}" -o "${binary}" -lcrypto -pthread`
+  },
+  cpp: {
+    source: 'src/processors/CppProcessor.cpp',
+    sample: 'runtime_sample.cpp',
+    // The sample calls library members such as size and count
+    flags: `--preserve="${path.join(rootDir, 'src/processors/cpp_library_names.txt')}"`,
+    build: (source, binary) => `g++ -std=c++17 -O2 "${source}" -o "${binary}" -lcrypto -pthread`,
+    compile: (source, binary) => `g++ -std=c++17 -O2 "${source}" -o "${binary}" -lcrypto -pthread`
+  }
+};
+
+// Features measured on their own, plus the full pipeline
+const variants = [
+  { name: 'original', passes: null },
+  { name: 'strings', passes: 'strings' },
+  { name: 'deadcode', passes: 'deadcode' },
+  { name: 'controlflow', passes: 'controlflow' },
+  { name: 'antidebug', passes: 'antidebug' },
+  { name: 'antidebug-monitor', passes: 'antidebug', flags: '--anti-debug=monitor' },
+  { name: 'all', passes: 'strings,identifiers,controlflow,deadcode,antidebug' }
+];
+
+function parseArgs(argv) {
+  const args = { out: path.join(rootDir, 'runtime-results.json'), iterations: 5000000, runs: 5 };
+  for (const arg of argv) {
+    if (arg.startsWith('--out=')) {
+      args.out = path.resolve(arg.slice('--out='.length));
+    } else if (arg.startsWith('--iterations=')) {
+      args.iterations = Math.max(1, parseInt(arg.slice('--iterations='.length), 10));
+    } else if (arg.startsWith('--runs=')) {
+      args.runs = Math.max(1, parseInt(arg.slice('--runs='.length), 10));
+    }
+  }
+  return args;
+}
+
+function gitCommit() {
+  try {
+    return execSync('git rev-parse HEAD', { cwd: rootDir, stdio: ['ignore', 'pipe', 'ignore'] }).toString().trim();
+  } catch (error) {
+    return null;
+  }
+}
+
+function median(values) {
+  const sorted = [...values].sort((a, b) => a - b);
+  return sorted[Math.floor(sorted.length / 2)];
+}
+
+// First compiler diagnostic, or the first line of output
+function firstError(output) {
+  const lines = output.split('\n');
+  return (lines.find(line => line.includes('error')) || lines[0] || '').trim();
+}
+
+// Run `binary iterations` and parse "<N> <loop seconds> <checksum>"
+function runSample(binary, iterations) {
+  const start = process.hrtime.bigint();
+  const result = spawnSync(binary, [String(iterations)], { encoding: 'utf8' });
+  const wallMs = Number(process.hrtime.bigint() - start) / 1e6;
+  const match = /(\d+) ([\d.e+-]+) (-?\d+)\s*$/.exec(result.stdout || '');
+  if (result.status !== 0 || !match) {
+    return { error: `exit status ${result.status}: ${firstError(result.stderr || result.stdout || '')}` };
+  }
+  return { wallMs, loopSeconds: parseFloat(match[2]), checksum: match[3] };
+}
+
+function measureVariant(language, variant, processorBinary, buildDir, args) {
+  const config = processors[language];
+  const sample = path.join(samplesDir, config.sample);
+  const extension = path.extname(config.sample);
+  const source = path.join(buildDir, `${language}_${variant.name}${extension}`);
+  const binary = path.join(buildDir, `${language}_${variant.name}`);
+  const result = { language, variant: variant.name, passes: variant.passes, status: 'ok' };
+
+  try {
+    if (variant.passes) {
+      const obfuscated = execSync(`"${processorBinary}" "${sample}" --deterministic --passes=${variant.passes} ${config.flags || ''} ${variant.flags || ''}`,
+                                  { stdio: ['ignore', 'pipe', 'pipe'], maxBuffer: 64 * 1024 * 1024 });
+      fs.writeFileSync(source, obfuscated);
+    } else {
+      fs.copyFileSync(sample, source);
+    }
+  } catch (error) {
+    return { ...result, status: 'obfuscation-failed', error: firstError(String(error.stderr || error.message)) };
+  }
+
+  try {
+    execSync(config.compile(source, binary), { stdio: ['ignore', 'pipe', 'pipe'] });
+  } catch (error) {
+    return { ...result, status: 'build-failed', error: firstError(String(error.stderr || error.message)) };
+  }
+  result.binaryBytes = fs.statSync(binary).size;
+
+  // Startup: a run with no loop iterations is all process start-up,
+  // static initialisation (e.g. string decryption) and the anti-debug check
+  const startup = [];
+  const loops = [];
+  for (let run = 0; run < args.runs; run++) {
+    const idle = runSample(binary, 0);
+    const busy = idle.error ? idle : runSample(binary, args.iterations);
+    if (busy.error) {
+      return { ...result, status: 'run-failed', error: busy.error };
+    }
+    startup.push(idle.wallMs);
+    loops.push(busy.loopSeconds);
+    result.checksum = busy.checksum;
+  }
+  result.startupMs = median(startup);
+  result.loopSeconds = median(loops);
+  result.iterationsPerSecond = args.iterations / result.loopSeconds;
+  return result;
+}
+
+function addDeltas(results) {
+  for (const result of results) {
+    const original = results.find(r => r.language === result.language && r.variant === 'original');
+    if (result === original || result.status !== 'ok' || !original || original.status !== 'ok') {
+      continue;
+    }
+    if (result.checksum !== original.checksum) {
+      result.status = 'wrong-output';
+      continue;
+    }
+    result.delta = {
+      startupMs: result.startupMs - original.startupMs,
+      throughputPercent: (result.iterationsPerSecond / original.iterationsPerSecond - 1) * 100,
+      binaryBytes: result.binaryBytes - original.binaryBytes
+    };
+  }
+}
+
+// Slowdown of the sample's loop in percent at each --profile protection
+// level: control flow only, and control flow plus dead code
+function measuredCosts(results, language) {
+  const slowdown = (variant) => {
+    const original = results.find(r => r.language === language && r.variant === 'original');
+    const result = results.find(r => r.language === language && r.variant === variant);
+    return result && result.delta && original ? original.iterationsPerSecond / result.iterationsPerSecond : null;
+  };
+  const controlFlow = slowdown('controlflow');
+  const deadCode = slowdown('deadcode');
+  if (controlFlow === null || deadCode === null) {
+    return null;
+  }
+  return {
+    fullCost: Math.max(0, (controlFlow * deadCode - 1) * 100),
+    lightCost: Math.max(0, (controlFlow - 1) * 100)
+  };
+}
+
+function printTable(results) {
+  const pad = (value, width) => String(value).padStart(width);
+  console.log(`${'build'.padEnd(18)} ${pad('startup ms', 11)} ${pad('Δ ms', 8)} ${pad('iter/s', 14)} ` +
+              `${pad('Δ %', 8)} ${pad('bytes', 9)} ${pad('Δ bytes', 9)}`);
+  for (const r of results) {
+    const name = `${r.language}/${r.variant}`.padEnd(18);
+    if (r.status !== 'ok') {
+      console.log(`${name} ${r.status}${r.error ? ': ' + r.error : ''}`);
+      continue;
+    }
+    const delta = r.delta || { startupMs: 0, throughputPercent: 0, binaryBytes: 0 };
+    console.log(`${name} ${pad(r.startupMs.toFixed(2), 11)} ${pad(delta.startupMs.toFixed(2), 8)} ` +
+                `${pad(Math.round(r.iterationsPerSecond), 14)} ${pad(delta.throughputPercent.toFixed(1), 8)} ` +
+                `${pad(r.binaryBytes, 9)} ${pad(delta.binaryBytes, 9)}`);
+  }
+}
+
+function main() {
+  const args = parseArgs(process.argv.slice(2));
+  const buildDir = fs.mkdtempSync(path.join(os.tmpdir(), 'obfuscator-runtime-'));
+  const report = {
+    commit: gitCommit(),
+    date: new Date().toISOString(),
+    host: { platform: os.platform(), arch: os.arch(), cpus: os.cpus().length, cpu: os.cpus()[0] && os.cpus()[0].model },
+    iterations: args.iterations,
+    runs: args.runs,
+    results: []
+  };
+
+  try {
+    for (const language of Object.keys(processors)) {
+      const processorBinary = path.join(buildDir, `${language}_processor`);
+      console.log(`Building ${processors[language].source}...`);
+      execSync(processors[language].build(path.join(rootDir, processors[language].source), processorBinary),
+               { stdio: 'inherit' });
+
+      for (const variant of variants) {
+        report.results.push(measureVariant(language, variant, processorBinary, buildDir, args));
+      }
+    }
+  } finally {
+    fs.rmSync(buildDir, { recursive: true, force: true });
+  }
+
+  addDeltas(report.results);
+  console.log('');
+  printTable(report.results);
+
+  report.costs = {};
+  for (const language of Object.keys(processors)) {
+    const costs = measuredCosts(report.results, language);
+    if (costs) {
+      report.costs[language] = costs;
+      console.log(`${language} --profile costs: --full-cost=${costs.fullCost.toFixed(1)} ` +
+                  `--light-cost=${costs.lightCost.toFixed(1)}`);
+    }
+  }
+
+  fs.writeFileSync(args.out, JSON.stringify(report, null, 2) + '\n');
+  console.log(`\nResults written to ${args.out}`);
+}
+
+main();
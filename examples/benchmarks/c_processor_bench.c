@@ -0,0 +1,269 @@
+// Per-pass microbenchmark for CProcessor.
+//
+// Build (see examples/benchmark_native.js, which also runs it):
+//   gcc -O2 -DPROCESSOR_NO_MAIN examples/benchmarks/c_processor_bench.c -lcrypto -pthread
+//
+// Usage: c_processor_bench [--sizes=KB,KB,...] [--iterations=N] [--json=FILE]
+//
+// Each pass runs on the same synthetic input with fresh options; only the
+// pass itself is timed. Peak RSS is reset before every pass where the kernel
+// supports it (/proc/self/clear_refs), so it is the peak of that pass.
+#include "../../src/processors/CProcessor.c"
+
+#include <sys/resource.h>
+
+#define MAX_SIZES 32
+#define PASS_COUNT 8
+
+typedef struct {
+    const char* pass;
+    size_t inputBytes;
+    size_t tokens;
+    size_t literals;
+    double seconds;
+    long peakRssKb;
+} BenchResult;
+
+// Synthetic C file of roughly `bytes` bytes: functions, string literals,
+// ifs and plenty of identifiers
+static void generateInput(size_t bytes, Buffer* code) {
+    const char* header = "#include <stdio.h>\n#include <string.h>\n\n";
+    bufferAppend(code, header, strlen(header));
+    char chunk[1024];
+    for (size_t n = 0; code->length < bytes; n++) {
+        int length = snprintf(chunk, sizeof(chunk),
+                              "struct record%zu { int counter; const char* label; };\n\n"
+                              "int compute%zu(int input, const int* values, int count) {\n"
+                              "    int total = input;\n"
+                              "    const char* message = \"computed value %zu\";\n"
+                              "    if (input > %zu) {\n"
+                              "        total += count;\n"
+                              "    }\n"
+                              "    printf(\"%%s %%d\\n\", message, total + values[0]);\n"
+                              "    return total;\n"
+                              "}\n\n",
+                              n, n, n, n);
+        bufferAppend(code, chunk, length);
+    }
+    const char* footer = "int main(int argc, char** argv) {\n    int values[1] = {0};\n    return compute0(argc, values, 1);\n}\n";
+    bufferAppend(code, footer, strlen(footer));
+}
+
+// Identifiers, numbers, literals and single punctuation characters
+static void countTokens(const char* code, size_t length, size_t* tokens, size_t* literals) {
+    *tokens = 0;
+    *literals = 0;
+    size_t i = 0;
+    while (i < length) {
+        unsigned char c = (unsigned char)code[i];
+        if (isspace(c)) {
+            i++;
+            continue;
+        }
+        (*tokens)++;
+        if (isalnum(c) || c == '_') {
+            while (i < length && (isalnum((unsigned char)code[i]) || code[i] == '_')) {
+                i++;
+            }
+        } else if (c == '"' || c == '\'') {
+            *literals += c == '"';
+            for (i++; i < length && code[i] != (char)c; i++) {
+                i += code[i] == '\\';
+            }
+            i++;
+        } else {
+            i++;
+        }
+    }
+}
+
+static void resetPeakRss(void) {
+    FILE* file = fopen("/proc/self/clear_refs", "w");
+    if (file) {
+        fputs("5", file);
+        fclose(file);
+    }
+}
+
+static long peakRssKb(void) {
+    FILE* file = fopen("/proc/self/status", "r");
+    if (file) {
+        char line[256];
+        while (fgets(line, sizeof(line), file)) {
+            long value = 0;
+            if (sscanf(line, "VmHWM: %ld kB", &value) == 1) {
+                fclose(file);
+                return value;
+            }
+        }
+        fclose(file);
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void initOptions(CProcessorOptions* options) {
+    memset(options, 0, sizeof(*options));
+    strcpy(options->encryptionKey, "default_encryption_key_32_chars_");
+    options->antiDebug = 1;
+    options->controlFlow = 1;
+    options->deadCode = 1;
+    options->stringEncrypt = 1;
+    options->renameIdentifiers = 1;
+    options->deterministic = 1;
+    nameGeneratorInit(&options->identifiers.generator, options->encryptionKey, strlen(options->encryptionKey));
+}
+
+// The lexer the string and identifier passes share, on its own
+static size_t scanTokens(const char* code, size_t length, int identifiers) {
+    Scanner scanner;
+    scannerInit(&scanner, code, length);
+    const char* start;
+    const char* pos = code;
+    size_t tokens = 0;
+    while (scanNextToken(&scanner, pos, identifiers, &start, &pos) != SCAN_TOKEN_END) {
+        tokens++;
+    }
+    return tokens;
+}
+
+static void runPass(int pass, const char* code, size_t length, CProcessorOptions* options) {
+    Buffer out = {0};
+    OutputWriter writer = {0};
+    switch (pass) {
+    case 0:
+        encryptStrings(code, length, options->encryptionKey, options, &out);
+        break;
+    case 1:
+        addControlFlowObfuscation(code, length, NULL, &out);
+        break;
+    case 2:
+        addDeadCode(code, length, NULL, &out);
+        break;
+    case 3:
+        addAntiDebugging(code, length, 0, &out);
+        break;
+    case 4:
+        obfuscateIdentifiers(code, length, options, &writer);
+        break;
+    case 5:
+    case 6: {
+        volatile size_t tokens = scanTokens(code, length, pass == 6);
+        (void)tokens;
+        break;
+    }
+    default:
+        processCodeStream(code, length, options, &writer);
+        break;
+    }
+    free(out.data);
+    free(writer.buffer.data);
+}
+
+int main(int argc, char* argv[]) {
+    static const char* passNames[PASS_COUNT] = {
+        "encryptStrings", "controlFlow", "deadCode", "antiDebugging", "obfuscateIdentifiers", "scanLiterals",
+        "scanIdentifiers", "processCode"
+    };
+    size_t sizes[MAX_SIZES] = {64, 256, 1024, 4096};
+    size_t sizeCount = 4;
+    int iterations = 3;
+    const char* jsonPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--sizes=", 8) == 0) {
+            sizeCount = 0;
+            for (char* item = argv[i] + 8; *item && sizeCount < MAX_SIZES; item++) {
+                sizes[sizeCount++] = strtoul(item, &item, 10);
+                if (!*item) {
+                    break;
+                }
+            }
+        } else if (strncmp(argv[i], "--iterations=", 13) == 0) {
+            iterations = atoi(argv[i] + 13);
+            if (iterations < 1) {
+                iterations = 1;
+            }
+        } else if (strncmp(argv[i], "--json=", 7) == 0) {
+            jsonPath = argv[i] + 7;
+        }
+    }
+
+    BenchResult* results = calloc(sizeCount * PASS_COUNT, sizeof(BenchResult));
+    size_t resultCount = 0;
+    for (size_t s = 0; s < sizeCount; s++) {
+        Buffer input = {0};
+        generateInput(sizes[s] * 1024, &input);
+        size_t tokens, literals;
+        countTokens(input.data, input.length, &tokens, &literals);
+
+        for (int pass = 0; pass < PASS_COUNT; pass++) {
+            BenchResult* result = &results[resultCount++];
+            result->pass = passNames[pass];
+            result->inputBytes = input.length;
+            result->tokens = tokens;
+            result->literals = literals;
+            result->seconds = 1e300;
+
+            // Best of `iterations` runs, each with fresh tables
+            for (int i = 0; i < iterations; i++) {
+                CProcessorOptions options;
+                initOptions(&options);
+
+                resetPeakRss();
+                double start = now();
+                runPass(pass, input.data, input.length, &options);
+                double seconds = now() - start;
+                if (seconds < result->seconds) {
+                    result->seconds = seconds;
+                }
+                long peak = peakRssKb();
+                if (peak > result->peakRssKb) {
+                    result->peakRssKb = peak;
+                }
+
+                stringTableFree(&options.strings);
+                identifierTableFree(&options.identifiers);
+            }
+        }
+        free(input.data);
+    }
+
+    printf("%-22s %10s %10s %14s %14s %11s\n", "pass", "input KB", "MB/s", "tokens/s", "literals/s", "peak RSS KB");
+    for (size_t i = 0; i < resultCount; i++) {
+        BenchResult* r = &results[i];
+        printf("%-22s %10zu %10.2f %14.0f %14.0f %11ld\n", r->pass, r->inputBytes / 1024,
+               r->inputBytes / r->seconds / 1e6, r->tokens / r->seconds, r->literals / r->seconds, r->peakRssKb);
+    }
+
+    if (jsonPath) {
+        FILE* json = fopen(jsonPath, "w");
+        if (!json) {
+            fprintf(stderr, "Error: Cannot write %s\n", jsonPath);
+            return 1;
+        }
+        fprintf(json, "[\n");
+        for (size_t i = 0; i < resultCount; i++) {
+            BenchResult* r = &results[i];
+            fprintf(json,
+                    "  {\"processor\":\"c\",\"pass\":\"%s\",\"inputBytes\":%zu,\"tokens\":%zu,\"literals\":%zu,"
+                    "\"seconds\":%.9f,\"mbPerSecond\":%.3f,\"tokensPerSecond\":%.1f,\"literalsPerSecond\":%.1f,"
+                    "\"peakRssKb\":%ld}%s\n",
+                    r->pass, r->inputBytes, r->tokens, r->literals, r->seconds,
+                    r->inputBytes / r->seconds / 1e6, r->tokens / r->seconds, r->literals / r->seconds,
+                    r->peakRssKb, i + 1 < resultCount ? "," : "");
+        }
+        fprintf(json, "]\n");
+        fclose(json);
+    }
+
+    free(results);
+    return 0;
+}
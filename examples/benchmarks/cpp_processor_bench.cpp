@@ -0,0 +1,196 @@
+// Per-pass microbenchmark for CppProcessor.
+//
+// Build (see examples/benchmark_native.js, which also runs it):
+//   g++ -std=c++17 -O2 -DPROCESSOR_NO_MAIN examples/benchmarks/cpp_processor_bench.cpp -lcrypto -pthread
+//
+// Usage: cpp_processor_bench [--sizes=KB,KB,...] [--iterations=N] [--json=FILE]
+//
+// Each pass runs on a freshly lexed copy of a synthetic input; only the pass
+// itself is timed. Peak RSS is reset before every pass where the kernel
+// supports it (/proc/self/clear_refs), so it is the peak of that pass.
+#include "../../src/processors/CppProcessor.cpp"
+
+#include <sys/resource.h>
+
+namespace {
+
+struct BenchResult {
+    std::string pass;
+    size_t inputBytes = 0;
+    size_t tokens = 0;
+    size_t literals = 0;
+    double seconds = 0;
+    long peakRssKb = 0;
+};
+
+// Synthetic translation unit of roughly `bytes` bytes: classes, templates,
+// string literals, ifs and plenty of identifiers
+std::string generateInput(size_t bytes) {
+    std::string code = "#include <iostream>\n#include <string>\n#include <vector>\n\n";
+    for (size_t n = 0; code.size() < bytes; ++n) {
+        std::string id = std::to_string(n);
+        code += "class Widget" + id + " {\npublic:\n"
+                "    int counter" + id + " = 0;\n"
+                "    std::string label() const { return \"widget label " + id + "\"; }\n"
+                "};\n\n"
+                "template<typename Value, typename Other>\n"
+                "Value combine" + id + "(Value left, Other right) { return left + static_cast<Value>(right); }\n\n"
+                "int compute" + id + "(int input, const std::vector<int>& values) {\n"
+                "    int total = input;\n"
+                "    if (input > " + id + ") {\n"
+                "        total += values.size();\n"
+                "    } else {\n"
+                "        total -= 1;\n"
+                "    }\n"
+                "    std::cout << \"computed value\" << total << std::endl;\n"
+                "    return combine" + id + "(total, 2.5);\n"
+                "}\n\n";
+    }
+    code += "int main() {\n    std::vector<int> values;\n    return compute0(1, values);\n}\n";
+    return code;
+}
+
+void resetPeakRss() {
+    FILE* file = std::fopen("/proc/self/clear_refs", "w");
+    if (file) {
+        std::fputs("5", file);
+        std::fclose(file);
+    }
+}
+
+long peakRssKb() {
+    FILE* file = std::fopen("/proc/self/status", "r");
+    if (file) {
+        char line[256];
+        while (std::fgets(line, sizeof(line), file)) {
+            long value = 0;
+            if (std::sscanf(line, "VmHWM: %ld kB", &value) == 1) {
+                std::fclose(file);
+                return value;
+            }
+        }
+        std::fclose(file);
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+size_t countLiterals(const SourceIR& ir) {
+    size_t literals = 0;
+    for (size_t i = 0; i < ir.size(); ++i) {
+        literals += ir[i].kind == TokenKind::String || ir[i].kind == TokenKind::RawString;
+    }
+    return literals;
+}
+
+// Best of `iterations` timed runs of `pass`, each on a fresh processor and
+// a freshly lexed IR
+BenchResult measure(const std::string& name, const std::string& input, size_t tokens, size_t literals,
+                    int iterations, const std::function<void(SourceIR&, CppProcessor&)>& pass) {
+    BenchResult result;
+    result.pass = name;
+    result.inputBytes = input.size();
+    result.tokens = tokens;
+    result.literals = literals;
+    result.seconds = 1e300;
+
+    for (int i = 0; i < iterations; ++i) {
+        std::map<std::string, std::string> options;
+        options["deterministic"] = "1";
+        CppProcessor processor(options);
+        SourceIR ir(input);
+
+        resetPeakRss();
+        auto start = std::chrono::steady_clock::now();
+        pass(ir, processor);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.seconds = std::min(result.seconds, seconds);
+        result.peakRssKb = std::max(result.peakRssKb, peakRssKb());
+    }
+    return result;
+}
+
+std::string toJson(const BenchResult& r) {
+    char buffer[512];
+    std::snprintf(buffer, sizeof(buffer),
+                  "{\"processor\":\"cpp\",\"pass\":\"%s\",\"inputBytes\":%zu,\"tokens\":%zu,\"literals\":%zu,"
+                  "\"seconds\":%.9f,\"mbPerSecond\":%.3f,\"tokensPerSecond\":%.1f,\"literalsPerSecond\":%.1f,"
+                  "\"peakRssKb\":%ld}",
+                  r.pass.c_str(), r.inputBytes, r.tokens, r.literals, r.seconds,
+                  r.inputBytes / r.seconds / 1e6, r.tokens / r.seconds, r.literals / r.seconds, r.peakRssKb);
+    return buffer;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<size_t> sizes = {64, 256, 1024, 4096};
+    int iterations = 3;
+    std::string jsonPath;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--sizes=", 0) == 0) {
+            sizes.clear();
+            std::stringstream list(arg.substr(std::strlen("--sizes=")));
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                sizes.push_back(std::stoul(item));
+            }
+        } else if (arg.rfind("--iterations=", 0) == 0) {
+            iterations = std::max(1, std::atoi(arg.c_str() + std::strlen("--iterations=")));
+        } else if (arg.rfind("--json=", 0) == 0) {
+            jsonPath = arg.substr(std::strlen("--json="));
+        }
+    }
+
+    const std::string key = "default_encryption_key_32_chars_";
+    std::vector<BenchResult> results;
+    for (size_t kb : sizes) {
+        std::string input = generateInput(kb * 1024);
+        SourceIR lexed(input);
+        size_t tokens = lexed.size();
+        size_t literals = countLiterals(lexed);
+
+        results.push_back(measure("lex", input, tokens, literals, iterations,
+                                  [&](SourceIR&, CppProcessor&) { SourceIR ir(input); }));
+        results.push_back(measure("encryptStrings", input, tokens, literals, iterations,
+                                  [&](SourceIR& ir, CppProcessor& p) { p.encryptStrings(ir, key); }));
+        results.push_back(measure("classObfuscation", input, tokens, literals, iterations,
+                                  [](SourceIR& ir, CppProcessor& p) { p.addClassObfuscation(ir); }));
+        results.push_back(measure("templateObfuscation", input, tokens, literals, iterations,
+                                  [](SourceIR& ir, CppProcessor& p) { p.addTemplateObfuscation(ir); }));
+        results.push_back(measure("obfuscateIdentifiers", input, tokens, literals, iterations,
+                                  [](SourceIR& ir, CppProcessor& p) { p.obfuscateIdentifiers(ir); }));
+        results.push_back(measure("controlFlow", input, tokens, literals, iterations,
+                                  [](SourceIR& ir, CppProcessor& p) { p.addControlFlowObfuscation(ir); }));
+        results.push_back(measure("deadCode", input, tokens, literals, iterations,
+                                  [](SourceIR& ir, CppProcessor& p) { p.addDeadCode(ir); }));
+        results.push_back(measure("antiDebugging", input, tokens, literals, iterations,
+                                  [](SourceIR& ir, CppProcessor& p) { p.addAntiDebugging(ir); }));
+        results.push_back(measure("serialize", input, tokens, literals, iterations,
+                                  [](SourceIR& ir, CppProcessor&) { ir.serialize(); }));
+        results.push_back(measure("process", input, tokens, literals, iterations,
+                                  [&](SourceIR&, CppProcessor& p) { p.process(input); }));
+    }
+
+    std::printf("%-22s %10s %10s %14s %14s %11s\n", "pass", "input KB", "MB/s", "tokens/s", "literals/s", "peak RSS KB");
+    for (const auto& r : results) {
+        std::printf("%-22s %10zu %10.2f %14.0f %14.0f %11ld\n", r.pass.c_str(), r.inputBytes / 1024,
+                    r.inputBytes / r.seconds / 1e6, r.tokens / r.seconds, r.literals / r.seconds, r.peakRssKb);
+    }
+
+    if (!jsonPath.empty()) {
+        std::ofstream json(jsonPath);
+        json << "[\n";
+        for (size_t i = 0; i < results.size(); ++i) {
+            json << "  " << toJson(results[i]) << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        json << "]\n";
+        if (!json) {
+            std::cerr << "Error: Cannot write " << jsonPath << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+// Micro-workload for examples/benchmark_runtime.js. Usage: runtime_sample N
+//
+// Runs N rounds of branchy integer work and string handling and prints
+// "<N> <loop seconds> <checksum>". With N = 0 the run time is all startup;
+// the checksum must match the original build's.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+int classify(int value) {
+    if (value % 3 == 0) {
+        return value / 3;
+    } else {
+        return value * 2 + 1;
+    }
+}
+
+size_t describe(int value, char* buffer, size_t size) {
+    const char* parity = "odd";
+    if (value % 2 == 0) {
+        parity = "even";
+    }
+    return (size_t)snprintf(buffer, size, "item-%s", parity);
+}
+
+int main(int argc, char* argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    long checksum = 0;
+    char buffer[32];
+    for (long i = 0; i < iterations; i++) {
+        int value = (int)(i & 0xFFFF);
+        checksum += classify(value);
+        checksum += (long)describe(value, buffer, sizeof(buffer));
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%ld %f %ld\n", iterations, seconds, checksum);
+    return 0;
+}
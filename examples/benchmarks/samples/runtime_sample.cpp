@@ -0,0 +1,44 @@
+// Micro-workload for examples/benchmark_runtime.js. Usage: runtime_sample N
+//
+// Runs N rounds of branchy integer work and string handling and prints
+// "<N> <loop seconds> <checksum>". With N = 0 the run time is all startup;
+// the checksum must match the original build's.
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int classify(int value) {
+    if (value % 3 == 0) {
+        return value / 3;
+    } else {
+        return value * 2 + 1;
+    }
+}
+
+std::string describe(int value) {
+    std::string result = "item-";
+    if (value % 2 == 0) {
+        result += "even";
+    } else {
+        result += "odd";
+    }
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    long iterations = argc > 1 ? std::atol(argv[1]) : 0;
+    auto start = std::chrono::steady_clock::now();
+    
+    long checksum = 0;
+    for (long i = 0; i < iterations; ++i) {
+        int value = static_cast<int>(i & 0xFFFF);
+        checksum += classify(value);
+        checksum += static_cast<long>(describe(value).size());
+    }
+    
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << iterations << " " << seconds << " " << checksum << std::endl;
+    return 0;
+}
@@ -1,507 +1,3930 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <time.h>
 #include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SCAN_X86 1
+#endif
 #include <openssl/aes.h>
 #include <openssl/rand.h>
 #include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include "NameGenerator.h"
+#include "ObfuscatorApi.h"
+#include "ReservedNames.h"
 
-#define MAX_CODE_SIZE 1048576
-#define MAX_IDENTIFIERS 10000
-#define MAX_STRINGS 5000
+#define WRITER_FLUSH_SIZE 65536
+#define IDENTIFIER_TABLE_INITIAL_CAPACITY 1024
+#define STRING_POOL_INITIAL_CAPACITY 256
+#define ARENA_MIN_BLOCK_SIZE 4096
+#define ARENA_MAX_BLOCK_SIZE 1048576
 #define AES_BLOCK_SIZE 16
+#define STATS_PASS_COUNT 5
+#define SCAN_BLOCK_SIZE 32
+#define LITERAL_PART_STRINGS 4096
+
+// Heap allocations made by the current thread while --stats is counting.
+// The processor allocates through these wrappers; with counting off each
+// call costs one thread-local test.
+static _Thread_local int allocationCounting;
+static _Thread_local size_t allocationCount;
+static _Thread_local size_t allocationBytes;
+
+static inline void* countedMalloc(size_t size) {
+    if (allocationCounting) {
+        allocationCount++;
+        allocationBytes += size;
+    }
+    return malloc(size);
+}
+
+static inline void* countedCalloc(size_t count, size_t size) {
+    if (allocationCounting) {
+        allocationCount++;
+        allocationBytes += count * size;
+    }
+    return calloc(count, size);
+}
+
+static inline void* countedRealloc(void* memory, size_t size) {
+    if (allocationCounting) {
+        allocationCount++;
+        allocationBytes += size;
+    }
+    return realloc(memory, size);
+}
+
+#define malloc(size) countedMalloc(size)
+#define calloc(count, size) countedCalloc(count, size)
+#define realloc(memory, size) countedRealloc(memory, size)
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t used;
+    size_t capacity;
+    char data[];
+} ArenaBlock;
+
+// Bump allocator. Blocks double in size up to ARENA_MAX_BLOCK_SIZE (larger
+// requests get a block of their own) and are all released by arenaFree.
+typedef struct {
+    ArenaBlock* head;
+    size_t nextBlockSize;
+} Arena;
+
+typedef struct {
+    const char* data;
+    size_t length;
+    unsigned int hash;
+} PooledString;
+
+// Interned strings: each distinct string is stored once, NUL-terminated, in
+// the arena and stays valid until the pool is freed
+typedef struct {
+    Arena arena;
+    PooledString* entries;
+    size_t capacity;
+    size_t count;
+} StringPool;
 
 typedef struct {
-    char original[256];
-    char obfuscated[256];
+    const char* original;
+    const char* obfuscated;
+    size_t length;
+    unsigned int hash;
 } IdentifierMap;
 
+// Open-addressing hash table keyed on the original identifier. Names live in
+// the table's string pool.
+typedef struct {
+    IdentifierMap* entries;
+    size_t capacity;
+    size_t count;
+    StringPool names;
+    NameGenerator generator;  // hands out this table's obfuscated names
+} IdentifierTable;
+
+// Identifier table shared by every worker in project mode
+typedef struct {
+    IdentifierTable table;
+    pthread_mutex_t lock;
+    // Ordered mode: files take turns, in a fixed order, to draw new names so
+    // the generator hands out the same names on every run
+    int ordered;
+    size_t nextTurn;
+    pthread_cond_t turnChanged;
+} SharedIdentifiers;
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} Buffer;
+
+// Buffered output sink. With a file or a sink function the pending bytes are
+// flushed once they reach WRITER_FLUSH_SIZE; without either everything is
+// kept in the buffer.
+typedef struct {
+    FILE* file;
+    int (*sink)(void* context, const char* data, size_t length);  // non-zero return: error
+    void* sinkContext;
+    Buffer buffer;
+    size_t flushed;  // bytes already written to the file
+    int error;
+} OutputWriter;
+
 typedef struct {
-    char original[1024];
-    char encrypted[2048];
-    char varName[64];
+    const char* original;   // literal body as written, without the quotes
+    size_t position;        // of the opening quote in the pass input
+    size_t offset;          // of its bytes in the encrypted segment
+    size_t length;
 } StringMap;
 
+// Encrypted literals in source order; their text lives in the pool
+typedef struct {
+    StringMap* entries;
+    size_t count;
+    size_t capacity;
+    StringPool pool;
+} StringTable;
+
+// Cost of one pass, summed over every file it ran on
+typedef struct {
+    size_t runs;
+    double wallSeconds;
+    double cpuSeconds;  // thread CPU time
+    size_t bytesIn;
+    size_t bytesOut;
+    size_t allocations;
+    size_t allocatedBytes;
+    long peakRssKb;     // process high-water mark when the pass ended
+} PassStats;
+
+// Instrumentation for --stats, collected only when options->stats is set
+typedef struct {
+    PassStats passes[STATS_PASS_COUNT];  // in pipeline order, see statsPassNames
+    size_t files;
+    size_t literals;
+    size_t literalBytes;
+    size_t identifiers;
+} ProcessStats;
+
+// Counters at the start of a pass
+typedef struct {
+    struct timespec wall;
+    struct timespec cpu;
+    size_t allocations;
+    size_t allocatedBytes;
+} PassProbe;
+
+// How much obfuscation a function gets, from --profile
+typedef enum {
+    PROTECTION_FULL,
+    PROTECTION_LIGHT,   // control flow only
+    PROTECTION_NONE
+} ProtectionLevel;
+
+typedef struct {
+    char* name;
+    double share;       // fraction of the runtime, -1 when not given
+    ProtectionLevel level;
+} HotFunction;
+
+// Hot functions from a profile, sorted by name
+typedef struct {
+    HotFunction* functions;
+    size_t count;
+    double budget;      // fraction of the runtime
+    double fullCost;    // estimated slowdown of a function's own time when fully protected
+    double lightCost;   // the same with control flow only
+    double overhead;    // estimated, after fitting the budget
+} HotProfile;
+
+// Body of a function that is not fully protected, as byte offsets of its braces
+typedef struct {
+    size_t start;
+    size_t end;
+    ProtectionLevel level;
+} FunctionSpan;
+
 typedef struct {
     char encryptionKey[65];
     int antiDebug;
+    int antiDebugInterval;        // ms between checks of the background monitor; 0: one check in main
     int controlFlow;
     int deadCode;
     int stringEncrypt;
-    IdentifierMap identifiers[MAX_IDENTIFIERS];
-    StringMap strings[MAX_STRINGS];
-    int identifierCount;
-    int stringCount;
+    int renameIdentifiers;
+    IdentifierTable identifiers;  // with shared: this file's slice of it
+    SharedIdentifiers* shared;
+    size_t turn;                  // this file's turn when shared is ordered
+    int deterministic;            // derive IVs from the key and fileLabel
+    unsigned char fileLabel[32];
+    StringTable strings;
+    ProcessStats* stats;          // NULL unless --stats
+    const HotProfile* profile;    // NULL unless --profile
+    IdentifierTable* preserved;   // NULL unless --preserve; read-only, shared by all files
+    int literalJobs;              // threads of the string pass; 0 or 1 for none
+    size_t runtimeLength;         // bytes of string runtime the string pass put before the code
 } CProcessorOptions;
 
 // Function prototypes
-char* encryptString(const char* plaintext, const char* key);
-char* decryptString(const char* ciphertext, const char* key);
-char* obfuscateIdentifiers(const char* code, CProcessorOptions* options);
-char* encryptStrings(const char* code, const char* key, CProcessorOptions* options);
-char* addControlFlowObfuscation(const char* code);
-char* addDeadCode(const char* code);
-char* addAntiDebugging(const char* code);
-char* generateObfuscatedName();
+int encryptSegment(const unsigned char* plaintext, size_t length, const char* key,
+                   const unsigned char nonce[AES_BLOCK_SIZE], size_t offset, unsigned char* ciphertext);
+int obfuscateIdentifiers(const char* code, size_t length, CProcessorOptions* options, OutputWriter* out);
+int encryptStrings(const char* code, size_t length, const char* key, CProcessorOptions* options, Buffer* out);
+int addControlFlowObfuscation(const char* code, size_t length, const HotProfile* profile, Buffer* out);
+int addDeadCode(const char* code, size_t length, const HotProfile* profile, Buffer* out);
+int addAntiDebugging(const char* code, size_t length, int interval, Buffer* out);
 int isReservedKeyword(const char* word);
+IdentifierMap* identifierTableFind(IdentifierTable* table, const char* name, size_t length, unsigned int hash);
+IdentifierMap* identifierTableInsert(IdentifierTable* table, const char* name, size_t length, unsigned int hash, const char* obfuscated);
+void identifierTableFree(IdentifierTable* table);
+void* arenaAlloc(Arena* arena, size_t size);
+void arenaFree(Arena* arena);
+const char* stringPoolIntern(StringPool* pool, const char* str, size_t length);
+void stringPoolFree(StringPool* pool);
+StringMap* stringTableAdd(StringTable* table, const char* original, size_t length);
+void stringTableFree(StringTable* table);
+int processCodeStream(const char* code, size_t length, CProcessorOptions* options, OutputWriter* out);
 char* processCode(const char* code, CProcessorOptions* options);
+const char* mapFile(const char* path, size_t* length);
+void unmapFile(const char* data, size_t length);
+int cacheKey(const char* code, size_t length, const CProcessorOptions* options, char key[65]);
+int cacheLoad(const char* dir, const char* key, Buffer* output, IdentifierTable* renames);
+int cacheStore(const char* dir, const char* key, const char* output, size_t length, const IdentifierTable* renames);
+int processProject(const char* input, const char* outDir, int jobs, const CProcessorOptions* config, const char* cacheDir,
+                   const char* statsPath);
+int processServe(const CProcessorOptions* config, int jobs, const char* socketPath);
+int processStatsWrite(const ProcessStats* stats, double wallSeconds, const char* path);
+int parsePassList(const char* list, CProcessorOptions* options);
+int hotProfileLoad(const char* path, double budgetPercent, double fullCostPercent, double lightCostPercent,
+                   HotProfile* profile);
+ProtectionLevel hotProfileLevel(const HotProfile* profile, const char* name, size_t length);
+void hotProfileFree(HotProfile* profile);
+int preserveListLoad(const char* path, IdentifierTable* table);
 
-// Reserved C keywords
-const char* reservedKeywords[] = {
-    "auto", "break", "case", "char", "const", "continue", "default", "do",
-    "double", "else", "enum", "extern", "float", "for", "goto", "if",
-    "int", "long", "register", "return", "short", "signed", "sizeof", "static",
-    "struct", "switch", "typedef", "union", "unsigned", "void", "volatile", "while",
-    "inline", "restrict", "_Bool", "_Complex", "_Imaginary", NULL
-};
-
-char* encryptString(const char* plaintext, const char* key) {
-    EVP_CIPHER_CTX *ctx;
-    int len;
-    int ciphertext_len;
-    unsigned char *ciphertext;
-    unsigned char iv[AES_BLOCK_SIZE];
+// Encrypt `length` bytes of an AES-256-CTR segment, starting at byte
+// `offset` of it. Byte i of the segment is encrypted with counter block
+// nonce + i / 16, so any byte range can be encrypted or decrypted on its own.
+// `ciphertext` may equal `plaintext`.
+int encryptSegment(const unsigned char* plaintext, size_t length, const char* key,
+                   const unsigned char nonce[AES_BLOCK_SIZE], size_t offset, unsigned char* ciphertext) {
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    if (!ctx) {
+        return 0;
+    }
     
-    // Generate random IV
-    if (RAND_bytes(iv, AES_BLOCK_SIZE) != 1) {
-        return NULL;
+    // nonce + offset / 16 as a 128-bit big-endian number
+    unsigned char counter[AES_BLOCK_SIZE];
+    unsigned int carry = 0;
+    size_t block = offset / AES_BLOCK_SIZE;
+    for (int i = AES_BLOCK_SIZE - 1; i >= 0; i--) {
+        carry += nonce[i] + (block & 0xFF);
+        counter[i] = (unsigned char)carry;
+        carry >>= 8;
+        block >>= 8;
     }
     
-    // Create and initialize the context
-    if (!(ctx = EVP_CIPHER_CTX_new())) {
-        return NULL;
+    unsigned char skipped[AES_BLOCK_SIZE] = {0};
+    int skip = (int)(offset % AES_BLOCK_SIZE);
+    int written = 0;
+    int ok = EVP_EncryptInit_ex(ctx, EVP_aes_256_ctr(), NULL, (const unsigned char*)key, counter) == 1 &&
+             (skip == 0 || EVP_EncryptUpdate(ctx, skipped, &written, skipped, skip) == 1);
+    for (size_t done = 0; ok && done < length;) {
+        int chunk = length - done > INT_MAX ? INT_MAX / AES_BLOCK_SIZE * AES_BLOCK_SIZE : (int)(length - done);
+        int written = 0;
+        ok = EVP_EncryptUpdate(ctx, ciphertext + done, &written, plaintext + done, chunk) == 1;
+        done += chunk;
+    }
+    EVP_CIPHER_CTX_free(ctx);
+    return ok;
+}
+
+static unsigned int hashIdentifier(const char* name, size_t length) {
+    // FNV-1a
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Keywords and the library names in ReservedNames.h
+int isReservedKeyword(const char* word) {
+    size_t length = strlen(word);
+    return reservedNameFind(word, length, hashIdentifier(word, length));
+}
+
+void* arenaAlloc(Arena* arena, size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    ArenaBlock* block = arena->head;
+    if (!block || block->capacity - block->used < size) {
+        size_t capacity = arena->nextBlockSize ? arena->nextBlockSize : ARENA_MIN_BLOCK_SIZE;
+        if (capacity < size) {
+            capacity = size;
+        }
+        
+        block = malloc(sizeof(ArenaBlock) + capacity);
+        if (!block) {
+            return NULL;
+        }
+        block->next = arena->head;
+        block->used = 0;
+        block->capacity = capacity;
+        arena->head = block;
+        
+        if (capacity < ARENA_MAX_BLOCK_SIZE) {
+            arena->nextBlockSize = capacity * 2;
+        }
     }
     
-    // Initialize the encryption operation
-    if (EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), NULL, (unsigned char*)key, iv) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        return NULL;
+    void* result = block->data + block->used;
+    block->used += size;
+    return result;
+}
+
+void arenaFree(Arena* arena) {
+    while (arena->head) {
+        ArenaBlock* next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
+    }
+    arena->nextBlockSize = 0;
+}
+
+static int stringPoolGrow(StringPool* pool) {
+    size_t capacity = pool->capacity ? pool->capacity * 2 : STRING_POOL_INITIAL_CAPACITY;
+    PooledString* entries = calloc(capacity, sizeof(PooledString));
+    if (!entries) {
+        return 0;
     }
     
-    // Allocate memory for ciphertext
-    ciphertext = malloc(strlen(plaintext) + AES_BLOCK_SIZE + AES_BLOCK_SIZE);
-    if (!ciphertext) {
-        EVP_CIPHER_CTX_free(ctx);
-        return NULL;
+    for (size_t i = 0; i < pool->capacity; i++) {
+        if (pool->entries[i].data) {
+            size_t j = pool->entries[i].hash & (capacity - 1);
+            while (entries[j].data) {
+                j = (j + 1) & (capacity - 1);
+            }
+            entries[j] = pool->entries[i];
+        }
     }
     
-    // Copy IV to beginning of ciphertext
-    memcpy(ciphertext, iv, AES_BLOCK_SIZE);
+    free(pool->entries);
+    pool->entries = entries;
+    pool->capacity = capacity;
+    return 1;
+}
+
+const char* stringPoolIntern(StringPool* pool, const char* str, size_t length) {
+    unsigned int hash = hashIdentifier(str, length);
+    if (pool->capacity > 0) {
+        size_t mask = pool->capacity - 1;
+        for (size_t i = hash & mask; pool->entries[i].data; i = (i + 1) & mask) {
+            PooledString* entry = &pool->entries[i];
+            if (entry->hash == hash && entry->length == length && memcmp(entry->data, str, length) == 0) {
+                return entry->data;
+            }
+        }
+    }
     
-    // Encrypt the plaintext
-    if (EVP_EncryptUpdate(ctx, ciphertext + AES_BLOCK_SIZE, &len, (unsigned char*)plaintext, strlen(plaintext)) != 1) {
-        free(ciphertext);
-        EVP_CIPHER_CTX_free(ctx);
+    // Keep the load factor below 0.7
+    if ((pool->count + 1) * 10 > pool->capacity * 7 && !stringPoolGrow(pool)) {
         return NULL;
     }
-    ciphertext_len = len;
     
-    // Finalize the encryption
-    if (EVP_EncryptFinal_ex(ctx, ciphertext + AES_BLOCK_SIZE + len, &len) != 1) {
-        free(ciphertext);
-        EVP_CIPHER_CTX_free(ctx);
+    char* data = arenaAlloc(&pool->arena, length + 1);
+    if (!data) {
         return NULL;
     }
-    ciphertext_len += len;
-    
-    // Clean up
-    EVP_CIPHER_CTX_free(ctx);
-    
-    // Convert to base64
-    char* base64 = malloc((ciphertext_len + AES_BLOCK_SIZE) * 2);
-    EVP_EncodeBlock((unsigned char*)base64, ciphertext, ciphertext_len + AES_BLOCK_SIZE);
+    memcpy(data, str, length);
+    data[length] = '\0';
     
-    free(ciphertext);
-    return base64;
+    size_t mask = pool->capacity - 1;
+    size_t i = hash & mask;
+    while (pool->entries[i].data) {
+        i = (i + 1) & mask;
+    }
+    pool->entries[i].data = data;
+    pool->entries[i].length = length;
+    pool->entries[i].hash = hash;
+    pool->count++;
+    return data;
 }
 
-char* decryptString(const char* ciphertext, const char* key) {
-    // Decrypt function implementation
-    // This would be included in the obfuscated output
-    return NULL; // Placeholder
+void stringPoolFree(StringPool* pool) {
+    arenaFree(&pool->arena);
+    free(pool->entries);
+    pool->entries = NULL;
+    pool->capacity = 0;
+    pool->count = 0;
 }
 
-char* generateObfuscatedName() {
-    static int counter = 0;
-    char* name = malloc(32);
-    const char charset[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
-    
-    srand(time(NULL) + counter++);
-    
-    // Generate random name starting with letter
-    name[0] = charset[rand() % 52];
-    
-    int length = 8 + (rand() % 8); // 8-15 characters
-    for (int i = 1; i < length; i++) {
-        if (rand() % 3 == 0) {
-            name[i] = '0' + (rand() % 10); // Add numbers
-        } else {
-            name[i] = charset[rand() % 52];
+StringMap* stringTableAdd(StringTable* table, const char* original, size_t length) {
+    if (table->count == table->capacity) {
+        size_t capacity = table->capacity ? table->capacity * 2 : STRING_POOL_INITIAL_CAPACITY;
+        StringMap* entries = realloc(table->entries, capacity * sizeof(StringMap));
+        if (!entries) {
+            return NULL;
         }
+        table->entries = entries;
+        table->capacity = capacity;
     }
     
-    name[length] = '\0';
-    return name;
+    StringMap* entry = &table->entries[table->count];
+    entry->original = stringPoolIntern(&table->pool, original, length);
+    entry->position = 0;
+    entry->offset = 0;
+    entry->length = 0;
+    if (!entry->original) {
+        return NULL;
+    }
+    table->count++;
+    return entry;
 }
 
-int isReservedKeyword(const char* word) {
-    for (int i = 0; reservedKeywords[i] != NULL; i++) {
-        if (strcmp(word, reservedKeywords[i]) == 0) {
-            return 1;
-        }
-    }
-    return 0;
+void stringTableFree(StringTable* table) {
+    free(table->entries);
+    table->entries = NULL;
+    table->count = 0;
+    table->capacity = 0;
+    stringPoolFree(&table->pool);
 }
 
-char* obfuscateIdentifiers(const char* code, CProcessorOptions* options) {
-    char* result = malloc(strlen(code) * 2);
-    strcpy(result, code);
+IdentifierMap* identifierTableFind(IdentifierTable* table, const char* name, size_t length, unsigned int hash) {
+    if (table->capacity == 0) {
+        return NULL;
+    }
     
-    // Simple identifier obfuscation using regex-like pattern matching
-    char* pos = result;
-    while (*pos) {
-        if (isalpha(*pos) || *pos == '_') {
-            char identifier[256];
-            int len = 0;
-            
-            // Extract identifier
-            while ((isalnum(*pos) || *pos == '_') && len < 255) {
-                identifier[len++] = *pos++;
-            }
-            identifier[len] = '\0';
-            
-            // Check if it's a reserved keyword
-            if (!isReservedKeyword(identifier) && len > 1) {
-                // Check if we already have a mapping
-                int found = -1;
-                for (int i = 0; i < options->identifierCount; i++) {
-                    if (strcmp(options->identifiers[i].original, identifier) == 0) {
-                        found = i;
-                        break;
-                    }
-                }
-                
-                if (found == -1 && options->identifierCount < MAX_IDENTIFIERS) {
-                    // Create new mapping
-                    strcpy(options->identifiers[options->identifierCount].original, identifier);
-                    char* obfuscated = generateObfuscatedName();
-                    strcpy(options->identifiers[options->identifierCount].obfuscated, obfuscated);
-                    free(obfuscated);
-                    options->identifierCount++;
-                }
-            }
-        } else {
-            pos++;
+    size_t mask = table->capacity - 1;
+    for (size_t i = hash & mask; table->entries[i].original; i = (i + 1) & mask) {
+        IdentifierMap* entry = &table->entries[i];
+        if (entry->hash == hash && entry->length == length && memcmp(entry->original, name, length) == 0) {
+            return entry;
         }
     }
+    return NULL;
+}
+
+static int identifierTableGrow(IdentifierTable* table) {
+    size_t capacity = table->capacity ? table->capacity * 2 : IDENTIFIER_TABLE_INITIAL_CAPACITY;
+    IdentifierMap* entries = calloc(capacity, sizeof(IdentifierMap));
+    if (!entries) {
+        return 0;
+    }
     
-    // Replace identifiers in the code
-    for (int i = 0; i < options->identifierCount; i++) {
-        char* temp = malloc(strlen(result) * 2);
-        char* src = result;
-        char* dst = temp;
-        
-        while (*src) {
-            if (strncmp(src, options->identifiers[i].original, strlen(options->identifiers[i].original)) == 0) {
-                // Check if it's a whole word
-                char prev = (src > result) ? *(src - 1) : ' ';
-                char next = *(src + strlen(options->identifiers[i].original));
-                
-                if (!isalnum(prev) && prev != '_' && !isalnum(next) && next != '_') {
-                    strcpy(dst, options->identifiers[i].obfuscated);
-                    dst += strlen(options->identifiers[i].obfuscated);
-                    src += strlen(options->identifiers[i].original);
-                } else {
-                    *dst++ = *src++;
-                }
-            } else {
-                *dst++ = *src++;
+    // Rehash existing entries into the larger table
+    for (size_t i = 0; i < table->capacity; i++) {
+        IdentifierMap* entry = &table->entries[i];
+        if (entry->original) {
+            size_t j = entry->hash & (capacity - 1);
+            while (entries[j].original) {
+                j = (j + 1) & (capacity - 1);
             }
+            entries[j] = *entry;
         }
-        *dst = '\0';
-        
-        free(result);
-        result = temp;
     }
     
-    return result;
+    free(table->entries);
+    table->entries = entries;
+    table->capacity = capacity;
+    return 1;
 }
 
-char* encryptStrings(const char* code, const char* key, CProcessorOptions* options) {
-    char* result = malloc(strlen(code) * 3);
-    char* decryptFunction = 
-        "\n// String decryption function\n"
-        "char* _decrypt_str(const char* encrypted, const char* key) {\n"
-        "    // Decryption implementation\n"
-        "    EVP_CIPHER_CTX *ctx;\n"
-        "    int len, plaintext_len;\n"
-        "    unsigned char *plaintext;\n"
-        "    unsigned char iv[16];\n"
-        "    \n"
-        "    // Decode base64\n"
-        "    int ciphertext_len = strlen(encrypted);\n"
-        "    unsigned char *ciphertext = malloc(ciphertext_len);\n"
-        "    EVP_DecodeBlock(ciphertext, (unsigned char*)encrypted, ciphertext_len);\n"
-        "    \n"
-        "    // Extract IV\n"
-        "    memcpy(iv, ciphertext, 16);\n"
-        "    \n"
-        "    // Decrypt\n"
-        "    ctx = EVP_CIPHER_CTX_new();\n"
-        "    EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), NULL, (unsigned char*)key, iv);\n"
-        "    \n"
-        "    plaintext = malloc(ciphertext_len);\n"
-        "    EVP_DecryptUpdate(ctx, plaintext, &len, ciphertext + 16, ciphertext_len - 16);\n"
-        "    plaintext_len = len;\n"
-        "    EVP_DecryptFinal_ex(ctx, plaintext + len, &len);\n"
-        "    plaintext_len += len;\n"
-        "    plaintext[plaintext_len] = '\\0';\n"
-        "    \n"
-        "    EVP_CIPHER_CTX_free(ctx);\n"
-        "    free(ciphertext);\n"
-        "    return (char*)plaintext;\n"
-        "}\n\n";
-    
-    strcpy(result, decryptFunction);
+IdentifierMap* identifierTableInsert(IdentifierTable* table, const char* name, size_t length, unsigned int hash, const char* obfuscated) {
+    // Keep the load factor below 0.7
+    if ((table->count + 1) * 10 > table->capacity * 7 && !identifierTableGrow(table)) {
+        return NULL;
+    }
     
-    // Find and encrypt string literals
-    char* pos = (char*)code;
-    char* output = result + strlen(result);
+    const char* original = stringPoolIntern(&table->names, name, length);
+    if (!original) {
+        return NULL;
+    }
+    if (obfuscated && !(obfuscated = stringPoolIntern(&table->names, obfuscated, strlen(obfuscated)))) {
+        return NULL;
+    }
     
-    while (*pos) {
-        if (*pos == '"') {
-            // Found string literal
-            pos++; // Skip opening quote
-            char string_literal[1024];
-            int len = 0;
-            
-            // Extract string content
-            while (*pos && *pos != '"' && len < 1023) {
-                if (*pos == '\\' && *(pos + 1)) {
-                    string_literal[len++] = *pos++; // Copy escape character
-                    string_literal[len++] = *pos++; // Copy escaped character
-                } else {
-                    string_literal[len++] = *pos++;
-                }
-            }
-            string_literal[len] = '\0';
-            
-            if (*pos == '"') {
-                pos++; // Skip closing quote
-                
-                // Encrypt the string
-                char* encrypted = encryptString(string_literal, key);
-                if (encrypted) {
-                    sprintf(options->strings[options->stringCount].varName, "_str_%d", options->stringCount);
-                    strcpy(options->strings[options->stringCount].original, string_literal);
-                    strcpy(options->strings[options->stringCount].encrypted, encrypted);
-                    
-                    // Add variable declaration
-                    sprintf(output, "static char* %s = NULL;\n", options->strings[options->stringCount].varName);
-                    output += strlen(output);
-                    
-                    sprintf(output, "if (!%s) %s = _decrypt_str(\"%s\", \"%s\");\n", 
-                           options->strings[options->stringCount].varName,
-                           options->strings[options->stringCount].varName,
-                           encrypted, key);
-                    output += strlen(output);
-                    
-                    // Replace in code with variable reference
-                    sprintf(output, "%s", options->strings[options->stringCount].varName);
-                    output += strlen(options->strings[options->stringCount].varName);
-                    
-                    options->stringCount++;
-                    free(encrypted);
-                }
-            }
-        } else {
-            *output++ = *pos++;
-        }
+    size_t mask = table->capacity - 1;
+    size_t i = hash & mask;
+    while (table->entries[i].original) {
+        i = (i + 1) & mask;
     }
-    *output = '\0';
     
-    return result;
+    IdentifierMap* entry = &table->entries[i];
+    entry->original = original;
+    entry->obfuscated = obfuscated;
+    entry->length = length;
+    entry->hash = hash;
+    table->count++;
+    return entry;
 }
 
-char* addControlFlowObfuscation(const char* code) {
-    char* result = malloc(strlen(code) * 2);
-    strcpy(result, code);
+void identifierTableFree(IdentifierTable* table) {
+    free(table->entries);
+    table->entries = NULL;
+    table->capacity = 0;
+    table->count = 0;
+    stringPoolFree(&table->names);
+}
+
+static int bufferReserve(Buffer* buffer, size_t additional) {
+    if (buffer->length + additional + 1 <= buffer->capacity) {
+        return 1;
+    }
     
-    // Simple control flow obfuscation - convert if statements to switch
-    // This is a simplified implementation
-    char* pos = strstr(result, "if (");
-    while (pos) {
-        // Find the condition and blocks
-        char* condition_start = pos + 4;
-        char* condition_end = strchr(condition_start, ')');
-        
-        if (condition_end) {
-            char condition[256];
-            int cond_len = condition_end - condition_start;
-            strncpy(condition, condition_start, cond_len);
-            condition[cond_len] = '\0';
-            
-            // Replace with switch statement
-            char replacement[1024];
-            sprintf(replacement, "switch((%s) ? 1 : 0) { case 1:", condition);
-            
-            // This is a simplified replacement - full implementation would be more complex
-            // For now, just mark the location
-            strncpy(pos, replacement, strlen(replacement));
-        }
-        
-        pos = strstr(pos + 1, "if (");
+    size_t capacity = buffer->capacity ? buffer->capacity : 256;
+    while (capacity < buffer->length + additional + 1) {
+        capacity *= 2;
     }
     
-    return result;
+    char* data = realloc(buffer->data, capacity);
+    if (!data) {
+        return 0;
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return 1;
 }
 
-char* addDeadCode(const char* code) {
-    char* result = malloc(strlen(code) * 2);
-    
-    char* deadCodeSnippets[] = {
-        "int _dummy1 = rand() % 100;\n",
-        "volatile int _dummy2 = time(NULL) & 0xFF;\n",
-        "if (_dummy1 > 200) { printf(\"Never executed\"); }\n",
-        "for (int _i = 0; _i < 0; _i++) { _dummy2++; }\n"
-    };
-    
-    strcpy(result, code);
-    
-    // Insert dead code at random positions
-    srand(time(NULL));
-    for (int i = 0; i < 4; i++) {
-        char* insertion_point = strchr(result, '{');
-        if (insertion_point) {
-            insertion_point++; // Move past the '{'
-            
-            // Insert dead code
-            memmove(insertion_point + strlen(deadCodeSnippets[i]), 
-                   insertion_point, 
-                   strlen(insertion_point) + 1);
-            memcpy(insertion_point, deadCodeSnippets[i], strlen(deadCodeSnippets[i]));
+static int bufferAppend(Buffer* buffer, const char* data, size_t length) {
+    if (!bufferReserve(buffer, length)) {
+        return 0;
+    }
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+    return 1;
+}
+
+// Pass bytes on to the file or sink function
+static void writerEmit(OutputWriter* writer, const char* data, size_t length) {
+    if (writer->error) {
+        return;
+    }
+    if (writer->file ? fwrite(data, 1, length, writer->file) != length
+                     : writer->sink(writer->sinkContext, data, length) != 0) {
+        writer->error = 1;
+    }
+    writer->flushed += length;
+}
+
+static int writerFlush(OutputWriter* writer) {
+    if ((writer->file || writer->sink) && writer->buffer.length > 0) {
+        writerEmit(writer, writer->buffer.data, writer->buffer.length);
+        writer->buffer.length = 0;
+    }
+    return !writer->error;
+}
+
+static void writerWrite(OutputWriter* writer, const char* data, size_t length) {
+    if ((writer->file || writer->sink) && writer->buffer.length + length > WRITER_FLUSH_SIZE) {
+        writerFlush(writer);
+        if (length >= WRITER_FLUSH_SIZE) {
+            writerEmit(writer, data, length);
+            return;
         }
     }
-    
-    return result;
+    if (!bufferAppend(&writer->buffer, data, length)) {
+        writer->error = 1;
+    }
 }
 
-char* addAntiDebugging(const char* code) {
-    char* result = malloc(strlen(code) * 2);
-    
-    char* antiDebugCode = 
-        "\n// Anti-debugging measures\n"
-        "#include <sys/ptrace.h>\n"
-        "#include <signal.h>\n"
-        "\nvoid anti_debug_check() {\n"
-        "    if (ptrace(PTRACE_TRACEME, 0, 1, 0) == -1) {\n"
-        "        exit(1);\n"
-        "    }\n"
-        "    \n"
-        "    // Timing check\n"
-        "    clock_t start = clock();\n"
-        "    volatile int dummy = 0;\n"
-        "    for (int i = 0; i < 1000; i++) dummy++;\n"
-        "    clock_t end = clock();\n"
-        "    \n"
-        "    if ((end - start) > 10000) {\n"
-        "        exit(1);\n"
-        "    }\n"
-        "}\n\n";
-    
-    strcpy(result, antiDebugCode);
-    strcat(result, code);
-    
-    // Insert anti-debug call at the beginning of main
-    char* main_pos = strstr(result, "int main(");
-    if (main_pos) {
-        char* brace_pos = strchr(main_pos, '{');
-        if (brace_pos) {
-            brace_pos++; // Move past the '{'
-            
-            char* call = "\n    anti_debug_check();\n";
-            memmove(brace_pos + strlen(call), brace_pos, strlen(brace_pos) + 1);
-            memcpy(brace_pos, call, strlen(call));
+// Read a --preserve file into `table`: names separated by whitespace, '#'
+// starts a comment
+int preserveListLoad(const char* path, IdentifierTable* table) {
+    size_t length = 0;
+    const char* data = mapFile(path, &length);
+    if (!data) {
+        return 0;
+    }
+    int ok = 1;
+    size_t i = 0;
+    while (ok && i < length) {
+        if (data[i] == '#') {
+            while (i < length && data[i] != '\n') {
+                i++;
+            }
+        } else if (isspace((unsigned char)data[i])) {
+            i++;
+        } else {
+            size_t start = i;
+            while (i < length && !isspace((unsigned char)data[i]) && data[i] != '#') {
+                i++;
+            }
+            unsigned int hash = hashIdentifier(data + start, i - start);
+            ok = identifierTableFind(table, data + start, i - start, hash) ||
+                 identifierTableInsert(table, data + start, i - start, hash, NULL);
         }
     }
-    
-    return result;
+    unmapFile(data, length);
+    return ok;
 }
 
-char* processCode(const char* code, CProcessorOptions* options) {
-    char* result = malloc(strlen(code) * 4);
-    strcpy(result, code);
-    
-    // Apply obfuscations based on options
-    if (options->stringEncrypt) {
-        char* temp = encryptStrings(result, options->encryptionKey, options);
-        free(result);
-        result = temp;
+// Words starting with a digit are numbers, not identifiers. `hash` is the
+// word's hashIdentifier(), so both lookups reuse it.
+static int isObfuscatable(const char* word, size_t len, unsigned int hash, IdentifierTable* preserved) {
+    if (isdigit((unsigned char)*word) || len < 2) {
+        return 0;
     }
-    
-    if (options->controlFlow) {
-        char* temp = addControlFlowObfuscation(result);
-        free(result);
-        result = temp;
+    return !reservedNameFind(word, len, hash) && !(preserved && identifierTableFind(preserved, word, len, hash));
+}
+
+// Vectorized lexing for the string and identifier passes. A block of
+// SCAN_BLOCK_SIZE bytes is classified at once into one bit mask per
+// character class, and the passes jump straight to the next byte of the
+// classes they look for instead of testing every byte. AVX2 classifies a
+// block in one step, SSE2 in two. Other CPUs and the last partial block
+// walk a byte class table.
+enum {
+    SCAN_IDENTIFIER_START = 1,   // [A-Za-z_]
+    SCAN_IDENTIFIER = 2,         // [A-Za-z0-9_]
+    SCAN_QUOTE = 4,              // " and '
+    SCAN_BACKSLASH = 8,
+    SCAN_SLASH = 16,             // a possible comment start or end
+    SCAN_HASH = 32,              // a possible directive
+    SCAN_NOT_IDENTIFIER = 64,    // anything SCAN_IDENTIFIER is not
+    SCAN_STRUCTURE = 128         // { } and ;
+};
+
+typedef struct {
+    uint32_t identifierStart;
+    uint32_t identifier;
+    uint32_t quote;
+    uint32_t backslash;
+    uint32_t slash;
+    uint32_t hash;
+    uint32_t structure;
+} ScanMasks;
+
+// Classified bytes [block, block + SCAN_BLOCK_SIZE) of the input [begin, end)
+typedef struct {
+    const char* begin;
+    const char* end;
+    const char* block;
+    ScanMasks masks;
+    // The two class sets asked for last in this block, selected from masks;
+    // a pass alternates between the start and the end of a token
+    unsigned selected[2];
+    uint32_t selectedBits[2];
+} Scanner;
+
+typedef enum {
+    SCAN_TOKEN_END,
+    SCAN_TOKEN_IDENTIFIER,  // also numbers, which start with a digit
+    SCAN_TOKEN_STRING       // including its prefix and quotes
+} ScanTokenKind;
+
+// Classes of every byte value, filled in by scanInit
+static unsigned char scanByteClasses[256];
+
+#ifdef SCAN_X86
+__attribute__((target("avx2")))
+static void scanClassifyAvx2(const char* p, ScanMasks* masks) {
+    __m256i bytes = _mm256_loadu_si256((const __m256i*)p);
+    // Unsigned range checks: x - low <= high - low, as min(x - low, high - low) == x - low
+    __m256i letter = _mm256_sub_epi8(_mm256_or_si256(bytes, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    __m256i digit = _mm256_sub_epi8(bytes, _mm256_set1_epi8('0'));
+    __m256i start = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(25)), letter),
+                                    _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('_')));
+    __m256i identifier = _mm256_or_si256(start, _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit));
+    __m256i quote = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('"')),
+                                    _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\'')));
+    masks->identifierStart = (uint32_t)_mm256_movemask_epi8(start);
+    masks->identifier = (uint32_t)_mm256_movemask_epi8(identifier);
+    masks->quote = (uint32_t)_mm256_movemask_epi8(quote);
+    masks->backslash = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\\')));
+    masks->slash = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('/')));
+    masks->hash = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('#')));
+    __m256i structure = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('{')),
+                                                        _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('}'))),
+                                        _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(';')));
+    masks->structure = (uint32_t)_mm256_movemask_epi8(structure);
+}
+
+// Two 16-byte halves with the same range checks. SSE4.2's string compares
+// can match the identifier ranges directly, but measured slower than this.
+__attribute__((target("sse2")))
+static void scanClassifySse2(const char* p, ScanMasks* masks) {
+    memset(masks, 0, sizeof(*masks));
+    for (int half = 0; half < 2; half++) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(p + 16 * half));
+        int shift = 16 * half;
+        __m128i letter = _mm_sub_epi8(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+        __m128i digit = _mm_sub_epi8(bytes, _mm_set1_epi8('0'));
+        __m128i start = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(25)), letter),
+                                     _mm_cmpeq_epi8(bytes, _mm_set1_epi8('_')));
+        __m128i identifier = _mm_or_si128(start, _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit));
+        __m128i quote = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\'')));
+        masks->identifierStart |= (uint32_t)_mm_movemask_epi8(start) << shift;
+        masks->identifier |= (uint32_t)_mm_movemask_epi8(identifier) << shift;
+        masks->quote |= (uint32_t)_mm_movemask_epi8(quote) << shift;
+        masks->backslash |= (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\'))) << shift;
+        masks->slash |= (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('/'))) << shift;
+        masks->hash |= (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('#'))) << shift;
+        __m128i structure = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('{')),
+                                                      _mm_cmpeq_epi8(bytes, _mm_set1_epi8('}'))),
+                                         _mm_cmpeq_epi8(bytes, _mm_set1_epi8(';')));
+        masks->structure |= (uint32_t)_mm_movemask_epi8(structure) << shift;
     }
-    
-    if (options->deadCode) {
-        char* temp = addDeadCode(result);
-        free(result);
-        result = temp;
+}
+#endif
+
+// Classifier for full blocks, chosen once for the CPU; NULL: table only
+static void (*scanClassifyBlock)(const char* p, ScanMasks* masks);
+
+__attribute__((constructor))
+static void scanInit(void) {
+    for (int c = 0; c < 256; c++) {
+        unsigned char classes = SCAN_NOT_IDENTIFIER;
+        if (((c | 0x20) >= 'a' && (c | 0x20) <= 'z') || c == '_') {
+            classes = SCAN_IDENTIFIER_START | SCAN_IDENTIFIER;
+        } else if (c >= '0' && c <= '9') {
+            classes = SCAN_IDENTIFIER;
+        } else if (c == '"' || c == '\'') {
+            classes |= SCAN_QUOTE;
+        } else if (c == '\\') {
+            classes |= SCAN_BACKSLASH;
+        } else if (c == '/') {
+            classes |= SCAN_SLASH;
+        } else if (c == '#') {
+            classes |= SCAN_HASH;
+        } else if (c == '{' || c == '}' || c == ';') {
+            classes |= SCAN_STRUCTURE;
+        }
+        scanByteClasses[c] = classes;
     }
-    
-    if (options->antiDebug) {
-        char* temp = addAntiDebugging(result);
-        free(result);
-        result = temp;
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        scanClassifyBlock = scanClassifyAvx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        scanClassifyBlock = scanClassifySse2;
     }
-    
-    // Always obfuscate identifiers last
-    char* temp = obfuscateIdentifiers(result, options);
-    free(result);
-    result = temp;
-    
-    return result;
+#endif
 }
 
-// Main processor interface
-int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        printf("Usage: %s <input_file> [options]\n", argv[0]);
-        return 1;
+static void scannerInit(Scanner* scanner, const char* code, size_t length) {
+    scanner->begin = code;
+    scanner->end = code + length;
+    scanner->block = scanner->end;
+}
+
+static uint32_t scanSelect(const ScanMasks* masks, unsigned classes) {
+    uint32_t bits = 0;
+    bits |= classes & SCAN_IDENTIFIER_START ? masks->identifierStart : 0;
+    bits |= classes & SCAN_IDENTIFIER ? masks->identifier : 0;
+    bits |= classes & SCAN_QUOTE ? masks->quote : 0;
+    bits |= classes & SCAN_BACKSLASH ? masks->backslash : 0;
+    bits |= classes & SCAN_SLASH ? masks->slash : 0;
+    bits |= classes & SCAN_HASH ? masks->hash : 0;
+    bits |= classes & SCAN_NOT_IDENTIFIER ? ~masks->identifier : 0;
+    bits |= classes & SCAN_STRUCTURE ? masks->structure : 0;
+    return bits;
+}
+
+// First byte at or after `pos` in one of `classes`, or the end. Inlined so
+// the scanner state stays in registers across a pass's token loop.
+__attribute__((always_inline))
+static inline const char* scannerFind(Scanner* scanner, const char* pos, unsigned classes) {
+    while (scanClassifyBlock && scanner->end - pos >= SCAN_BLOCK_SIZE) {
+        if (pos < scanner->block || pos >= scanner->block + SCAN_BLOCK_SIZE) {
+            scanner->block = pos;
+            scanClassifyBlock(pos, &scanner->masks);
+            scanner->selected[0] = scanner->selected[1] = 0;
+        }
+        uint32_t bits;
+        if (scanner->selected[0] == classes) {
+            bits = scanner->selectedBits[0];
+        } else if (scanner->selected[1] == classes) {
+            bits = scanner->selectedBits[1];
+        } else {
+            bits = scanSelect(&scanner->masks, classes);
+            scanner->selected[1] = scanner->selected[0];
+            scanner->selectedBits[1] = scanner->selectedBits[0];
+            scanner->selected[0] = classes;
+            scanner->selectedBits[0] = bits;
+        }
+        bits >>= pos - scanner->block;
+        if (bits) {
+            return pos + __builtin_ctz(bits);
+        }
+        pos = scanner->block + SCAN_BLOCK_SIZE;
     }
-    
-    // Initialize options
-    CProcessorOptions options = {0};
-    strcpy(options.encryptionKey, "default_encryption_key_32_chars_");
-    options.antiDebug = 1;
-    options.controlFlow = 1;
-    options.deadCode = 1;
-    options.stringEncrypt = 1;
-    
-    // Read input file
-    FILE* file = fopen(argv[1], "r");
-    if (!file) {
-        printf("Error: Cannot open file %s\n", argv[1]);
-        return 1;
+    while (pos < scanner->end && !(scanByteClasses[(unsigned char)*pos] & classes)) {
+        pos++;
+    }
+    return pos;
+}
+
+// Past the closing quote of the literal that opens at `open`, or NULL when
+// it is unterminated
+static const char* scanLiteralEnd(Scanner* scanner, const char* open) {
+    const char* pos = open + 1;
+    while ((pos = scannerFind(scanner, pos, SCAN_QUOTE | SCAN_BACKSLASH)) < scanner->end) {
+        if (*pos == *open) {
+            return pos + 1;
+        }
+        pos += (*pos == '\\' && pos + 1 < scanner->end) ? 2 : 1;
+    }
+    return NULL;
+}
+
+// End of the line when `hash` starts an #include or #import of a header
+// name, which must stay as written; NULL otherwise
+static const char* scanIncludeEnd(const Scanner* scanner, const char* hash) {
+    const char* c = hash;
+    while (c > scanner->begin && (c[-1] == ' ' || c[-1] == '\t')) {
+        c--;
+    }
+    if (c > scanner->begin && c[-1] != '\n') {
+        return NULL;
+    }
+    for (c = hash + 1; c < scanner->end && (*c == ' ' || *c == '\t'); c++) {
+    }
+    size_t rest = scanner->end - c;
+    size_t word = rest >= 7 && memcmp(c, "include", 7) == 0 ? 7 : rest >= 6 && memcmp(c, "import", 6) == 0 ? 6 : 0;
+    if (word == 0) {
+        return NULL;
+    }
+    for (c += word; c < scanner->end && (*c == ' ' || *c == '\t'); c++) {
+    }
+    if (c == scanner->end || (*c != '<' && *c != '"')) {
+        return NULL;  // a macro, renamed like its definition
+    }
+    const char* newline = memchr(c, '\n', scanner->end - c);
+    return newline ? newline : scanner->end;
+}
+
+// Next string literal at or after `pos`, and with `identifiers` also the
+// next identifier, as [*start, *stop). Comments, character literals and
+// #include header names are skipped; an unterminated literal or comment
+// ends the scan. Without identifiers the scan only stops at quotes,
+// slashes and hashes, so it skips over most of the code a block at a time.
+__attribute__((always_inline))
+static inline ScanTokenKind scanNextToken(Scanner* scanner, const char* pos, int identifiers, const char** start, const char** stop) {
+    const char* end = scanner->end;
+    unsigned classes = SCAN_QUOTE | SCAN_SLASH | SCAN_HASH | (identifiers ? SCAN_IDENTIFIER : 0);
+    while ((pos = scannerFind(scanner, pos, classes)) < end) {
+        // A word, which may be the prefix of a literal (L, u, U, u8)
+        const char* word = pos;
+        unsigned char kind = scanByteClasses[(unsigned char)*pos];
+        if (kind & SCAN_IDENTIFIER) {
+            pos = scannerFind(scanner, pos, SCAN_NOT_IDENTIFIER);
+            size_t length = pos - word;
+            if (pos == end || !(scanByteClasses[(unsigned char)*pos] & SCAN_QUOTE) ||
+                !((length == 1 && (*word == 'L' || *word == 'u' || *word == 'U')) ||
+                  (length == 2 && word[0] == 'u' && word[1] == '8'))) {
+                *start = word;
+                *stop = pos;
+                return SCAN_TOKEN_IDENTIFIER;
+            }
+        } else if (kind & SCAN_SLASH) {
+            if (pos + 1 < end && pos[1] == '/') {
+                const char* newline = memchr(pos, '\n', end - pos);
+                pos = newline ? newline : end;
+            } else if (pos + 1 < end && pos[1] == '*') {
+                // The first '/' after "/*x" that follows a '*'
+                const char* close = pos + 3;
+                while ((close = scannerFind(scanner, close, SCAN_SLASH)) < end && close[-1] != '*') {
+                    close++;
+                }
+                if (close >= end) {
+                    return SCAN_TOKEN_END;
+                }
+                pos = close + 1;
+            } else {
+                pos++;
+            }
+            continue;
+        } else if (kind & SCAN_HASH) {
+            const char* includeEnd = scanIncludeEnd(scanner, pos);
+            pos = includeEnd ? includeEnd : pos + 1;
+            continue;
+        }
+        
+        const char* close = scanLiteralEnd(scanner, pos);
+        if (!close) {
+            return SCAN_TOKEN_END;
+        }
+        if (!identifiers) {
+            // The prefix was not scanned; look back for it
+            const char* before = pos;
+            if (before - scanner->begin >= 2 && before[-2] == 'u' && before[-1] == '8') {
+                before -= 2;
+            } else if (before > scanner->begin && (before[-1] == 'L' || before[-1] == 'u' || before[-1] == 'U')) {
+                before--;
+            }
+            int prefixed = before < pos && (before == scanner->begin ||
+                                            (!isalnum((unsigned char)before[-1]) && before[-1] != '_'));
+            word = prefixed ? before : pos;
+        }
+        if (*pos == '"') {
+            *start = word;
+            *stop = close;
+            return SCAN_TOKEN_STRING;
+        }
+        pos = close;  // a character literal
+    }
+    return SCAN_TOKEN_END;
+}
+
+// Collect the identifiers of one file into `local` and resolve all of them
+// against the shared table under a single lock
+static int resolveSharedIdentifiers(const char* code, size_t length, SharedIdentifiers* shared, size_t turn, IdentifierTable* local,
+                                    IdentifierTable* preserved) {
+    Scanner scanner;
+    scannerInit(&scanner, code, length);
+    const char* start;
+    const char* pos = code;
+    for (ScanTokenKind kind; (kind = scanNextToken(&scanner, pos, 1, &start, &pos)) != SCAN_TOKEN_END;) {
+        if (kind != SCAN_TOKEN_IDENTIFIER) {
+            continue;
+        }
+        
+        size_t len = pos - start;
+        unsigned int hash = hashIdentifier(start, len);
+        if (isObfuscatable(start, len, hash, preserved) && !identifierTableFind(local, start, len, hash) &&
+            !identifierTableInsert(local, start, len, hash, NULL)) {
+            return 0;
+        }
+    }
+    
+    int ok = 1;
+    pthread_mutex_lock(&shared->lock);
+    while (shared->ordered && shared->nextTurn < turn) {
+        pthread_cond_wait(&shared->turnChanged, &shared->lock);
+    }
+    for (size_t i = 0; i < local->capacity && ok; i++) {
+        IdentifierMap* entry = &local->entries[i];
+        if (!entry->original) {
+            continue;
+        }
+        
+        IdentifierMap* global = identifierTableFind(&shared->table, entry->original, entry->length, entry->hash);
+        if (!global) {
+            char obfuscated[NAME_GENERATOR_BUFFER_SIZE];
+            nameGeneratorNext(&shared->table.generator, obfuscated);
+            global = identifierTableInsert(&shared->table, entry->original, entry->length, entry->hash, obfuscated);
+            if (!global) {
+                ok = 0;
+                break;
+            }
+        }
+        entry->obfuscated = stringPoolIntern(&local->names, global->obfuscated, strlen(global->obfuscated));
+        ok = entry->obfuscated != NULL;
+    }
+    if (shared->ordered && shared->nextTurn == turn) {
+        shared->nextTurn++;
+        pthread_cond_broadcast(&shared->turnChanged);
+    }
+    pthread_mutex_unlock(&shared->lock);
+    return ok;
+}
+
+// Give up this file's turn without drawing names
+static void sharedIdentifiersSkipTurn(SharedIdentifiers* shared, size_t turn) {
+    if (!shared->ordered) {
+        return;
+    }
+    pthread_mutex_lock(&shared->lock);
+    while (shared->nextTurn < turn) {
+        pthread_cond_wait(&shared->turnChanged, &shared->lock);
+    }
+    if (shared->nextTurn == turn) {
+        shared->nextTurn++;
+        pthread_cond_broadcast(&shared->turnChanged);
+    }
+    pthread_mutex_unlock(&shared->lock);
+}
+
+int obfuscateIdentifiers(const char* code, size_t length, CProcessorOptions* options, OutputWriter* out) {
+    // In project mode every name this file needs is resolved up front, so
+    // the rewrite below only reads the file's own table
+    IdentifierTable* table = &options->identifiers;
+    if (options->shared &&
+        !resolveSharedIdentifiers(code, length, options->shared, options->turn, table, options->preserved)) {
+        return 0;
+    }
+    
+    // Single pass: look each identifier up in the hash table, create a mapping
+    // on first sight and emit the renamed token straight into the output.
+    // Literals, comments and header names are copied through.
+    Scanner scanner;
+    scannerInit(&scanner, code, length);
+    const char* start;
+    const char* pos = code;
+    const char* copied = code;
+    for (ScanTokenKind kind; (kind = scanNextToken(&scanner, pos, 1, &start, &pos)) != SCAN_TOKEN_END;) {
+        size_t len = pos - start;
+        if (kind != SCAN_TOKEN_IDENTIFIER || isdigit((unsigned char)*start) || len < 2) {
+            continue;
+        }
+        
+        unsigned int hash = hashIdentifier(start, len);
+        IdentifierMap* entry = identifierTableFind(table, start, len, hash);
+        if (!entry) {
+            if (options->shared || !isObfuscatable(start, len, hash, options->preserved)) {
+                continue;
+            }
+            
+            char obfuscated[NAME_GENERATOR_BUFFER_SIZE];
+            nameGeneratorNext(&table->generator, obfuscated);
+            entry = identifierTableInsert(table, start, len, hash, obfuscated);
+            if (!entry) {
+                continue;
+            }
+        }
+        
+        writerWrite(out, copied, start - copied);
+        writerWrite(out, entry->obfuscated, strlen(entry->obfuscated));
+        copied = pos;
+    }
+    writerWrite(out, copied, code + length - copied);
+    
+    return !out->error;
+}
+
+// Bytes of a literal body with its escape sequences resolved, appended to
+// `out`. Fails on universal character names, whose bytes depend on the
+// execution character set, and on escapes that do not fit a byte.
+static int literalUnescape(const char* body, size_t length, Buffer* out) {
+    const char* end = body + length;
+    while (body < end) {
+        const char* escape = memchr(body, '\\', end - body);
+        if (!escape) {
+            return bufferAppend(out, body, end - body);
+        }
+        if (!bufferAppend(out, body, escape - body) || escape + 1 == end) {
+            return 0;
+        }
+        
+        body = escape + 2;
+        unsigned int value = 0;
+        char byte;
+        switch (escape[1]) {
+        case 'n': byte = '\n'; break;
+        case 't': byte = '\t'; break;
+        case 'r': byte = '\r'; break;
+        case 'a': byte = '\a'; break;
+        case 'b': byte = '\b'; break;
+        case 'f': byte = '\f'; break;
+        case 'v': byte = '\v'; break;
+        case 'u':
+        case 'U':
+            return 0;
+        case '\r':
+            body += body < end && *body == '\n';
+            continue;  // line continuation
+        case '\n':
+            continue;
+        case 'x':
+            if (body == end || !isxdigit((unsigned char)*body)) {
+                return 0;
+            }
+            for (; body < end && isxdigit((unsigned char)*body); body++) {
+                value = value * 16 + (isdigit((unsigned char)*body) ? *body - '0' : (*body | 0x20) - 'a' + 10);
+                if (value > 0xFF) {
+                    return 0;
+                }
+            }
+            byte = (char)value;
+            break;
+        case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7':
+            value = escape[1] - '0';
+            for (int digits = 1; digits < 3 && body < end && *body >= '0' && *body <= '7'; digits++) {
+                value = value * 8 + (*body++ - '0');
+            }
+            if (value > 0xFF) {
+                return 0;
+            }
+            byte = (char)value;
+            break;
+        default:
+            byte = escape[1];  // \\ \" \' \?
+            break;
+        }
+        if (!bufferAppend(out, &byte, 1)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Where the string pass is in the code: the open braces, each with whether
+// it holds statements, and where the current statement starts. Only
+// literals in the statements of a function body can become calls;
+// file-scope, static and brace initializers must be constant.
+typedef struct {
+    Scanner scanner;        // its own, so the literal scan keeps its block
+    Buffer braces;          // one byte per open brace: 1 for a block of statements
+    const char* statement;  // first byte after the last ';', '{' or '}'
+} LiteralContext;
+
+static int wordBefore(const char* code, const char* at, const char* word, size_t length) {
+    return (size_t)(at - code) >= length && memcmp(at - length, word, length) == 0 &&
+           (at - code == (ptrdiff_t)length || !(isalnum((unsigned char)at[-length - 1]) || at[-length - 1] == '_'));
+}
+
+// Follow the braces and statements of [from, to), code between two string
+// literals. It holds no string literals but header names, comments and
+// character literals, which are skipped.
+static int literalContextAdvance(LiteralContext* context, const char* code, const char* from, const char* to) {
+    for (const char* p = from; (p = scannerFind(&context->scanner, p, SCAN_STRUCTURE | SCAN_SLASH | SCAN_QUOTE)) < to; p++) {
+        char c = *p;
+        if (c == '/' && p + 1 < to && p[1] == '/') {
+            const char* newline = memchr(p, '\n', to - p);
+            p = newline ? newline : to;
+        } else if (c == '/' && p + 1 < to && p[1] == '*') {
+            for (p += 2; p + 1 < to && !(p[0] == '*' && p[1] == '/'); p++) {
+            }
+            p++;
+        } else if (c == '\'' || c == '"') {
+            for (p++; p < to && *p != c && *p != '\n'; p++) {
+                p += *p == '\\';
+            }
+        } else if (c == '{') {
+            // A block follows a parameter list, a condition, else or do,
+            // or sits among the statements of another block
+            const char* before = p;
+            while (before > code && isspace((unsigned char)before[-1])) {
+                before--;
+            }
+            char previous = before > code ? before[-1] : ';';
+            int inBlock = context->braces.length > 0 && context->braces.data[context->braces.length - 1];
+            char block = previous == ')' || wordBefore(code, before, "else", 4) || wordBefore(code, before, "do", 2) ||
+                         (inBlock && (previous == ';' || previous == '{' || previous == '}' || previous == ':'));
+            if (!bufferAppend(&context->braces, &block, 1)) {
+                return 0;
+            }
+            context->statement = p + 1;
+        } else if (c != '/') {
+            if (c == '}' && context->braces.length > 0) {
+                context->braces.length--;
+            }
+            context->statement = p + 1;
+        }
+    }
+    return 1;
+}
+
+// Whether a literal at `literal` sits in a statement of a block and the
+// statement does not declare something static
+static int literalContextInStatement(const LiteralContext* context, const char* literal) {
+    if (context->braces.length == 0 || !context->braces.data[context->braces.length - 1]) {
+        return 0;
+    }
+    const char* word = context->statement;
+    for (int words = 0; words < 3 && word < literal; words++) {
+        while (word < literal && isspace((unsigned char)*word)) {
+            word++;
+        }
+        const char* stop = word;
+        while (stop < literal && (isalnum((unsigned char)*stop) || *stop == '_')) {
+            stop++;
+        }
+        if (stop - word == 6 && memcmp(word, "static", 6) == 0) {
+            return 0;
+        }
+        if (stop == word) {
+            break;
+        }
+        word = stop;
+    }
+    return 1;
+}
+
+// Literals that have to stay literals: parts of a concatenation, array
+// initializers and operands of directives other than #define
+static int isEncryptableLiteral(const char* code, const char* literal, const char* stop, const char* end) {
+    const char* before = literal;
+    while (before > code && isspace((unsigned char)before[-1])) {
+        before--;
+    }
+    if (before > code && before[-1] == '"') {
+        return 0;
+    }
+    if (before > code && before[-1] == '=') {
+        for (before--; before > code && isspace((unsigned char)before[-1]); before--) {
+        }
+        if (before > code && before[-1] == ']') {
+            return 0;
+        }
+    }
+    
+    const char* after = stop;
+    while (after < end && isspace((unsigned char)*after)) {
+        after++;
+    }
+    if (after < end && *after == '"') {
+        return 0;
+    }
+    
+    const char* line = literal;
+    while (line > code && line[-1] != '\n') {
+        line--;
+    }
+    while (line < literal && (*line == ' ' || *line == '\t')) {
+        line++;
+    }
+    if (*line != '#') {
+        return 1;
+    }
+    for (line++; line < literal && (*line == ' ' || *line == '\t'); line++) {
+    }
+    return literal - line > 6 && strncmp(line, "define", 6) == 0;
+}
+
+// Append `bytes` as three-digit octal escapes, which can never run into
+// the character after them. `position` is the index of the first byte in
+// the whole literal; every 20 bytes the literal continues on a new line.
+static int bufferAppendOctal(Buffer* out, const unsigned char* bytes, size_t length, size_t position) {
+    if (!bufferReserve(out, length * 4 + (length / 20 + 1) * 7)) {
+        return 0;
+    }
+    char* dst = out->data + out->length;
+    for (size_t i = 0; i < length; i++) {
+        if ((position + i) % 20 == 0 && position + i > 0) {
+            memcpy(dst, "\"\n    \"", 7);
+            dst += 7;
+        }
+        *dst++ = '\\';
+        *dst++ = (char)('0' + (bytes[i] >> 6));
+        *dst++ = (char)('0' + ((bytes[i] >> 3) & 7));
+        *dst++ = (char)('0' + (bytes[i] & 7));
+    }
+    out->length = dst - out->data;
+    out->data[out->length] = '\0';
+    return 1;
+}
+
+static int bufferAppendByteLiteral(Buffer* out, const unsigned char* bytes, size_t length) {
+    return bufferAppend(out, "    \"", 5) && bufferAppendOctal(out, bytes, length, 0) && bufferAppend(out, "\";\n", 3);
+}
+
+// A run of up to LITERAL_PART_STRINGS strings of the segment. Its bytes are
+// encrypted and formatted, and its table rows are formatted, independently
+// of the other parts.
+typedef struct {
+    const StringMap* entries;
+    size_t count;
+    size_t firstIndex;          // table index of entries[0]
+    unsigned char* bytes;       // its range of the segment, encrypted in place
+    size_t offset;
+    size_t length;
+    const char* key;
+    const unsigned char* nonce;
+    Buffer table;
+    Buffer segment;
+    int ok;
+} LiteralPart;
+
+typedef struct {
+    LiteralPart* parts;
+    size_t count;
+    size_t next;
+    pthread_mutex_t lock;
+} LiteralParts;
+
+static void literalPartRun(LiteralPart* part) {
+    part->ok = encryptSegment(part->bytes, part->length, part->key, part->nonce, part->offset, part->bytes) &&
+               bufferAppendOctal(&part->segment, part->bytes, part->length, part->offset);
+    for (size_t i = 0; part->ok && i < part->count; i++) {
+        char row[64];
+        int rowLength = snprintf(row, sizeof(row), "%s{%zu, %zu},", (part->firstIndex + i) % 8 ? " " : "\n    ",
+                                 part->entries[i].offset, part->entries[i].length);
+        part->ok = bufferAppend(&part->table, row, rowLength);
+    }
+}
+
+static void* literalPartsWorker(void* arg) {
+    LiteralParts* parts = arg;
+    for (;;) {
+        pthread_mutex_lock(&parts->lock);
+        size_t next = parts->next++;
+        pthread_mutex_unlock(&parts->lock);
+        if (next >= parts->count) {
+            return NULL;
+        }
+        literalPartRun(&parts->parts[next]);
+    }
+}
+
+// Encrypt the plain string literals outside comments and #include lines.
+// Their bytes, each NUL-terminated, are packed into one AES-256-CTR segment
+// that is emitted with an offset/length table, and each literal becomes a
+// call that decrypts its own range of the segment on first use. Prefixed
+// and unterminated literals are copied through unchanged.
+int encryptStrings(const char* code, size_t length, const char* key, CProcessorOptions* options, Buffer* out) {
+    static const char* decryptFunction =
+        "static char _qs_plain[sizeof(_qs_segment)];\n"
+        "static _Atomic unsigned char _qs_ready[sizeof(_qs_table) / sizeof(_qs_table[0])];\n"
+        "static pthread_mutex_t _qs_lock = PTHREAD_MUTEX_INITIALIZER;\n"
+        "\n"
+        "// Decrypt string `index` in place on first use, starting the keystream\n"
+        "// at its own counter block. First uses decrypt under the lock; the\n"
+        "// release store publishes the bytes to later acquire loads.\n"
+        "static char* _qs_str(unsigned int index) {\n"
+        "    unsigned int offset = _qs_table[index][0];\n"
+        "    if (atomic_load_explicit(&_qs_ready[index], memory_order_acquire)) {\n"
+        "        return _qs_plain + offset;\n"
+        "    }\n"
+        "    pthread_mutex_lock(&_qs_lock);\n"
+        "    if (!atomic_load_explicit(&_qs_ready[index], memory_order_relaxed)) {\n"
+        "        unsigned int length = _qs_table[index][1] + 1;\n"
+        "        unsigned int skip = offset % 16;\n"
+        "        unsigned char counter[16];\n"
+        "        unsigned char skipped[16];\n"
+        "        unsigned int carry = 0;\n"
+        "        unsigned int block = offset / 16;\n"
+        "        int written = 0;\n"
+        "        for (int i = 15; i >= 0; i--) {\n"
+        "            carry += _qs_nonce[i] + (block & 0xFF);\n"
+        "            counter[i] = (unsigned char)carry;\n"
+        "            carry >>= 8;\n"
+        "            block >>= 8;\n"
+        "        }\n"
+        "        EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();\n"
+        "        int ok = ctx && EVP_DecryptInit_ex(ctx, EVP_aes_256_ctr(), NULL, _qs_key, counter) == 1 &&\n"
+        "                 (!skip || EVP_DecryptUpdate(ctx, skipped, &written, _qs_segment + offset - skip, (int)skip) == 1) &&\n"
+        "                 EVP_DecryptUpdate(ctx, (unsigned char*)_qs_plain + offset, &written, _qs_segment + offset, (int)length) == 1;\n"
+        "        EVP_CIPHER_CTX_free(ctx);\n"
+        "        if (!ok) {\n"
+        "            pthread_mutex_unlock(&_qs_lock);\n"
+        "            return \"\";\n"
+        "        }\n"
+        "        atomic_store_explicit(&_qs_ready[index], 1, memory_order_release);\n"
+        "    }\n"
+        "    pthread_mutex_unlock(&_qs_lock);\n"
+        "    return _qs_plain + offset;\n"
+        "}\n\n";
+    
+    // Collect the literals and pack their bytes
+    Scanner scanner;
+    scannerInit(&scanner, code, length);
+    StringTable* strings = &options->strings;
+    size_t first = strings->count;
+    Buffer segment = {0};
+    const char* literal;
+    const char* pos = code;
+    const char* scanned = code;  // end of the last literal
+    const char* end = code + length;
+    size_t base = out->length;
+    options->runtimeLength = 0;
+    LiteralContext context = {0};
+    scannerInit(&context.scanner, code, length);
+    context.statement = code;
+    int ok = 1;
+    
+    for (ScanTokenKind kind; ok && (kind = scanNextToken(&scanner, pos, 0, &literal, &pos)) != SCAN_TOKEN_END;) {
+        ok = literalContextAdvance(&context, code, scanned, literal);
+        scanned = pos;
+        if (!ok || *literal != '"' || !literalContextInStatement(&context, literal) || !isEncryptableLiteral(code, literal, pos, end)) {
+            continue;
+        }
+        size_t offset = segment.length;
+        if (!literalUnescape(literal + 1, pos - literal - 2, &segment)) {
+            segment.length = offset;
+            continue;
+        }
+        StringMap* entry = stringTableAdd(strings, literal + 1, pos - literal - 2);
+        ok = entry && bufferAppend(&segment, "", 1);
+        if (ok) {
+            entry->position = literal - code;
+            entry->offset = offset;
+            entry->length = segment.length - offset - 1;
+        }
+    }
+    free(context.braces.data);
+    if (!ok || strings->count == first) {
+        free(segment.data);
+        return ok && bufferAppend(out, code, length);
+    }
+    
+    unsigned char nonce[32];
+    if (options->deterministic) {
+        // HMAC-SHA256(key, "iv:" || file label || ":" || segment index)
+        unsigned char label[3 + sizeof(options->fileLabel) + 1 + 8] = {0};
+        memcpy(label, "iv:", 3);
+        memcpy(label + 3, options->fileLabel, sizeof(options->fileLabel));
+        label[3 + sizeof(options->fileLabel)] = ':';
+        unsigned int nonceLength = 0;
+        ok = HMAC(EVP_sha256(), key, (int)strlen(key), label, sizeof(label), nonce, &nonceLength) != NULL;
+    } else {
+        ok = RAND_bytes(nonce, AES_BLOCK_SIZE) == 1;
+    }
+    
+    // Encrypt and format the segment in parts, on several threads when there
+    // is more than one. A part only depends on its position in the segment,
+    // so the output is the same with any number of threads.
+    size_t count = strings->count - first;
+    LiteralParts parts = {0};
+    parts.count = (count + LITERAL_PART_STRINGS - 1) / LITERAL_PART_STRINGS;
+    parts.parts = calloc(parts.count, sizeof(LiteralPart));
+    ok = ok && parts.parts;
+    for (size_t p = 0; ok && p < parts.count; p++) {
+        LiteralPart* part = &parts.parts[p];
+        part->entries = strings->entries + first + p * LITERAL_PART_STRINGS;
+        part->count = p + 1 < parts.count ? LITERAL_PART_STRINGS : count - p * LITERAL_PART_STRINGS;
+        part->firstIndex = p * LITERAL_PART_STRINGS;
+        part->offset = part->entries[0].offset;
+        part->length = (p + 1 < parts.count ? part->entries[part->count].offset : segment.length) - part->offset;
+        part->bytes = (unsigned char*)segment.data + part->offset;
+        part->key = key;
+        part->nonce = nonce;
+    }
+    if (ok) {
+        int threadCount = options->literalJobs > 1 ? options->literalJobs - 1 : 0;
+        if ((size_t)threadCount >= parts.count) {
+            threadCount = (int)parts.count - 1;
+        }
+        pthread_t* threads = threadCount > 0 ? calloc(threadCount, sizeof(pthread_t)) : NULL;
+        int started = 0;
+        pthread_mutex_init(&parts.lock, NULL);
+        while (threads && started < threadCount && pthread_create(&threads[started], NULL, literalPartsWorker, &parts) == 0) {
+            started++;
+        }
+        literalPartsWorker(&parts);
+        for (int t = 0; t < started; t++) {
+            pthread_join(threads[t], NULL);
+        }
+        pthread_mutex_destroy(&parts.lock);
+        free(threads);
+    }
+    
+    // The segment and its table are plain data: no pointers, so no
+    // relocations, and no base64 to decode at run time
+    const char* head = "\n// Encrypted strings\n#include <pthread.h>\n#include <stdatomic.h>\n#include <string.h>\n#include <openssl/evp.h>\n\nstatic const unsigned char _qs_key[] =\n";
+    ok = ok && bufferReserve(out, length + segment.length * 4 + count * 24 + strlen(decryptFunction)) &&
+         bufferAppend(out, head, strlen(head)) && bufferAppendByteLiteral(out, (const unsigned char*)key, 32) &&
+         bufferAppend(out, "static const unsigned char _qs_nonce[] =\n", 41) &&
+         bufferAppendByteLiteral(out, nonce, AES_BLOCK_SIZE) &&
+         bufferAppend(out, "static const unsigned int _qs_table[][2] = {", 44);
+    for (size_t p = 0; ok && p < parts.count; p++) {
+        ok = parts.parts[p].ok && bufferAppend(out, parts.parts[p].table.data, parts.parts[p].table.length);
+    }
+    ok = ok && bufferAppend(out, "\n};\nstatic const unsigned char _qs_segment[] =\n    \"", 52);
+    for (size_t p = 0; ok && p < parts.count; p++) {
+        ok = bufferAppend(out, parts.parts[p].segment.data, parts.parts[p].segment.length);
+    }
+    ok = ok && bufferAppend(out, "\";\n", 3) && bufferAppend(out, decryptFunction, strlen(decryptFunction));
+    options->runtimeLength = out->length - base;
+    for (size_t p = 0; parts.parts && p < parts.count; p++) {
+        free(parts.parts[p].table.data);
+        free(parts.parts[p].segment.data);
+    }
+    free(parts.parts);
+    free(segment.data);
+    
+    // Splice a call in place of each literal
+    const char* copied = code;
+    for (size_t i = first; ok && i < strings->count; i++) {
+        const StringMap* entry = &strings->entries[i];
+        char call[32];
+        int callLength = snprintf(call, sizeof(call), "_qs_str(%zu)", i - first);
+        ok = bufferAppend(out, copied, code + entry->position - copied) && bufferAppend(out, call, callLength);
+        copied = code + entry->position + strlen(entry->original) + 2;
+    }
+    return ok && bufferAppend(out, copied, end - copied);
+}
+
+// Profile-guided protection. Each hot function's share of the runtime is
+// multiplied by the estimated slowdown of its protection level, and the
+// hottest functions are downgraded until the total fits the overhead
+// budget. Functions that are not in the profile stay fully protected.
+// The default costs, in percent, are estimates from
+// examples/benchmark_runtime.js: dead code calls into libc on function
+// entry, an if-to-switch rewrite is nearly free. --full-cost and
+// --light-cost replace them with the benchmark's numbers for a program.
+#define PROTECTION_FULL_COST 55
+#define PROTECTION_LIGHT_COST 5
+
+static double protectionCost(const HotProfile* profile, ProtectionLevel level) {
+    return level == PROTECTION_FULL ? profile->fullCost : level == PROTECTION_LIGHT ? profile->lightCost : 0;
+}
+
+static int compareHotFunctions(const void* a, const void* b) {
+    return strcmp(((const HotFunction*)a)->name, ((const HotFunction*)b)->name);
+}
+
+ProtectionLevel hotProfileLevel(const HotProfile* profile, const char* name, size_t length) {
+    size_t low = 0, high = profile ? profile->count : 0;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        const char* candidate = profile->functions[middle].name;
+        int order = strncmp(candidate, name, length);
+        if (order == 0) {
+            order = candidate[length] != '\0';
+        }
+        if (order == 0) {
+            return profile->functions[middle].level;
+        }
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return PROTECTION_FULL;
+}
+
+// "void ns::Widget<int>::draw[abi:cxx11](int) const+0x1a" -> "draw", in
+// place; returns the new start of the name
+static char* profileBaseName(char* symbol) {
+    char* offset = strstr(symbol, "+0x");
+    if (offset) {
+        *offset = '\0';
+    }
+    int depth = 0;
+    for (char* c = symbol; *c; c++) {
+        if (*c == '(' && depth == 0) {
+            *c = '\0';
+            break;
+        }
+        depth += *c == '<';
+        depth -= *c == '>' && depth > 0;
+    }
+    for (char* abi; (abi = strstr(symbol, "[abi:")) != NULL;) {
+        char* close = strchr(abi, ']');
+        memmove(abi, close ? close + 1 : abi + strlen(abi), strlen(close ? close + 1 : "") + 1);
+    }
+    size_t length = strlen(symbol);
+    while (length > 0 && symbol[length - 1] == ' ') {
+        symbol[--length] = '\0';
+    }
+    
+    // Drop the template arguments of the function itself
+    depth = 0;
+    for (size_t i = length; i-- > 0 && length > 0 && symbol[length - 1] == '>';) {
+        depth += (symbol[i] == '>') - (symbol[i] == '<');
+        if (depth == 0) {
+            symbol[i] = '\0';
+            break;
+        }
+    }
+    
+    char* name = symbol;
+    for (char* c = symbol; *c; c++) {
+        if ((c[0] == ':' && c[1] == ':') || c[0] == ' ') {
+            name = c + (c[0] == ' ' ? 1 : 2);
+        }
+    }
+    return name;
+}
+
+// Symbol of a perf script frame ("<address> <symbol>+<offset> (<dso>)"),
+// also at the end of a single-line event; NULL when there is none. The
+// line is modified.
+static char* perfFrame(char* line) {
+    size_t length = strlen(line);
+    while (length > 0 && isspace((unsigned char)line[length - 1])) {
+        line[--length] = '\0';
+    }
+    if (length == 0 || line[length - 1] != ')') {
+        return NULL;
+    }
+    char* dso = NULL;
+    for (char* c = line; (c = strstr(c, " (")) != NULL; c++) {
+        dso = c;
+    }
+    if (!dso) {
+        return NULL;
+    }
+    *dso = '\0';
+    
+    char* symbol = strrchr(line, ' ');
+    symbol = symbol ? symbol + 1 : line;
+    char* address = symbol - 1;
+    while (address > line && address[-1] == ' ') {
+        address--;
+    }
+    char* addressEnd = address;
+    while (address > line && isxdigit((unsigned char)address[-1])) {
+        address--;
+    }
+    if (address == addressEnd || (address > line && address[-1] != ' ' && address[-1] != '\t' && address[-1] != ':')) {
+        return NULL;
+    }
+    return *symbol ? symbol : NULL;
+}
+
+static int isNumberText(const char* text) {
+    char* end = NULL;
+    strtod(text, &end);
+    return *text && end && *end == '\0';
+}
+
+static void hotProfileAdd(HotProfile* profile, size_t* capacity, const char* name, double weight) {
+    if (!*name) {
+        return;
+    }
+    for (size_t i = 0; i < profile->count; i++) {
+        if (strcmp(profile->functions[i].name, name) == 0) {
+            profile->functions[i].share = weight < 0 || profile->functions[i].share < 0 ? -1 : profile->functions[i].share + weight;
+            return;
+        }
+    }
+    if (profile->count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        HotFunction* grown = realloc(profile->functions, *capacity * sizeof(HotFunction));
+        if (!grown) {
+            return;
+        }
+        profile->functions = grown;
+    }
+    HotFunction* function = &profile->functions[profile->count];
+    function->name = strdup(name);
+    function->share = weight;
+    function->level = PROTECTION_FULL;
+    profile->count += function->name != NULL;
+}
+
+// Read perf script output, a gprof flat profile or a plain list with one
+// function per line and an optional percentage of the runtime. Listed
+// functions without a percentage are left unprotected.
+int hotProfileLoad(const char* path, double budgetPercent, double fullCostPercent, double lightCostPercent,
+                   HotProfile* profile) {
+    size_t length = 0;
+    const char* data = mapFile(path, &length);
+    if (!data) {
+        return 0;
+    }
+    char* text = malloc(length + 1);
+    if (!text) {
+        unmapFile(data, length);
+        return 0;
+    }
+    memcpy(text, data, length);
+    text[length] = '\0';
+    unmapFile(data, length);
+    
+    int gprof = strstr(text, "Flat profile:") != NULL;
+    int perf = 0;
+    for (char* line = text; !gprof && !perf && line && *line;) {
+        char* next = strchr(line, '\n');
+        size_t lineLength = next ? (size_t)(next - line) : strlen(line);
+        char copy[1024];
+        snprintf(copy, sizeof(copy), "%.*s", (int)(lineLength < sizeof(copy) ? lineLength : sizeof(copy) - 1), line);
+        perf = perfFrame(copy) != NULL;
+        line = next ? next + 1 : NULL;
+    }
+    
+    memset(profile, 0, sizeof(*profile));
+    profile->budget = budgetPercent / 100;
+    profile->fullCost = fullCostPercent / 100;
+    profile->lightCost = lightCostPercent / 100;
+    size_t capacity = 0;
+    double total = 100;
+    int expectLeaf = 0;
+    if (perf) {
+        total = 0;
+    }
+    
+    char* save = NULL;
+    for (char* line = strtok_r(text, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        if (gprof) {
+            // "%time cumulative self [calls self/call total/call] name"
+            if (strstr(line, "Call graph")) {
+                break;
+            }
+            char* numbers[6];
+            int count = 0;
+            char* field = line;
+            while (count < 6) {
+                while (*field == ' ' || *field == '\t') {
+                    field++;
+                }
+                char* end = field + strcspn(field, " \t");
+                char saved = *end;
+                *end = '\0';
+                int numeric = isNumberText(field);
+                *end = saved;
+                if (!numeric) {
+                    break;
+                }
+                numbers[count++] = field;
+                field = end;
+            }
+            if (count >= 3 && *field) {
+                hotProfileAdd(profile, &capacity, profileBaseName(field), strtod(numbers[0], NULL));
+            }
+        } else if (perf) {
+            // One sample per event; the first frame after the event line is
+            // the function the sample landed in
+            if (line[strspn(line, " \t\r")] == '\0') {
+                continue;
+            }
+            int event = line[0] != ' ' && line[0] != '\t';
+            if (!event && !expectLeaf) {
+                continue;
+            }
+            char* symbol = perfFrame(line);
+            total += event;
+            expectLeaf = event && !symbol;
+            if (symbol && strcmp(symbol, "[unknown]") != 0) {
+                hotProfileAdd(profile, &capacity, profileBaseName(symbol), 1);
+            }
+        } else {
+            char* name = line + strspn(line, " \t");
+            if (*name == '#' || *name == '\0' || *name == '\r') {
+                continue;
+            }
+            char* percent = name + strcspn(name, " \t\r");
+            if (*percent) {
+                *percent++ = '\0';
+                percent += strspn(percent, " \t");
+                percent[strcspn(percent, " \t\r")] = '\0';
+            }
+            hotProfileAdd(profile, &capacity, profileBaseName(name), isNumberText(percent) ? strtod(percent, NULL) : -1);
+        }
+    }
+    free(text);
+    
+    for (size_t i = 0; i < profile->count; i++) {
+        HotFunction* function = &profile->functions[i];
+        if (function->share >= 0) {
+            function->share = total > 0 ? function->share / total : 0;
+        } else {
+            function->level = PROTECTION_NONE;
+        }
+    }
+    if (profile->count > 0) {
+        qsort(profile->functions, profile->count, sizeof(HotFunction), compareHotFunctions);
+    }
+    
+    // Downgrade the function that costs the most, one level at a time,
+    // until the estimated overhead is within budget
+    for (;;) {
+        HotFunction* worst = NULL;
+        double worstCost = 0;
+        profile->overhead = 0;
+        for (size_t i = 0; i < profile->count; i++) {
+            HotFunction* function = &profile->functions[i];
+            double cost = (function->share > 0 ? function->share : 0) * protectionCost(profile, function->level);
+            profile->overhead += cost;
+            if (cost > worstCost) {
+                worst = function;
+                worstCost = cost;
+            }
+        }
+        if (profile->overhead <= profile->budget + 1e-12 || !worst) {
+            break;
+        }
+        worst->level = worst->level == PROTECTION_FULL ? PROTECTION_LIGHT : PROTECTION_NONE;
+    }
+    return 1;
+}
+
+void hotProfileFree(HotProfile* profile) {
+    for (size_t i = 0; i < profile->count; i++) {
+        free(profile->functions[i].name);
+    }
+    free(profile->functions);
+    memset(profile, 0, sizeof(*profile));
+}
+
+// Bodies of the top-level functions in `code` whose protection is not full,
+// in source order. Strings, character literals, comments and preprocessor
+// lines are skipped. A '{' at file scope opens a function body when the
+// last thing before it is the ')' of a parameter list after a name.
+static size_t findFunctionSpans(const char* code, size_t length, const HotProfile* profile, FunctionSpan** spans) {
+    size_t count = 0, capacity = 0;
+    *spans = NULL;
+    if (!profile || profile->count == 0) {
+        return 0;
+    }
+    
+    int depth = 0;
+    size_t open = 0;
+    ProtectionLevel level = PROTECTION_FULL;
+    int lineStart = 1;
+    for (size_t i = 0; i < length; i++) {
+        char c = code[i];
+        if (c == '\n') {
+            lineStart = 1;
+            continue;
+        }
+        if (lineStart && c == '#') {
+            while (i < length && code[i] != '\n') {
+                i += code[i] == '\\' ? 2 : 1;
+            }
+            i--;
+            continue;
+        }
+        if (!isspace((unsigned char)c)) {
+            lineStart = 0;
+        }
+        if (c == '/' && i + 1 < length && code[i + 1] == '/') {
+            while (i + 1 < length && code[i + 1] != '\n') {
+                i++;
+            }
+        } else if (c == '/' && i + 1 < length && code[i + 1] == '*') {
+            for (i += 2; i + 1 < length && !(code[i] == '*' && code[i + 1] == '/'); i++) {
+            }
+            i++;
+        } else if (c == '"' || c == '\'') {
+            for (i++; i < length && code[i] != c && code[i] != '\n'; i++) {
+                i += code[i] == '\\';
+            }
+        } else if (c == '{') {
+            if (depth++ == 0) {
+                open = i;
+                level = PROTECTION_FULL;
+                
+                // Back over whitespace to ')', its '(' and the name before it
+                size_t p = i;
+                while (p > 0 && isspace((unsigned char)code[p - 1])) {
+                    p--;
+                }
+                if (p > 0 && code[p - 1] == ')') {
+                    int parens = 0;
+                    while (p > 0) {
+                        p--;
+                        parens += (code[p] == ')') - (code[p] == '(');
+                        if (parens == 0) {
+                            break;
+                        }
+                    }
+                    while (p > 0 && isspace((unsigned char)code[p - 1])) {
+                        p--;
+                    }
+                    size_t end = p;
+                    while (p > 0 && (isalnum((unsigned char)code[p - 1]) || code[p - 1] == '_')) {
+                        p--;
+                    }
+                    if (end > p) {
+                        level = hotProfileLevel(profile, code + p, end - p);
+                    }
+                }
+            }
+        } else if (c == '}' && depth > 0 && --depth == 0 && level != PROTECTION_FULL) {
+            if (count == capacity) {
+                capacity = capacity ? capacity * 2 : 16;
+                FunctionSpan* grown = realloc(*spans, capacity * sizeof(FunctionSpan));
+                if (!grown) {
+                    return count;
+                }
+                *spans = grown;
+            }
+            FunctionSpan span = { open, i, level };
+            (*spans)[count++] = span;
+        }
+    }
+    return count;
+}
+
+// Protection at a byte offset, given the spans from findFunctionSpans
+static ProtectionLevel protectionAt(const FunctionSpan* spans, size_t count, size_t offset) {
+    size_t low = 0, high = count;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (spans[middle].end < offset) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < count && spans[low].start <= offset ? spans[low].level : PROTECTION_FULL;
+}
+
+// Significant token for the structural passes. Whitespace, comments and
+// preprocessor lines are not tokens; a string or character literal is one.
+typedef struct {
+    size_t start;
+    size_t length;
+    char kind;      // 'w' identifier or number, '"' literal, else the punctuation character
+} CToken;
+
+static size_t tokenizeC(const char* code, size_t length, CToken** tokens) {
+    size_t count = 0, capacity = length / 4 + 16;
+    *tokens = malloc(capacity * sizeof(CToken));
+    if (!*tokens) {
+        return 0;
+    }
+    
+    int lineStart = 1;
+    size_t i = 0;
+    while (i < length) {
+        char c = code[i];
+        if (c == '\n') {
+            lineStart = 1;
+            i++;
+            continue;
+        }
+        if (isspace((unsigned char)c)) {
+            i++;
+            continue;
+        }
+        if (lineStart && c == '#') {
+            while (i < length && code[i] != '\n') {
+                i += code[i] == '\\' && i + 1 < length ? 2 : 1;
+            }
+            continue;
+        }
+        lineStart = 0;
+        if (c == '/' && i + 1 < length && code[i + 1] == '/') {
+            while (i < length && code[i] != '\n') {
+                i++;
+            }
+            continue;
+        }
+        if (c == '/' && i + 1 < length && code[i + 1] == '*') {
+            for (i += 2; i + 1 < length && !(code[i] == '*' && code[i + 1] == '/'); i++) {
+            }
+            i = i + 2 < length ? i + 2 : length;
+            continue;
+        }
+        
+        if (count == capacity) {
+            capacity *= 2;
+            CToken* grown = realloc(*tokens, capacity * sizeof(CToken));
+            if (!grown) {
+                return count;
+            }
+            *tokens = grown;
+        }
+        CToken* token = &(*tokens)[count++];
+        token->start = i;
+        if (isalnum((unsigned char)c) || c == '_') {
+            while (i < length && (isalnum((unsigned char)code[i]) || code[i] == '_')) {
+                i++;
+            }
+            token->kind = 'w';
+        } else if (c == '"' || c == '\'') {
+            for (i++; i < length && code[i] != c && code[i] != '\n'; i++) {
+                i += code[i] == '\\';
+            }
+            i += i < length && code[i] == c;
+            token->kind = '"';
+        } else {
+            i++;
+            token->kind = c;
+        }
+        token->length = i - token->start;
+    }
+    return count;
+}
+
+static int tokenIs(const char* code, const CToken* tokens, size_t count, size_t index, const char* word) {
+    size_t length = strlen(word);
+    return index < count && tokens[index].length == length && memcmp(code + tokens[index].start, word, length) == 0;
+}
+
+#define NO_TOKEN ((size_t)-1)
+
+// For every bracket token, the index of its partner; NO_TOKEN for other
+// tokens and for brackets that do not pair up. One pass with a stack.
+static size_t* matchBrackets(const CToken* tokens, size_t count) {
+    size_t* match = malloc((count + 1) * sizeof(size_t));
+    size_t* open = malloc((count + 1) * sizeof(size_t));
+    if (!match || !open) {
+        free(match);
+        free(open);
+        return NULL;
+    }
+    size_t depth = 0;
+    for (size_t i = 0; i < count; i++) {
+        char kind = tokens[i].kind;
+        match[i] = NO_TOKEN;
+        if (kind == '(' || kind == '[' || kind == '{') {
+            open[depth++] = i;
+        } else if (kind == ')' || kind == ']' || kind == '}') {
+            char expected = kind == ')' ? '(' : kind == ']' ? '[' : '{';
+            if (depth > 0 && tokens[open[depth - 1]].kind == expected) {
+                depth--;
+                match[i] = open[depth];
+                match[open[depth]] = i;
+            }
+        }
+    }
+    free(open);
+    return match;
+}
+
+// Jumps in a block that a new switch around it would capture
+#define JUMP_BREAK 1   // break
+#define JUMP_LABEL 2   // case or default label
+
+// For every '{', the jumps its block contains that bind to something
+// outside it. A loop body keeps its breaks, a switch body keeps its breaks
+// and labels; any other block passes them to its parent.
+static unsigned char* blockJumps(const char* code, const CToken* tokens, size_t count, const size_t* match) {
+    unsigned char* jumps = calloc(count + 1, 1);
+    size_t* blocks = malloc((count + 1) * sizeof(size_t));
+    if (!jumps || !blocks) {
+        free(jumps);
+        free(blocks);
+        return NULL;
+    }
+    size_t depth = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (tokens[i].kind == '{') {
+            blocks[depth++] = i;
+        } else if (tokens[i].kind == '}' && depth > 0 && match[i] == blocks[depth - 1]) {
+            size_t open = blocks[--depth];
+            size_t head = open - 1;
+            unsigned char kept = open > 0 && tokenIs(code, tokens, count, head, "do") ? JUMP_BREAK : 0;
+            if (open > 0 && tokens[head].kind == ')' && match[head] != NO_TOKEN && match[head] > 0) {
+                size_t keyword = match[head] - 1;
+                kept = tokenIs(code, tokens, count, keyword, "switch") ? JUMP_BREAK | JUMP_LABEL
+                     : tokenIs(code, tokens, count, keyword, "for") || tokenIs(code, tokens, count, keyword, "while") ? JUMP_BREAK : 0;
+            }
+            if (depth > 0) {
+                jumps[blocks[depth - 1]] |= jumps[open] & ~kept;
+            }
+        } else if (depth > 0 && tokens[i].kind == 'w') {
+            if (tokenIs(code, tokens, count, i, "break")) {
+                jumps[blocks[depth - 1]] |= JUMP_BREAK;
+            } else if (tokenIs(code, tokens, count, i, "case") ||
+                       (tokenIs(code, tokens, count, i, "default") && i + 1 < count && tokens[i + 1].kind == ':')) {
+                jumps[blocks[depth - 1]] |= JUMP_LABEL;
+            }
+        }
+    }
+    free(blocks);
+    return jumps;
+}
+
+// A condition that can be evaluated as `(condition) ? 1 : 0`: no
+// assignment at its top level
+static int isPlainCondition(const CToken* tokens, const size_t* match, size_t open, size_t close) {
+    for (size_t i = open + 1; i < close; i++) {
+        if (match[i] != NO_TOKEN && match[i] > i) {
+            i = match[i];
+        } else if (tokens[i].kind == ';') {
+            return 0;
+        } else if (tokens[i].kind == '=' && tokens[i + 1].kind != '=' && !strchr("=!<>+-*/%&|^", tokens[i - 1].kind)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int addControlFlowObfuscation(const char* code, size_t length, const HotProfile* profile, Buffer* out) {
+    // Convert if / else if / else chains into nested switches:
+    //
+    //   switch ((cond) ? 1 : 0) {
+    //       case 1: { then } break;
+    //       default: { else } or the next link of the chain
+    //   }
+    //
+    // Brackets are matched once up front, so every step is O(1) and nested
+    // blocks are handled by visiting the ifs inside them in turn. Only ifs
+    // that start a statement are rewritten, all bodies must be braced, and a
+    // body must not contain a break or case label that the new switch would
+    // capture. A chain is rewritten whole or not at all.
+    static const char* switchOpen = "switch";
+    static const char* caseThen = ") ? 1 : 0) {\n    case 1:\n        ";
+    static const char* caseElse = "}\n        break;\n    default:\n        ";
+    static const char* switchClose = "}\n        break;\n";
+    
+    CToken* tokens;
+    size_t count = tokenizeC(code, length, &tokens);
+    size_t* match = tokens ? matchBrackets(tokens, count) : NULL;
+    unsigned char* jumps = match ? blockJumps(code, tokens, count, match) : NULL;
+    const char** edits = jumps ? calloc(count + 1, sizeof(char*)) : NULL;
+    size_t* closers = edits ? calloc(count + 1, sizeof(size_t)) : NULL;
+    FunctionSpan* spans;
+    size_t spanCount = findFunctionSpans(code, length, profile, &spans);
+    if (!closers) {
+        free(tokens);
+        free(match);
+        free(jumps);
+        free(edits);
+        free(spans);
+        return 0;
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        if (!tokenIs(code, tokens, count, i, "if") || protectionAt(spans, spanCount, tokens[i].start) == PROTECTION_NONE) {
+            continue;
+        }
+        if (i > 0 && tokens[i - 1].kind != ';' && tokens[i - 1].kind != '{' && tokens[i - 1].kind != '}') {
+            continue;
+        }
+        
+        // Walk the chain; `last` ends up on the '}' closing it
+        size_t links = 0;
+        size_t last = NO_TOKEN;
+        for (size_t link = i; ; ) {
+            size_t open = link + 1;
+            size_t close = open < count && tokens[open].kind == '(' ? match[open] : NO_TOKEN;
+            size_t body = close + 1;
+            if (close == NO_TOKEN || close == open + 1 || body >= count || tokens[body].kind != '{' ||
+                match[body] == NO_TOKEN || jumps[body] != 0 || !isPlainCondition(tokens, match, open, close)) {
+                last = NO_TOKEN;
+                break;
+            }
+            links++;
+            last = match[body];
+            if (!tokenIs(code, tokens, count, last + 1, "else")) {
+                break;
+            }
+            size_t next = last + 2;
+            if (tokenIs(code, tokens, count, next, "if")) {
+                link = next;
+                continue;
+            }
+            last = next < count && tokens[next].kind == '{' && match[next] != NO_TOKEN && jumps[next] == 0
+                 ? match[next] : NO_TOKEN;
+            break;
+        }
+        if (last == NO_TOKEN) {
+            continue;
+        }
+        
+        for (size_t link = i, n = 0; n < links; n++) {
+            size_t close = match[link + 1];
+            size_t linkEnd = match[close + 1];
+            edits[link] = switchOpen;
+            edits[link + 1] = "((";
+            edits[close] = caseThen;
+            if (linkEnd != last) {
+                edits[linkEnd] = caseElse;
+                edits[linkEnd + 1] = "";  // else
+            }
+            link = linkEnd + 2;
+        }
+        edits[last] = switchClose;
+        closers[last] = links;
+    }
+    
+    // Splice the edits into the output
+    int ok = 1;
+    size_t copied = 0;
+    for (size_t i = 0; ok && i < count; i++) {
+        if (!edits[i]) {
+            continue;
+        }
+        ok = bufferAppend(out, code + copied, tokens[i].start - copied) && bufferAppend(out, edits[i], strlen(edits[i]));
+        for (size_t n = 0; ok && n < closers[i]; n++) {
+            ok = bufferAppend(out, n + 1 < closers[i] ? "}\n" : "}", n + 1 < closers[i] ? 2 : 1);
+        }
+        copied = tokens[i].start + tokens[i].length;
+    }
+    ok = ok && bufferAppend(out, code + copied, length - copied);
+    
+    free(tokens);
+    free(match);
+    free(jumps);
+    free(edits);
+    free(closers);
+    free(spans);
+    return ok;
+}
+
+// First '{' at or after `from` that opens a block of statements: one that
+// follows the ')' of a parameter list or condition, not an initializer or a
+// struct body
+static const char* nextBlockOpening(const char* code, size_t length, const char* from) {
+    const char* end = code + length;
+    for (const char* opening = memchr(from, '{', end - from); opening; opening = memchr(opening + 1, '{', end - opening - 1)) {
+        const char* before = opening;
+        while (before > code && isspace((unsigned char)before[-1])) {
+            before--;
+        }
+        if (before > code && before[-1] == ')') {
+            return opening;
+        }
+    }
+    return NULL;
+}
+
+int addDeadCode(const char* code, size_t length, const HotProfile* profile, Buffer* out) {
+    const char* deadCodeSnippets[] = {
+        "int _dummy1 = rand() % 100;\n",
+        "volatile int _dummy2 = time(NULL) & 0xFF;\n",
+        "if (_dummy1 > 200) { printf(\"Never executed\"); }\n",
+        "for (int _i = 0; _i < 0; _i++) { _dummy2++; }\n"
+    };
+    
+    size_t snippetsLength = 0;
+    for (int i = 0; i < 4; i++) {
+        snippetsLength += strlen(deadCodeSnippets[i]);
+    }
+    size_t base = out->length;
+    if (!bufferReserve(out, length + snippetsLength) || !bufferAppend(out, code, length)) {
+        return 0;
+    }
+    char* result = out->data;
+    
+    // Only fully protected code gets dead code
+    FunctionSpan* spans;
+    size_t spanCount = findFunctionSpans(code, length, profile, &spans);
+    const char* opening = nextBlockOpening(code, length, code);
+    while (opening && protectionAt(spans, spanCount, opening - code) != PROTECTION_FULL) {
+        opening = nextBlockOpening(code, length, opening + 1);
+    }
+    free(spans);
+    
+    // Insert dead code after the first block opening. Snippets go in last
+    // first so they read in order and _dummy1/_dummy2 are declared before
+    // they are used.
+    for (int i = 3; i >= 0; i--) {
+        char* insertion_point = opening ? result + base + (opening - code) : NULL;
+        if (insertion_point) {
+            insertion_point++; // Move past the '{'
+            
+            // Insert dead code
+            size_t snippet_len = strlen(deadCodeSnippets[i]);
+            memmove(insertion_point + snippet_len, 
+                   insertion_point, 
+                   out->length - (insertion_point - result) + 1);
+            memcpy(insertion_point, deadCodeSnippets[i], snippet_len);
+            out->length += snippet_len;
+        }
+    }
+    
+    return 1;
+}
+
+// With an interval, a detached thread checks TracerPid in /proc/self/status
+// every `interval` milliseconds instead. The file is opened once and reread
+// with pread, so a check is one system call plus a short scan, and main only
+// pays for starting the thread. The monitor goes first in the file, so it
+// requests POSIX.1-2008 for O_CLOEXEC and pread under -std=c11.
+static const char* antiDebugMonitorCode =
+    "#ifndef _POSIX_C_SOURCE\n"
+    "#define _POSIX_C_SOURCE 200809L\n"
+    "#endif\n"
+    "\n// Anti-debugging monitor\n"
+    "#include <fcntl.h>\n"
+    "#include <pthread.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "#include <time.h>\n"
+    "#include <unistd.h>\n"
+    "\nstatic void* anti_debug_monitor(void* unused) {\n"
+    "    (void)unused;\n"
+    "    struct timespec interval = { %d / 1000, %d %% 1000 * 1000000L };\n"
+    "    int status = open(\"/proc/self/status\", O_RDONLY | O_CLOEXEC);\n"
+    "    if (status < 0) {\n"
+    "        return NULL;\n"
+    "    }\n"
+    "    for (;;) {\n"
+    "        char buffer[4096];\n"
+    "        ssize_t length = pread(status, buffer, sizeof(buffer) - 1, 0);\n"
+    "        if (length > 0) {\n"
+    "            buffer[length] = '\\0';\n"
+    "            const char* field = strstr(buffer, \"TracerPid:\");\n"
+    "            if (field && strtol(field + 10, NULL, 10) != 0) {\n"
+    "                _exit(1);\n"
+    "            }\n"
+    "        }\n"
+    "        nanosleep(&interval, NULL);\n"
+    "    }\n"
+    "}\n"
+    "\nvoid anti_debug_start() {\n"
+    "    pthread_t thread;\n"
+    "    if (pthread_create(&thread, NULL, anti_debug_monitor, NULL) == 0) {\n"
+    "        pthread_detach(thread);\n"
+    "    }\n"
+    "}\n\n";
+
+int addAntiDebugging(const char* code, size_t length, int interval, Buffer* out) {
+    char monitorCode[2048];
+    if (interval > 0) {
+        snprintf(monitorCode, sizeof(monitorCode), antiDebugMonitorCode, interval, interval);
+    }
+    const char* antiDebugCode = interval > 0 ? monitorCode :
+        "\n// Anti-debugging measures\n"
+        "#include <sys/ptrace.h>\n"
+        "#include <signal.h>\n"
+        "#include <stdlib.h>\n"
+        "#include <time.h>\n"
+        "\nvoid anti_debug_check() {\n"
+        "    if (ptrace(PTRACE_TRACEME, 0, 1, 0) == -1) {\n"
+        "        exit(1);\n"
+        "    }\n"
+        "    \n"
+        "    // Timing check\n"
+        "    clock_t start = clock();\n"
+        "    volatile int dummy = 0;\n"
+        "    for (int i = 0; i < 1000; i++) dummy++;\n"
+        "    clock_t end = clock();\n"
+        "    \n"
+        "    if ((end - start) > 10000) {\n"
+        "        exit(1);\n"
+        "    }\n"
+        "}\n\n";
+    
+    const char* call = interval > 0 ? "\n    anti_debug_start();\n" : "\n    anti_debug_check();\n";
+    size_t call_len = strlen(call);
+    if (!bufferReserve(out, strlen(antiDebugCode) + length + call_len) ||
+        !bufferAppend(out, antiDebugCode, strlen(antiDebugCode)) ||
+        !bufferAppend(out, code, length)) {
+        return 0;
+    }
+    char* result = out->data;
+    
+    // Insert anti-debug call at the beginning of main
+    char* main_pos = strstr(result, "int main(");
+    if (main_pos) {
+        char* brace_pos = strchr(main_pos, '{');
+        if (brace_pos) {
+            brace_pos++; // Move past the '{'
+            
+            memmove(brace_pos + call_len, brace_pos, out->length - (brace_pos - result) + 1);
+            memcpy(brace_pos, call, call_len);
+            out->length += call_len;
+        }
+    }
+    
+    return 1;
+}
+
+static const char* statsPassNames[STATS_PASS_COUNT] = {
+    "encryptStrings", "controlFlow", "deadCode", "antiDebugging", "obfuscateIdentifiers"
+};
+
+static double secondsBetween(const struct timespec* start, const struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void passProbeStart(PassProbe* probe) {
+    probe->allocations = allocationCount;
+    probe->allocatedBytes = allocationBytes;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &probe->cpu);
+    clock_gettime(CLOCK_MONOTONIC, &probe->wall);
+}
+
+static void passProbeFinish(const PassProbe* probe, PassStats* pass, size_t bytesIn, size_t bytesOut) {
+    struct timespec wall, cpu;
+    clock_gettime(CLOCK_MONOTONIC, &wall);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    pass->wallSeconds += secondsBetween(&probe->wall, &wall);
+    pass->cpuSeconds += secondsBetween(&probe->cpu, &cpu);
+    pass->allocations += allocationCount - probe->allocations;
+    pass->allocatedBytes += allocationBytes - probe->allocatedBytes;
+    pass->bytesIn += bytesIn;
+    pass->bytesOut += bytesOut;
+    pass->runs++;
+    
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    if (usage.ru_maxrss > pass->peakRssKb) {
+        pass->peakRssKb = usage.ru_maxrss;
+    }
+}
+
+static void processStatsMerge(ProcessStats* into, const ProcessStats* from) {
+    for (int i = 0; i < STATS_PASS_COUNT; i++) {
+        PassStats* to = &into->passes[i];
+        const PassStats* pass = &from->passes[i];
+        to->runs += pass->runs;
+        to->wallSeconds += pass->wallSeconds;
+        to->cpuSeconds += pass->cpuSeconds;
+        to->bytesIn += pass->bytesIn;
+        to->bytesOut += pass->bytesOut;
+        to->allocations += pass->allocations;
+        to->allocatedBytes += pass->allocatedBytes;
+        if (pass->peakRssKb > to->peakRssKb) {
+            to->peakRssKb = pass->peakRssKb;
+        }
+    }
+    into->files += from->files;
+    into->literals += from->literals;
+    into->literalBytes += from->literalBytes;
+    into->identifiers += from->identifiers;
+}
+
+// Write a --stats report to `path`, or to stderr when the path is "-"
+int processStatsWrite(const ProcessStats* stats, double wallSeconds, const char* path) {
+    FILE* file = strcmp(path, "-") == 0 ? stderr : fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot write stats to %s\n", path);
+        return 0;
+    }
+    
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(file,
+            "{\n  \"processor\": \"c\",\n  \"files\": %zu,\n  \"wallSeconds\": %.6f,\n  \"peakRssKb\": %ld,\n"
+            "  \"literals\": %zu,\n  \"literalBytes\": %zu,\n  \"identifiers\": %zu,\n  \"passes\": [",
+            stats->files, wallSeconds, usage.ru_maxrss, stats->literals, stats->literalBytes, stats->identifiers);
+    int first = 1;
+    for (int i = 0; i < STATS_PASS_COUNT; i++) {
+        const PassStats* pass = &stats->passes[i];
+        if (pass->runs == 0) {
+            continue;  // disabled pass
+        }
+        fprintf(file,
+                "%s\n    {\"name\": \"%s\", \"runs\": %zu, \"wallSeconds\": %.6f, \"cpuSeconds\": %.6f, "
+                "\"bytesIn\": %zu, \"bytesOut\": %zu, \"allocations\": %zu, \"allocatedBytes\": %zu, \"peakRssKb\": %ld}",
+                first ? "" : ",", statsPassNames[i], pass->runs, pass->wallSeconds, pass->cpuSeconds,
+                pass->bytesIn, pass->bytesOut, pass->allocations, pass->allocatedBytes, pass->peakRssKb);
+        first = 0;
+    }
+    fprintf(file, "\n  ]\n}\n");
+    
+    return file == stderr ? !ferror(file) : fclose(file) == 0;
+}
+
+// Run the enabled passes. Each intermediate text lives in one buffer that is
+// released as soon as the next pass has consumed it, and the final pass
+// streams straight into the writer.
+int processCodeStream(const char* code, size_t length, CProcessorOptions* options, OutputWriter* out) {
+    Buffer current = {0};
+    const char* text = code;
+    size_t text_len = length;
+    int ok = 1;
+    ProcessStats* stats = options->stats;
+    PassProbe probe = {0};
+    size_t runtime = 0;  // the string runtime is not user code
+
+    allocationCounting = stats != NULL;
+    
+    // Deterministic IVs are labelled with the file's content hash
+    unsigned int labelLength = 0;
+    if (options->deterministic && EVP_Digest(code, length, options->fileLabel, &labelLength, EVP_sha256(), NULL) != 1) {
+        return 0;
+    }
+    
+    for (int pass = 0; pass < 4 && ok; pass++) {
+        Buffer next = {0};
+        if (stats) {
+            passProbeStart(&probe);
+        }
+        
+        // Apply obfuscations based on options
+        if (pass == 0 && options->stringEncrypt) {
+            ok = encryptStrings(text, text_len, options->encryptionKey, options, &next);
+            runtime = options->runtimeLength;
+        } else if (pass == 1 && options->controlFlow) {
+            ok = bufferAppend(&next, text, runtime) &&
+                 addControlFlowObfuscation(text + runtime, text_len - runtime, options->profile, &next);
+        } else if (pass == 2 && options->deadCode) {
+            ok = bufferAppend(&next, text, runtime) &&
+                 addDeadCode(text + runtime, text_len - runtime, options->profile, &next);
+        } else if (pass == 3 && options->antiDebug) {
+            ok = addAntiDebugging(text, text_len, options->antiDebugInterval, &next);
+        } else {
+            continue;
+        }
+        if (stats) {
+            passProbeFinish(&probe, &stats->passes[pass], text_len, next.length);
+        }
+        
+        free(current.data);
+        current = next;
+        text = current.data;
+        text_len = current.length;
+    }
+    
+    // Identifiers are always renamed last
+    size_t written = out->flushed + out->buffer.length;
+    if (stats) {
+        passProbeStart(&probe);
+    }
+    if (options->renameIdentifiers) {
+        ok = ok && obfuscateIdentifiers(text, text_len, options, out);
+    } else if (ok) {
+        writerWrite(out, text, text_len);
+    }
+    free(current.data);
+    
+    if (stats) {
+        if (options->renameIdentifiers) {
+            passProbeFinish(&probe, &stats->passes[4], text_len, out->flushed + out->buffer.length - written);
+        }
+        stats->files++;
+        stats->identifiers += options->identifiers.count;
+        stats->literals += options->strings.count;
+        for (size_t i = 0; i < options->strings.count; i++) {
+            stats->literalBytes += strlen(options->strings.entries[i].original);
+        }
+        allocationCounting = 0;
+    }
+    return ok && writerFlush(out);
+}
+
+char* processCode(const char* code, CProcessorOptions* options) {
+    OutputWriter out = {0};
+    if (!processCodeStream(code, strlen(code), options, &out)) {
+        free(out.buffer.data);
+        return NULL;
+    }
+    if (!out.buffer.data) {
+        return strdup("");
+    }
+    return out.buffer.data;
+}
+
+// Map a file read-only. Empty files map to an empty string.
+const char* mapFile(const char* path, size_t* length) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return NULL;
+    }
+    
+    *length = (size_t)info.st_size;
+    if (*length == 0) {
+        close(fd);
+        return "";
+    }
+    
+    void* data = mmap(NULL, *length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+    posix_madvise(data, *length, POSIX_MADV_SEQUENTIAL);
+    return data;
+}
+
+void unmapFile(const char* data, size_t length) {
+    if (data && length > 0) {
+        munmap((void*)data, length);
+    }
+}
+
+// List of file paths collected for project mode
+typedef struct {
+    char** paths;
+    size_t count;
+    size_t capacity;
+} FileList;
+
+static int fileListAdd(FileList* list, const char* path) {
+    for (size_t i = 0; i < list->count; i++) {
+        if (strcmp(list->paths[i], path) == 0) {
+            return 1;
+        }
+    }
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 64;
+        char** paths = realloc(list->paths, capacity * sizeof(char*));
+        if (!paths) {
+            return 0;
+        }
+        list->paths = paths;
+        list->capacity = capacity;
+    }
+    list->paths[list->count] = strdup(path);
+    return list->paths[list->count++] != NULL;
+}
+
+static void fileListFree(FileList* list) {
+    for (size_t i = 0; i < list->count; i++) {
+        free(list->paths[i]);
+    }
+    free(list->paths);
+}
+
+static int isCSource(const char* path) {
+    const char* ext = strrchr(path, '.');
+    return ext && (strcmp(ext, ".c") == 0 || strcmp(ext, ".h") == 0);
+}
+
+static void collectSources(const char* dir, FileList* list) {
+    DIR* handle = opendir(dir);
+    if (!handle) {
+        return;
+    }
+    
+    struct dirent* entry;
+    while ((entry = readdir(handle)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        struct stat info;
+        if (stat(path, &info) != 0) {
+            continue;
+        }
+        if (S_ISDIR(info.st_mode)) {
+            collectSources(path, list);
+        } else if (S_ISREG(info.st_mode) && isCSource(path)) {
+            fileListAdd(list, path);
+        }
+    }
+    closedir(handle);
+}
+
+static char* readFile(const char* path, size_t* length) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    
+    Buffer content = {0};
+    char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        if (!bufferAppend(&content, chunk, n)) {
+            free(content.data);
+            fclose(file);
+            return NULL;
+        }
+    }
+    fclose(file);
+    
+    if (!content.data && !bufferAppend(&content, "", 0)) {
+        return NULL;
+    }
+    if (length) {
+        *length = content.length;
+    }
+    return content.data;
+}
+
+// Copy the JSON string value of `field` within [object, end) into value
+static int jsonStringField(const char* object, const char* end, const char* field, char* value, size_t size) {
+    char key[64];
+    snprintf(key, sizeof(key), "\"%s\"", field);
+    
+    const char* pos = object;
+    size_t keyLen = strlen(key);
+    while (pos + keyLen <= end && strncmp(pos, key, keyLen) != 0) {
+        pos++;
+    }
+    if (pos + keyLen > end) {
+        return 0;
+    }
+    
+    pos = memchr(pos + keyLen, ':', end - pos - keyLen);
+    pos = pos ? memchr(pos, '"', end - pos) : NULL;
+    if (!pos) {
+        return 0;
+    }
+    
+    size_t len = 0;
+    for (pos++; pos < end && *pos != '"' && len + 1 < size; pos++) {
+        if (*pos == '\\' && pos + 1 < end) {
+            pos++;
+        }
+        value[len++] = *pos;
+    }
+    value[len] = '\0';
+    return 1;
+}
+
+// The '}' closing the JSON object that opens at `pos`, skipping nested
+// objects and quoted strings (commands may hold braces like -DX={1})
+static const char* jsonObjectEnd(const char* pos) {
+    int depth = 0;
+    for (; *pos; pos++) {
+        if (*pos == '"') {
+            for (pos++; *pos && *pos != '"'; pos++) {
+                if (*pos == '\\' && pos[1]) {
+                    pos++;
+                }
+            }
+            if (!*pos) {
+                return NULL;
+            }
+        } else if (*pos == '{') {
+            depth++;
+        } else if (*pos == '}' && --depth == 0) {
+            return pos;
+        }
+    }
+    return NULL;
+}
+
+// Translation units listed in a compile_commands.json database
+static void readCompileCommands(const char* database, FileList* list) {
+    char* json = readFile(database, NULL);
+    if (!json) {
+        return;
+    }
+    
+    const char* pos = json;
+    while ((pos = strchr(pos, '{')) != NULL) {
+        const char* end = jsonObjectEnd(pos);
+        if (!end) {
+            break;
+        }
+        
+        char file[4096];
+        char directory[4096];
+        if (jsonStringField(pos, end, "file", file, sizeof(file))) {
+            if (file[0] != '/' && jsonStringField(pos, end, "directory", directory, sizeof(directory))) {
+                char path[8192];
+                snprintf(path, sizeof(path), "%s/%s", directory, file);
+                fileListAdd(list, path);
+            } else {
+                fileListAdd(list, file);
+            }
+        }
+        pos = end + 1;
+    }
+    free(json);
+}
+
+static void makeParentDirectories(const char* path) {
+    char buffer[8192];
+    snprintf(buffer, sizeof(buffer), "%s", path);
+    for (char* p = buffer + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            mkdir(buffer, 0755);
+            *p = '/';
+        }
+    }
+}
+
+static int compareFileSize(const void* a, const void* b) {
+    struct stat infoA, infoB;
+    off_t sizeA = stat(*(char* const*)a, &infoA) == 0 ? infoA.st_size : 0;
+    off_t sizeB = stat(*(char* const*)b, &infoB) == 0 ? infoB.st_size : 0;
+    return (sizeA < sizeB) - (sizeA > sizeB);
+}
+
+// On-disk cache of processed files keyed by a SHA-256 of the input, the
+// options and the key. DIR/<key>.out holds the output and DIR/<key>.map the
+// file's identifier renames, one "original obfuscated" pair per line.
+int cacheKey(const char* code, size_t length, const CProcessorOptions* options, char key[65]) {
+    char settings[176];
+    int settingsLength = snprintf(settings, sizeof(settings), "c-cache-1\n%s\n%d%d%d%d%d%d\n%d\n",
+                                  options->encryptionKey, options->antiDebug, options->controlFlow,
+                                  options->deadCode, options->stringEncrypt, options->renameIdentifiers,
+                                  options->deterministic, options->antiDebugInterval);
+    
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digestLength = 0;
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    int ok = ctx && EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) == 1 &&
+             EVP_DigestUpdate(ctx, settings, settingsLength + 1) == 1;
+    
+    // Functions whose protection --profile lowered
+    const HotProfile* profile = options->profile;
+    for (size_t i = 0; ok && profile && i < profile->count; i++) {
+        unsigned char level = (unsigned char)profile->functions[i].level;
+        ok = level == PROTECTION_FULL ||
+             (EVP_DigestUpdate(ctx, profile->functions[i].name, strlen(profile->functions[i].name) + 1) == 1 &&
+              EVP_DigestUpdate(ctx, &level, 1) == 1);
+    }
+    
+    // Names --preserve keeps
+    const IdentifierTable* preserved = options->preserved;
+    for (size_t i = 0; ok && preserved && i < preserved->capacity; i++) {
+        const IdentifierMap* entry = &preserved->entries[i];
+        ok = !entry->original || EVP_DigestUpdate(ctx, entry->original, entry->length + 1) == 1;
+    }
+    ok = ok && EVP_DigestUpdate(ctx, code, length) == 1 &&
+             EVP_DigestFinal_ex(ctx, digest, &digestLength) == 1;
+    EVP_MD_CTX_free(ctx);
+    if (!ok) {
+        return 0;
+    }
+    
+    static const char hex[] = "0123456789abcdef";
+    for (unsigned int i = 0; i < digestLength && i < 32; i++) {
+        key[2 * i] = hex[digest[i] >> 4];
+        key[2 * i + 1] = hex[digest[i] & 15];
+    }
+    key[64] = '\0';
+    return 1;
+}
+
+int cacheLoad(const char* dir, const char* key, Buffer* output, IdentifierTable* renames) {
+    char path[8192];
+    snprintf(path, sizeof(path), "%s/%s.map", dir, key);
+    size_t mapLength = 0;
+    char* map = readFile(path, &mapLength);
+    if (!map) {
+        return 0;
+    }
+    
+    snprintf(path, sizeof(path), "%s/%s.out", dir, key);
+    size_t length = 0;
+    char* data = readFile(path, &length);
+    int ok = data != NULL;
+    
+    char* line = map;
+    char* end = map + mapLength;
+    while (ok && line < end) {
+        char* newline = memchr(line, '\n', end - line);
+        char* space = memchr(line, ' ', (newline ? newline : end) - line);
+        if (!newline || !space) {
+            ok = 0;
+            break;
+        }
+        *newline = '\0';
+        
+        size_t len = space - line;
+        unsigned int hash = hashIdentifier(line, len);
+        ok = identifierTableFind(renames, line, len, hash) ||
+             identifierTableInsert(renames, line, len, hash, space + 1);
+        line = newline + 1;
+    }
+    free(map);
+    
+    if (ok) {
+        free(output->data);
+        output->data = data;
+        output->length = length;
+        output->capacity = length + 1;
+    } else {
+        free(data);
+        identifierTableFree(renames);
+    }
+    return ok;
+}
+
+static int cacheWrite(const char* dir, const char* name, const char* data, size_t length) {
+    // Write under a temporary name and rename into place so concurrent runs
+    // never see a partial file
+    char target[8192], temporary[8300];
+    snprintf(target, sizeof(target), "%s/%s", dir, name);
+    snprintf(temporary, sizeof(temporary), "%s.tmp%ld.%lu", target, (long)getpid(), (unsigned long)pthread_self());
+    
+    FILE* file = fopen(temporary, "wb");
+    if (!file) {
+        return 0;
+    }
+    int ok = fwrite(data, 1, length, file) == length;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(temporary, target) != 0) {
+        unlink(temporary);
+        return 0;
+    }
+    return 1;
+}
+
+int cacheStore(const char* dir, const char* key, const char* output, size_t length, const IdentifierTable* renames) {
+    Buffer map = {0};
+    int ok = 1;
+    for (size_t i = 0; i < renames->capacity && ok; i++) {
+        const IdentifierMap* entry = &renames->entries[i];
+        if (entry->original && entry->obfuscated) {
+            ok = bufferAppend(&map, entry->original, entry->length) && bufferAppend(&map, " ", 1) &&
+                 bufferAppend(&map, entry->obfuscated, strlen(entry->obfuscated)) && bufferAppend(&map, "\n", 1);
+        }
     }
     
-    char* code = malloc(MAX_CODE_SIZE);
-    size_t bytes_read = fread(code, 1, MAX_CODE_SIZE - 1, file);
-    code[bytes_read] = '\0';
-    fclose(file);
-    
-    // Process the code
-    char* obfuscated = processCode(code, &options);
+    char name[80];
+    snprintf(name, sizeof(name), "%s.out", key);
+    ok = ok && cacheWrite(dir, name, output, length);
+    snprintf(name, sizeof(name), "%s.map", key);
+    ok = ok && cacheWrite(dir, name, map.data ? map.data : "", map.length);
+    free(map.data);
+    return ok;
+}
+
+// Add a cached file's renames to the shared table unless one of them
+// contradicts a rename that is already there
+static int mergeCachedIdentifiers(SharedIdentifiers* shared, const IdentifierTable* renames) {
+    for (size_t i = 0; i < renames->capacity; i++) {
+        const IdentifierMap* entry = &renames->entries[i];
+        IdentifierMap* global = entry->original ? identifierTableFind(&shared->table, entry->original, entry->length, entry->hash) : NULL;
+        if (global && strcmp(global->obfuscated, entry->obfuscated) != 0) {
+            return 0;
+        }
+    }
+    for (size_t i = 0; i < renames->capacity; i++) {
+        const IdentifierMap* entry = &renames->entries[i];
+        if (entry->original && !identifierTableFind(&shared->table, entry->original, entry->length, entry->hash) &&
+            !identifierTableInsert(&shared->table, entry->original, entry->length, entry->hash, entry->obfuscated)) {
+            return 0;
+        }
+        // Cached names came from the same key; keep the generator past them
+        if (entry->original) {
+            nameGeneratorReserve(&shared->table.generator, entry->obfuscated, strlen(entry->obfuscated));
+        }
+    }
+    return 1;
+}
+
+static int comparePaths(const void* a, const void* b) {
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+// Per-worker deque of task indices. The owner pops from the bottom, idle
+// workers steal from the top.
+typedef struct {
+    size_t* tasks;
+    size_t top;
+    size_t bottom;
+    pthread_mutex_t lock;
+} WorkQueue;
+
+typedef struct {
+    WorkQueue* queues;
+    int workerCount;
+    int self;
+    const FileList* files;
+    const char* root;
+    const char* outDir;
+    const CProcessorOptions* config;
+    SharedIdentifiers* shared;
+    const char* cacheDir;
+    char (*keys)[65];  // cache key per file, empty when not cached
+    size_t* turns;     // position of each file among those processed
+    int failures;
+    int collectStats;
+    ProcessStats stats;  // this worker's share of the --stats report
+} ProjectWorker;
+
+// In ordered mode every task sits in the first deque and is taken from the
+// top, so files start in order
+static int takeTask(ProjectWorker* worker, size_t* task) {
+    int ordered = worker->shared->ordered;
+    WorkQueue* own = &worker->queues[ordered ? 0 : worker->self];
+    pthread_mutex_lock(&own->lock);
+    int found = own->bottom > own->top;
+    if (found) {
+        *task = ordered ? own->tasks[own->top++] : own->tasks[--own->bottom];
+    }
+    pthread_mutex_unlock(&own->lock);
     
-    // Output result
-    printf("%s\n", obfuscated);
+    for (int k = 1; !found && k < worker->workerCount; k++) {
+        WorkQueue* victim = &worker->queues[(worker->self + k) % worker->workerCount];
+        pthread_mutex_lock(&victim->lock);
+        found = victim->bottom > victim->top;
+        if (found) {
+            *task = victim->tasks[victim->top++];
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    return found;
+}
+
+// Path of a project file mirrored under the output directory
+static void projectTarget(const char* path, const char* root, const char* outDir, char* target, size_t size) {
+    size_t rootLen = strlen(root);
+    const char* relative = path;
+    if (strncmp(path, root, rootLen) == 0 && path[rootLen] == '/') {
+        relative = path + rootLen + 1;
+    }
+    while (*relative == '/') {
+        relative++;
+    }
     
-    // Cleanup
-    free(code);
-    free(obfuscated);
+    snprintf(target, size, "%s/%s", outDir, relative);
+    makeParentDirectories(target);
+}
+
+static int writeWholeFile(const char* path, const char* data, size_t length) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        return 0;
+    }
+    int ok = fwrite(data, 1, length, file) == length;
+    return fclose(file) == 0 && ok;
+}
+
+static void* projectWorkerMain(void* arg) {
+    ProjectWorker* worker = arg;
+    
+    size_t task;
+    while (takeTask(worker, &task)) {
+        const char* path = worker->files->paths[task];
+        
+        CProcessorOptions options = {0};
+        strcpy(options.encryptionKey, worker->config->encryptionKey);
+        options.antiDebug = worker->config->antiDebug;
+        options.antiDebugInterval = worker->config->antiDebugInterval;
+        options.controlFlow = worker->config->controlFlow;
+        options.deadCode = worker->config->deadCode;
+        options.stringEncrypt = worker->config->stringEncrypt;
+        options.renameIdentifiers = worker->config->renameIdentifiers;
+        options.deterministic = worker->config->deterministic;
+        options.shared = worker->shared;
+        options.turn = worker->turns[task];
+        options.stats = worker->collectStats ? &worker->stats : NULL;
+        options.profile = worker->config->profile;
+        options.preserved = worker->config->preserved;
+        
+        size_t length = 0;
+        const char* code = mapFile(path, &length);
+        
+        char target[8192];
+        projectTarget(path, worker->root, worker->outDir, target, sizeof(target));
+        
+        // Output that goes into the cache is collected in memory first
+        const char* key = worker->keys[task];
+        OutputWriter out = {0};
+        int ok;
+        if (*key) {
+            ok = code && processCodeStream(code, length, &options, &out) &&
+                 writeWholeFile(target, out.buffer.data ? out.buffer.data : "", out.buffer.length);
+            if (ok) {
+                cacheStore(worker->cacheDir, key, out.buffer.data ? out.buffer.data : "", out.buffer.length, &options.identifiers);
+            }
+        } else {
+            out.file = code ? fopen(target, "w") : NULL;
+            ok = out.file && processCodeStream(code, length, &options, &out);
+            if (out.file && fclose(out.file) != 0) {
+                ok = 0;
+            }
+        }
+        if (!ok) {
+            fprintf(stderr, "Error: Cannot process file %s\n", path);
+            worker->failures++;
+        }
+        sharedIdentifiersSkipTurn(worker->shared, worker->turns[task]);
+        
+        unmapFile(code, length);
+        free(out.buffer.data);
+        stringTableFree(&options.strings);
+        identifierTableFree(&options.identifiers);
+    }
+    
+    return NULL;
+}
+
+// Obfuscate every C file of a project (a directory tree or a
+// compile_commands.json) on a work-stealing thread pool. All workers share
+// one identifier table so renames stay consistent across files. With a
+// cache, unchanged files are copied from it and their renames are merged
+// into the table before any other file is processed. A statsPath sums
+// every worker's pass statistics into one report.
+int processProject(const char* input, const char* outDir, int jobs, const CProcessorOptions* config, const char* cacheDir,
+                   const char* statsPath) {
+    FileList files = {0};
+    char root[4096];
+    struct stat info;
+    if (stat(input, &info) != 0) {
+        fprintf(stderr, "Error: Cannot open project %s\n", input);
+        return 1;
+    }
+    
+    snprintf(root, sizeof(root), "%s", input);
+    if (S_ISDIR(info.st_mode)) {
+        size_t len = strlen(root);
+        while (len > 1 && root[len - 1] == '/') {
+            root[--len] = '\0';
+        }
+        collectSources(root, &files);
+    } else {
+        readCompileCommands(input, &files);
+        char* slash = strrchr(root, '/');
+        if (slash) {
+            *slash = '\0';
+        } else {
+            strcpy(root, ".");
+        }
+    }
+    
+    if (jobs < 1) {
+        jobs = 1;
+    }
+    if ((size_t)jobs > files.count && files.count > 0) {
+        jobs = (int)files.count;
+    }
+    
+    SharedIdentifiers shared = {0};
+    pthread_mutex_init(&shared.lock, NULL);
+    pthread_cond_init(&shared.turnChanged, NULL);
+    shared.ordered = config->deterministic;
+    nameGeneratorInit(&shared.table.generator, config->encryptionKey, strlen(config->encryptionKey));
+    
+    WorkQueue* queues = calloc(jobs, sizeof(WorkQueue));
+    ProjectWorker* workers = calloc(jobs, sizeof(ProjectWorker));
+    pthread_t* threads = calloc(jobs, sizeof(pthread_t));
+    char (*keys)[65] = calloc(files.count + 1, sizeof(*keys));
+    char* cached = calloc(files.count + 1, 1);
+    size_t* turns = calloc(files.count + 1, sizeof(size_t));
+    if (!queues || !workers || !threads || !keys || !cached || !turns) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return 1;
+    }
+    
+    // Largest files first keeps the tail of the schedule short; deterministic
+    // runs go in path order
+    qsort(files.paths, files.count, sizeof(char*), config->deterministic ? comparePaths : compareFileSize);
+    
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    // Take unchanged files from the cache. Their renames are merged in file
+    // order; a file whose renames disagree with an earlier one is processed
+    // again.
+    size_t hits = 0;
+    if (cacheDir) {
+        char marker[8192];
+        snprintf(marker, sizeof(marker), "%s/.", cacheDir);
+        makeParentDirectories(marker);
+    }
+    for (size_t i = 0; cacheDir && i < files.count; i++) {
+        size_t length = 0;
+        const char* code = mapFile(files.paths[i], &length);
+        int ok = code && cacheKey(code, length, config, keys[i]);
+        unmapFile(code, length);
+        
+        Buffer output = {0};
+        IdentifierTable renames = {0};
+        if (ok && cacheLoad(cacheDir, keys[i], &output, &renames) && mergeCachedIdentifiers(&shared, &renames)) {
+            char target[8192];
+            projectTarget(files.paths[i], root, outDir, target, sizeof(target));
+            cached[i] = writeWholeFile(target, output.data, output.length);
+            hits += cached[i];
+        }
+        free(output.data);
+        identifierTableFree(&renames);
+    }
+    
+    // Seed the deques round-robin with the files left to process
+    for (int w = 0; w < jobs; w++) {
+        queues[w].tasks = malloc((shared.ordered ? files.count + 1 : files.count / jobs + 1) * sizeof(size_t));
+        pthread_mutex_init(&queues[w].lock, NULL);
+    }
+    size_t pending = 0;
+    for (size_t i = 0; i < files.count; i++) {
+        if (!cached[i]) {
+            WorkQueue* queue = &queues[shared.ordered ? 0 : pending % jobs];
+            queue->tasks[queue->bottom++] = i;
+            turns[i] = pending++;
+        }
+    }
+    
+    ProcessStats noStats = {0};
+    for (int w = 0; w < jobs; w++) {
+        ProjectWorker worker = { queues, jobs, w, &files, root, outDir, config, &shared, cacheDir, keys, turns, 0, statsPath != NULL, noStats };
+        workers[w] = worker;
+        if (w > 0) {
+            pthread_create(&threads[w], NULL, projectWorkerMain, &workers[w]);
+        }
+    }
+    projectWorkerMain(&workers[0]);
+    
+    int failures = workers[0].failures;
+    for (int w = 1; w < jobs; w++) {
+        pthread_join(threads[w], NULL);
+        failures += workers[w].failures;
+    }
+    ProcessStats stats = {0};
+    for (int w = 0; statsPath && w < jobs; w++) {
+        processStatsMerge(&stats, &workers[w].stats);
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    fprintf(stderr, "Processed %zu of %zu files with %d workers in %.2f ms (%zu identifiers, %zu from cache)\n",
+            files.count - failures, files.count, jobs, elapsed, shared.table.count, hits);
+    if (statsPath && !processStatsWrite(&stats, elapsed / 1000, statsPath)) {
+        failures++;
+    }
+    
+    for (int w = 0; w < jobs; w++) {
+        free(queues[w].tasks);
+        pthread_mutex_destroy(&queues[w].lock);
+    }
+    free(queues);
+    free(workers);
+    free(threads);
+    free(keys);
+    free(cached);
+    free(turns);
+    identifierTableFree(&shared.table);
+    pthread_mutex_destroy(&shared.lock);
+    pthread_cond_destroy(&shared.turnChanged);
+    fileListFree(&files);
+    
+    return failures ? 1 : 0;
+}
+
+// Server mode (--serve). Requests and responses are frames: a 4-byte
+// big-endian payload length followed by the payload. A request payload is
+// a one-line header holding an opaque request id, then the source:
+//
+//   "<id>\n<source>"
+//
+// and the response payload echoes the id with a status:
+//
+//   "<id> ok\n<output>"  or  "<id> error <message>\n"
+//
+// Requests are processed concurrently, so responses on one stream can come
+// back in any order. All workers share one identifier table for the life of
+// the server: a name is renamed the same way in every file it sees.
+#define SERVE_MAX_FRAME (256u << 20)
+
+// One client stream
+typedef struct {
+    int out;
+    pthread_mutex_t writeLock;
+    size_t pending;          // requests not yet answered; guarded by the server lock
+    pthread_cond_t drained;
+} ServeConnection;
+
+typedef struct ServeRequest {
+    ServeConnection* connection;
+    char* payload;
+    size_t length;
+    struct ServeRequest* next;
+} ServeRequest;
+
+typedef struct {
+    const CProcessorOptions* config;
+    SharedIdentifiers shared;
+    ServeRequest* head;      // FIFO of requests waiting for a worker
+    ServeRequest* tail;
+    pthread_mutex_t lock;
+    pthread_cond_t queueChanged;
+    int stopping;
+} ServeState;
+
+static int readFully(int fd, void* data, size_t length) {
+    char* at = data;
+    while (length > 0) {
+        ssize_t n = read(fd, at, length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 0;
+        }
+        at += n;
+        length -= (size_t)n;
+    }
+    return 1;
+}
+
+static int writeFully(int fd, const void* data, size_t length) {
+    const char* at = data;
+    while (length > 0) {
+        ssize_t n = write(fd, at, length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 0;
+        }
+        at += n;
+        length -= (size_t)n;
+    }
+    return 1;
+}
+
+// The next frame's payload, malloc'd; 0 at end of stream
+static int serveReadFrame(int fd, char** payload, size_t* length) {
+    unsigned char header[4];
+    if (!readFully(fd, header, sizeof(header))) {
+        return 0;
+    }
+    uint32_t size = ((uint32_t)header[0] << 24) | ((uint32_t)header[1] << 16) | ((uint32_t)header[2] << 8) | header[3];
+    if (size > SERVE_MAX_FRAME) {
+        fprintf(stderr, "Error: Request of %u bytes exceeds the frame limit\n", size);
+        return 0;
+    }
+    *payload = malloc(size + 1);
+    if (!*payload || !readFully(fd, *payload, size)) {
+        free(*payload);
+        return 0;
+    }
+    (*payload)[size] = '\0';
+    *length = size;
+    return 1;
+}
+
+static void serveWriteFrame(ServeConnection* connection, const char* id, size_t idLength, const char* status,
+                            const char* body, size_t bodyLength) {
+    size_t statusLength = strlen(status);
+    size_t size = idLength + 1 + statusLength + 1 + bodyLength;
+    unsigned char* frame = malloc(4 + size);
+    if (!frame) {
+        return;
+    }
+    frame[0] = (unsigned char)(size >> 24);
+    frame[1] = (unsigned char)(size >> 16);
+    frame[2] = (unsigned char)(size >> 8);
+    frame[3] = (unsigned char)size;
+    char* at = (char*)frame + 4;
+    memcpy(at, id, idLength);
+    at[idLength] = ' ';
+    memcpy(at + idLength + 1, status, statusLength);
+    at[idLength + 1 + statusLength] = '\n';
+    if (bodyLength > 0) {
+        memcpy(at + idLength + statusLength + 2, body, bodyLength);
+    }
+    
+    pthread_mutex_lock(&connection->writeLock);
+    writeFully(connection->out, frame, 4 + size);
+    pthread_mutex_unlock(&connection->writeLock);
+    free(frame);
+}
+
+static void* serveWorkerMain(void* arg) {
+    ServeState* state = arg;
+    const CProcessorOptions* config = state->config;
+    
+    for (;;) {
+        pthread_mutex_lock(&state->lock);
+        while (!state->stopping && !state->head) {
+            pthread_cond_wait(&state->queueChanged, &state->lock);
+        }
+        ServeRequest* request = state->head;
+        if (request) {
+            state->head = request->next;
+            state->tail = state->head ? state->tail : NULL;
+        }
+        pthread_mutex_unlock(&state->lock);
+        if (!request) {
+            return NULL;
+        }
+        
+        CProcessorOptions options = {0};
+        strcpy(options.encryptionKey, config->encryptionKey);
+        options.antiDebug = config->antiDebug;
+        options.antiDebugInterval = config->antiDebugInterval;
+        options.controlFlow = config->controlFlow;
+        options.deadCode = config->deadCode;
+        options.stringEncrypt = config->stringEncrypt;
+        options.renameIdentifiers = config->renameIdentifiers;
+        options.deterministic = config->deterministic;
+        options.shared = &state->shared;
+        options.profile = config->profile;
+        options.preserved = config->preserved;
+        
+        char* newline = memchr(request->payload, '\n', request->length);
+        size_t idLength = newline ? (size_t)(newline - request->payload) : request->length;
+        const char* code = newline ? newline + 1 : request->payload + request->length;
+        OutputWriter out = {0};
+        if (processCodeStream(code, request->length - (code - request->payload), &options, &out)) {
+            serveWriteFrame(request->connection, request->payload, idLength, "ok", out.buffer.data, out.buffer.length);
+        } else {
+            serveWriteFrame(request->connection, request->payload, idLength, "error processing failed", NULL, 0);
+        }
+        free(out.buffer.data);
+        stringTableFree(&options.strings);
+        identifierTableFree(&options.identifiers);
+        
+        ServeConnection* connection = request->connection;
+        free(request->payload);
+        free(request);
+        pthread_mutex_lock(&state->lock);
+        if (--connection->pending == 0) {
+            pthread_cond_broadcast(&connection->drained);
+        }
+        pthread_mutex_unlock(&state->lock);
+    }
+}
+
+// Queue every request on one stream until the client closes it, then wait
+// for the outstanding responses
+static void serveStream(ServeState* state, int in, int out) {
+    ServeConnection connection = {0};
+    connection.out = out;
+    pthread_mutex_init(&connection.writeLock, NULL);
+    pthread_cond_init(&connection.drained, NULL);
+    
+    char* payload;
+    size_t length;
+    while (serveReadFrame(in, &payload, &length)) {
+        ServeRequest* request = malloc(sizeof(ServeRequest));
+        if (!request) {
+            free(payload);
+            break;
+        }
+        request->connection = &connection;
+        request->payload = payload;
+        request->length = length;
+        request->next = NULL;
+        
+        pthread_mutex_lock(&state->lock);
+        if (state->tail) {
+            state->tail->next = request;
+        } else {
+            state->head = request;
+        }
+        state->tail = request;
+        connection.pending++;
+        pthread_cond_signal(&state->queueChanged);
+        pthread_mutex_unlock(&state->lock);
+    }
+    
+    pthread_mutex_lock(&state->lock);
+    while (connection.pending > 0) {
+        pthread_cond_wait(&connection.drained, &state->lock);
+    }
+    pthread_mutex_unlock(&state->lock);
+    pthread_mutex_destroy(&connection.writeLock);
+    pthread_cond_destroy(&connection.drained);
+}
+
+typedef struct {
+    ServeState* state;
+    int fd;
+} ServeClient;
+
+static void* serveClientMain(void* arg) {
+    ServeClient client = *(ServeClient*)arg;
+    free(arg);
+    serveStream(client.state, client.fd, client.fd);
+    close(client.fd);
+    return NULL;
+}
+
+// Answer requests on stdin/stdout until it is closed, or on a Unix socket
+// (one reader thread per connection) until the process is stopped
+int processServe(const CProcessorOptions* config, int jobs, const char* socketPath) {
+    if (jobs < 1) {
+        jobs = 1;
+    }
+    ServeState state = {0};
+    state.config = config;
+    pthread_mutex_init(&state.lock, NULL);
+    pthread_cond_init(&state.queueChanged, NULL);
+    pthread_mutex_init(&state.shared.lock, NULL);
+    pthread_cond_init(&state.shared.turnChanged, NULL);
+    nameGeneratorInit(&state.shared.table.generator, config->encryptionKey, strlen(config->encryptionKey));
+    signal(SIGPIPE, SIG_IGN);  // a client that hangs up only fails its own writes
+    
+    pthread_t* threads = calloc(jobs, sizeof(pthread_t));
+    if (!threads) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return 1;
+    }
+    for (int w = 0; w < jobs; w++) {
+        pthread_create(&threads[w], NULL, serveWorkerMain, &state);
+    }
+    
+    int status = 0;
+    if (!socketPath) {
+        serveStream(&state, STDIN_FILENO, STDOUT_FILENO);
+    } else {
+        struct sockaddr_un address = {0};
+        address.sun_family = AF_UNIX;
+        int listener = strlen(socketPath) < sizeof(address.sun_path) ? socket(AF_UNIX, SOCK_STREAM, 0) : -1;
+        if (listener >= 0) {
+            strcpy(address.sun_path, socketPath);
+            unlink(socketPath);
+        }
+        if (listener < 0 || bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 64) != 0) {
+            fprintf(stderr, "Error: Cannot listen on %s: %s\n", socketPath, strerror(errno));
+            status = 1;
+        } else {
+            fprintf(stderr, "Listening on %s with %d workers\n", socketPath, jobs);
+            for (;;) {
+                int fd = accept(listener, NULL, NULL);
+                if (fd < 0 && errno == EINTR) {
+                    continue;
+                }
+                ServeClient* client = fd >= 0 ? malloc(sizeof(ServeClient)) : NULL;
+                pthread_t thread;
+                if (!client) {
+                    status = 1;
+                    break;
+                }
+                client->state = &state;
+                client->fd = fd;
+                if (pthread_create(&thread, NULL, serveClientMain, client) == 0) {
+                    pthread_detach(thread);
+                } else {
+                    close(fd);
+                    free(client);
+                }
+            }
+        }
+        if (listener >= 0) {
+            close(listener);
+        }
+    }
+    
+    pthread_mutex_lock(&state.lock);
+    state.stopping = 1;
+    pthread_cond_broadcast(&state.queueChanged);
+    pthread_mutex_unlock(&state.lock);
+    for (int w = 0; w < jobs; w++) {
+        pthread_join(threads[w], NULL);
+    }
+    free(threads);
+    identifierTableFree(&state.shared.table);
+    pthread_mutex_destroy(&state.shared.lock);
+    pthread_cond_destroy(&state.shared.turnChanged);
+    pthread_mutex_destroy(&state.lock);
+    pthread_cond_destroy(&state.queueChanged);
+    return status;
+}
+
+// Enable exactly the passes named in a comma-separated --passes list:
+// strings, controlflow, deadcode, antidebug, identifiers
+int parsePassList(const char* list, CProcessorOptions* options) {
+    static const char* names[] = { "strings", "controlflow", "deadcode", "antidebug", "identifiers" };
+    int* flags[] = { &options->stringEncrypt, &options->controlFlow, &options->deadCode, &options->antiDebug,
+                     &options->renameIdentifiers };
+    int enabled[5] = {0};
     
+    while (*list) {
+        size_t length = strcspn(list, ",");
+        int found = 0;
+        for (int i = 0; i < 5 && !found; i++) {
+            found = strlen(names[i]) == length && strncmp(list, names[i], length) == 0;
+            enabled[i] |= found;
+        }
+        if (!found && length > 0) {
+            return 0;
+        }
+        list += length + (list[length] == ',');
+    }
+    for (int i = 0; i < 5; i++) {
+        *flags[i] = enabled[i];
+    }
+    return 1;
+}
+
+// C ABI, declared in ObfuscatorApi.h
+
+// A field of the caller's options, or `fallback` when the caller was built
+// against an older, shorter ObfuscatorOptions
+#define OBFUSCATOR_OPTION(options, field, fallback) \
+    ((options) && (options)->structSize >= offsetof(ObfuscatorOptions, field) + sizeof((options)->field) \
+         ? (options)->field : (fallback))
+
+struct CObfuscator {
+    CProcessorOptions config;
+    HotProfile profile;
+    IdentifierTable preserved;
+    SharedIdentifiers shared;  // renames kept across calls
+    Buffer result;             // output kept when the caller's buffer was too small
+};
+
+// Caller's buffer while the output fits, the handle's result after that
+typedef struct {
+    CObfuscator* obfuscator;
+    char* output;
+    size_t capacity;
+    size_t length;
+} ObfuscatorTarget;
+
+static int obfuscatorTargetWrite(void* context, const char* data, size_t length) {
+    ObfuscatorTarget* target = context;
+    if (target->length + length <= target->capacity) {
+        memcpy(target->output + target->length, data, length);
+    } else {
+        // Overflowed: move what the caller's buffer holds to the result
+        Buffer* result = &target->obfuscator->result;
+        if (result->length == 0 && target->length > 0 && !bufferAppend(result, target->output, target->length)) {
+            return 1;
+        }
+        if (!bufferAppend(result, data, length)) {
+            return 1;
+        }
+    }
+    target->length += length;
     return 0;
-}
\ No newline at end of file
+}
+
+typedef struct {
+    ObfuscatorWriteFn write;
+    void* context;
+    int aborted;
+} ObfuscatorStream;
+
+static int obfuscatorStreamWrite(void* context, const char* data, size_t length) {
+    ObfuscatorStream* stream = context;
+    stream->aborted = stream->write(stream->context, data, length) != 0;
+    return stream->aborted;
+}
+
+static int obfuscatorRun(CObfuscator* obfuscator, const char* source, size_t length, OutputWriter* out) {
+    const CProcessorOptions* config = &obfuscator->config;
+    CProcessorOptions options = {0};
+    strcpy(options.encryptionKey, config->encryptionKey);
+    options.antiDebug = config->antiDebug;
+    options.antiDebugInterval = config->antiDebugInterval;
+    options.controlFlow = config->controlFlow;
+    options.deadCode = config->deadCode;
+    options.stringEncrypt = config->stringEncrypt;
+    options.renameIdentifiers = config->renameIdentifiers;
+    options.deterministic = config->deterministic;
+    options.shared = &obfuscator->shared;
+    options.profile = config->profile;
+    options.preserved = config->preserved;
+    
+    int ok = processCodeStream(source ? source : "", length, &options, out);
+    stringTableFree(&options.strings);
+    identifierTableFree(&options.identifiers);
+    return ok;
+}
+
+CObfuscator* cObfuscatorCreate(const ObfuscatorOptions* options) {
+    CObfuscator* obfuscator = calloc(1, sizeof(CObfuscator));
+    if (!obfuscator) {
+        return NULL;
+    }
+    CProcessorOptions* config = &obfuscator->config;
+    const char* key = OBFUSCATOR_OPTION(options, encryptionKey, NULL);
+    snprintf(config->encryptionKey, sizeof(config->encryptionKey), "%s", key ? key : "default_encryption_key_32_chars_");
+    const char* passes = OBFUSCATOR_OPTION(options, passes, NULL);
+    const char* profilePath = OBFUSCATOR_OPTION(options, profilePath, NULL);
+    const char* preservePath = OBFUSCATOR_OPTION(options, preservePath, NULL);
+    const char* antiDebug = OBFUSCATOR_OPTION(options, antiDebugMode, NULL);
+    if (!parsePassList(passes ? passes : "strings,controlflow,deadcode,antidebug,identifiers", config) ||
+        (antiDebug && strcmp(antiDebug, "check") != 0 && strcmp(antiDebug, "monitor") != 0) ||
+        (profilePath && !hotProfileLoad(profilePath, OBFUSCATOR_OPTION(options, overheadBudget, 2.0),
+                                        OBFUSCATOR_OPTION(options, fullCost, (double)PROTECTION_FULL_COST),
+                                        OBFUSCATOR_OPTION(options, lightCost, (double)PROTECTION_LIGHT_COST),
+                                        &obfuscator->profile)) ||
+        (preservePath && !preserveListLoad(preservePath, &obfuscator->preserved))) {
+        hotProfileFree(&obfuscator->profile);
+        identifierTableFree(&obfuscator->preserved);
+        free(obfuscator);
+        return NULL;
+    }
+    config->deterministic = OBFUSCATOR_OPTION(options, deterministic, 0);
+    if (antiDebug && strcmp(antiDebug, "monitor") == 0) {
+        int interval = OBFUSCATOR_OPTION(options, antiDebugInterval, 100);
+        config->antiDebugInterval = interval > 0 ? interval : 1;
+    }
+    config->profile = profilePath ? &obfuscator->profile : NULL;
+    config->preserved = preservePath ? &obfuscator->preserved : NULL;
+    
+    pthread_mutex_init(&obfuscator->shared.lock, NULL);
+    pthread_cond_init(&obfuscator->shared.turnChanged, NULL);
+    nameGeneratorInit(&obfuscator->shared.table.generator, config->encryptionKey, strlen(config->encryptionKey));
+    return obfuscator;
+}
+
+void cObfuscatorDestroy(CObfuscator* obfuscator) {
+    if (!obfuscator) {
+        return;
+    }
+    hotProfileFree(&obfuscator->profile);
+    identifierTableFree(&obfuscator->preserved);
+    identifierTableFree(&obfuscator->shared.table);
+    pthread_mutex_destroy(&obfuscator->shared.lock);
+    pthread_cond_destroy(&obfuscator->shared.turnChanged);
+    free(obfuscator->result.data);
+    free(obfuscator);
+}
+
+ObfuscatorStatus cObfuscatorProcess(CObfuscator* obfuscator, const char* source, size_t length,
+                                    char* output, size_t capacity, size_t* outputLength) {
+    if (!obfuscator || (!source && length > 0) || (!output && capacity > 0) || !outputLength) {
+        return OBFUSCATOR_INVALID_ARGUMENT;
+    }
+    obfuscator->result.length = 0;
+    ObfuscatorTarget target = { obfuscator, output, capacity, 0 };
+    OutputWriter out = {0};
+    out.sink = obfuscatorTargetWrite;
+    out.sinkContext = &target;
+    int ok = obfuscatorRun(obfuscator, source, length, &out);
+    free(out.buffer.data);
+    
+    *outputLength = target.length;
+    if (!ok) {
+        return out.error ? OBFUSCATOR_OUT_OF_MEMORY : OBFUSCATOR_PROCESSING_FAILED;
+    }
+    return target.length > capacity ? OBFUSCATOR_BUFFER_TOO_SMALL : OBFUSCATOR_OK;
+}
+
+ObfuscatorStatus cObfuscatorProcessStream(CObfuscator* obfuscator, const char* source, size_t length,
+                                          ObfuscatorWriteFn write, void* context) {
+    if (!obfuscator || (!source && length > 0) || !write) {
+        return OBFUSCATOR_INVALID_ARGUMENT;
+    }
+    ObfuscatorStream stream = { write, context, 0 };
+    OutputWriter out = {0};
+    out.sink = obfuscatorStreamWrite;
+    out.sinkContext = &stream;
+    int ok = obfuscatorRun(obfuscator, source, length, &out);
+    free(out.buffer.data);
+    if (stream.aborted) {
+        return OBFUSCATOR_WRITE_ABORTED;
+    }
+    return ok ? OBFUSCATOR_OK : OBFUSCATOR_PROCESSING_FAILED;
+}
+
+ObfuscatorStatus cObfuscatorCopyResult(CObfuscator* obfuscator, char* output, size_t capacity, size_t* outputLength) {
+    if (!obfuscator || (!output && capacity > 0) || !outputLength) {
+        return OBFUSCATOR_INVALID_ARGUMENT;
+    }
+    *outputLength = obfuscator->result.length;
+    if (*outputLength > capacity) {
+        return OBFUSCATOR_BUFFER_TOO_SMALL;
+    }
+    if (*outputLength > 0) {
+        memcpy(output, obfuscator->result.data, *outputLength);
+    }
+    return OBFUSCATOR_OK;
+}
+
+// Main processor interface. Define PROCESSOR_NO_MAIN to include this file
+// in another program, e.g. the benchmarks under examples/benchmarks.
+#ifndef PROCESSOR_NO_MAIN
+int main(int argc, char* argv[]) {
+    const char* inputFile = NULL;
+    const char* project = NULL;
+    const char* outDir = "obfuscated";
+    const char* cacheDir = NULL;
+    const char* statsPath = NULL;  // "-" for stderr
+    const char* passes = "strings,controlflow,deadcode,antidebug,identifiers";
+    const char* profilePath = NULL;
+    double overheadBudget = 2;
+    double fullCost = PROTECTION_FULL_COST;
+    double lightCost = PROTECTION_LIGHT_COST;
+    const char* preservePath = NULL;
+    const char* antiDebug = "check";
+    int antiDebugInterval = 100;
+    int deterministic = 0;
+    int serve = 0;
+    const char* socketPath = NULL;  // NULL: serve stdin/stdout
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int jobs = cores > 0 ? (int)cores : 1;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--project=", 10) == 0) {
+            project = argv[i] + 10;
+        } else if (strncmp(argv[i], "--out=", 6) == 0) {
+            outDir = argv[i] + 6;
+        } else if (strncmp(argv[i], "--jobs=", 7) == 0) {
+            jobs = atoi(argv[i] + 7);
+        } else if (strcmp(argv[i], "--deterministic") == 0) {
+            deterministic = 1;
+        } else if (strncmp(argv[i], "--cache=", 8) == 0) {
+            cacheDir = argv[i] + 8;
+        } else if (strncmp(argv[i], "--passes=", 9) == 0) {
+            passes = argv[i] + 9;
+        } else if (strncmp(argv[i], "--profile=", 10) == 0) {
+            profilePath = argv[i] + 10;
+        } else if (strncmp(argv[i], "--overhead-budget=", 18) == 0) {
+            overheadBudget = atof(argv[i] + 18);
+        } else if (strncmp(argv[i], "--full-cost=", 12) == 0) {
+            fullCost = atof(argv[i] + 12);
+        } else if (strncmp(argv[i], "--light-cost=", 13) == 0) {
+            lightCost = atof(argv[i] + 13);
+        } else if (strncmp(argv[i], "--preserve=", 11) == 0) {
+            preservePath = argv[i] + 11;
+        } else if (strncmp(argv[i], "--anti-debug=", 13) == 0) {
+            antiDebug = argv[i] + 13;
+        } else if (strncmp(argv[i], "--anti-debug-interval=", 22) == 0) {
+            antiDebugInterval = atoi(argv[i] + 22);
+        } else if (strcmp(argv[i], "--serve") == 0) {
+            serve = 1;
+        } else if (strncmp(argv[i], "--serve=", 8) == 0) {
+            serve = 1;
+            socketPath = argv[i] + 8;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            statsPath = "-";
+        } else if (strncmp(argv[i], "--stats=", 8) == 0) {
+            statsPath = argv[i] + 8;
+        } else if (!inputFile) {
+            inputFile = argv[i];
+        }
+    }
+    
+    if (!inputFile && !project && !serve) {
+        printf("Usage: %s <input_file> [options]\n", argv[0]);
+        printf("       %s --project=<dir|compile_commands.json> [--out=DIR] [--jobs=N]\n", argv[0]);
+        printf("       %s --serve[=SOCKET] [--jobs=N] [options]\n", argv[0]);
+        printf("  --anti-debug=MODE How the anti-debugging pass checks for a debugger: check, once at the\n");
+        printf("                    top of main (default), or monitor, periodically on a background thread\n");
+        printf("  --anti-debug-interval=MS\n");
+        printf("                    Milliseconds between monitor checks (default: 100)\n");
+        printf("  --cache=DIR       Reuse outputs of unchanged files from DIR\n");
+        printf("  --deterministic   Derive all randomness from the key; identical input gives identical output\n");
+        printf("  --jobs=N          Worker threads for --project and --serve, or for the string pass\n");
+        printf("                    of a single file (default: all cores)\n");
+        printf("  --passes=LIST     Run only these passes (default: all): strings, controlflow,\n");
+        printf("                    deadcode, antidebug, identifiers\n");
+        printf("  --profile=FILE    CPU profile (perf script, gprof flat or a list of hot functions);\n");
+        printf("                    hot functions get lighter protection\n");
+        printf("  --overhead-budget=PERCENT\n");
+        printf("                    Estimated runtime overhead allowed with --profile (default: 2)\n");
+        printf("  --full-cost=PERCENT\n");
+        printf("                    Slowdown of a function's own time with full protection (default: %d)\n",
+               PROTECTION_FULL_COST);
+        printf("  --light-cost=PERCENT\n");
+        printf("                    The same with control flow only (default: %d); measure both with\n",
+               PROTECTION_LIGHT_COST);
+        printf("                    benchmark_runtime.js\n");
+        printf("  --preserve=FILE   Never rename the names listed in FILE (whitespace-separated, '#' comments),\n");
+        printf("                    in addition to keywords and library names\n");
+        printf("  --stats[=FILE]    Write per-pass timing, allocation and memory statistics as JSON to FILE\n");
+        printf("                    (default: stderr)\n");
+        printf("  --serve[=SOCKET]  Keep running and answer length-framed requests on stdin/stdout,\n");
+        printf("                    or on a Unix socket; --jobs sets the worker count\n");
+        return 1;
+    }
+    
+    // Initialize options
+    CProcessorOptions options = {0};
+    strcpy(options.encryptionKey, "default_encryption_key_32_chars_");
+    if (!parsePassList(passes, &options)) {
+        fprintf(stderr, "Error: Unknown pass in --passes=%s\n", passes);
+        return 1;
+    }
+    options.deterministic = deterministic;
+    if (strcmp(antiDebug, "monitor") == 0) {
+        options.antiDebugInterval = antiDebugInterval > 0 ? antiDebugInterval : 1;
+    } else if (strcmp(antiDebug, "check") != 0) {
+        fprintf(stderr, "Error: Unknown mode in --anti-debug=%s\n", antiDebug);
+        return 1;
+    }
+    nameGeneratorInit(&options.identifiers.generator, options.encryptionKey, strlen(options.encryptionKey));
+    
+    IdentifierTable preserved = {0};
+    if (preservePath) {
+        if (!preserveListLoad(preservePath, &preserved)) {
+            fprintf(stderr, "Error: Cannot open preserve list %s\n", preservePath);
+            return 1;
+        }
+        options.preserved = &preserved;
+    }
+    
+    HotProfile profile = {0};
+    if (profilePath) {
+        if (!hotProfileLoad(profilePath, overheadBudget, fullCost, lightCost, &profile)) {
+            fprintf(stderr, "Error: Cannot open profile %s\n", profilePath);
+            return 1;
+        }
+        size_t light = 0, none = 0;
+        for (size_t i = 0; i < profile.count; i++) {
+            light += profile.functions[i].level == PROTECTION_LIGHT;
+            none += profile.functions[i].level == PROTECTION_NONE;
+        }
+        fprintf(stderr, "Profile: %zu functions, %zu lightly protected, %zu unprotected, "
+                "estimated overhead %g%% (budget %g%%)\n",
+                profile.count, light, none, profile.overhead * 100, profile.budget * 100);
+        options.profile = &profile;
+    }
+    
+    if (serve) {
+        int status = processServe(&options, jobs, socketPath);
+        hotProfileFree(&profile);
+        identifierTableFree(&preserved);
+        return status;
+    }
+    if (project) {
+        int status = processProject(project, outDir, jobs, &options, cacheDir, statsPath);
+        hotProfileFree(&profile);
+        identifierTableFree(&preserved);
+        return status;
+    }
+    
+    options.literalJobs = jobs;
+    
+    // Map input file
+    size_t length = 0;
+    const char* code = mapFile(inputFile, &length);
+    if (!code) {
+        printf("Error: Cannot open file %s\n", inputFile);
+        return 1;
+    }
+    
+    ProcessStats stats = {0};
+    options.stats = statsPath ? &stats : NULL;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    // Process the code, streaming the result to stdout. Cached output is
+    // collected in memory so it can be stored.
+    OutputWriter out = {0};
+    out.file = stdout;
+    int ok;
+    char key[65];
+    if (cacheDir && cacheKey(code, length, &options, key)) {
+        char marker[8192];
+        snprintf(marker, sizeof(marker), "%s/.", cacheDir);
+        makeParentDirectories(marker);
+        
+        out.file = NULL;
+        ok = cacheLoad(cacheDir, key, &out.buffer, &options.identifiers);
+        if (!ok && (ok = processCodeStream(code, length, &options, &out))) {
+            cacheStore(cacheDir, key, out.buffer.data ? out.buffer.data : "", out.buffer.length, &options.identifiers);
+        }
+        ok = ok && fwrite(out.buffer.data, 1, out.buffer.length, stdout) == out.buffer.length;
+    } else {
+        ok = processCodeStream(code, length, &options, &out);
+    }
+    if (ok) {
+        fputc('\n', stdout);
+    } else {
+        fprintf(stderr, "Error: Cannot process file %s\n", inputFile);
+    }
+    if (statsPath) {
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        ok = processStatsWrite(&stats, secondsBetween(&start, &end), statsPath) && ok;
+    }
+    
+    // Cleanup
+    unmapFile(code, length);
+    free(out.buffer.data);
+    stringTableFree(&options.strings);
+    identifierTableFree(&options.identifiers);
+    identifierTableFree(&preserved);
+    hotProfileFree(&profile);
+    
+    return ok ? 0 : 1;
+}
+#endif
@@ -1,485 +1,3460 @@
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
-#include <regex>
+#include <set>
+#include <unordered_map>
 #include <random>
 #include <fstream>
 #include <sstream>
 #include <algorithm>
 #include <chrono>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <type_traits>
+#include <new>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
 #include <openssl/aes.h>
 #include <openssl/rand.h>
 #include <openssl/evp.h>
-#include <openssl/bio.h>
-#include <openssl/buffer.h>
+#include <openssl/hmac.h>
+#include "NameGenerator.h"
+#include "ObfuscatorApi.h"
 
-class CppProcessor {
+// Token kinds produced by the lexer
+enum class TokenKind : std::uint8_t {
+    Identifier,
+    Number,
+    String,        // "..." including encoding prefix and ud-suffix
+    RawString,     // R"delim(...)delim"
+    Char,
+    Comment,
+    Preprocessor,  // '#' plus directive name (and header name for #include)
+    Punctuation
+};
+
+struct Token {
+    std::uint32_t offset;
+    std::uint32_t length;
+    TokenKind kind;
+    bool inDirective;   // part of a preprocessor line
+    std::int32_t edit;  // index into SourceIR::edits, -1 when unchanged
+};
+
+// Lex-once intermediate representation shared by all passes. Tokens point
+// into a single copy of the source (or into the caller's buffer when the IR
+// borrows it); passes splice by attaching replacement text to tokens, and
+// the output is serialized once at the end. Whitespace is not tokenized and
+// is copied verbatim from the gaps between tokens.
+class SourceIR {
 private:
-    std::map<std::string, std::string> options;
-    std::map<std::string, std::string> identifierMap;
-    std::map<std::string, std::string> stringMap;
-    std::vector<std::string> encryptedStrings;
-    std::mt19937 rng;
+    std::string storage;      // the source when the IR owns it
+    std::string_view source;
+    std::vector<Token> tokens;
+    std::vector<std::string> edits;
+    std::vector<std::string> prologue;
+    size_t outputLength = 0;  // length serialize() would return
+    
+    static bool isIdentifierStart(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+    
+    static bool isIdentifierChar(char c) {
+        return isIdentifierStart(c) || (c >= '0' && c <= '9');
+    }
+    
+    void push(size_t start, size_t end, TokenKind kind, bool inDirective) {
+        tokens.push_back({static_cast<std::uint32_t>(start), static_cast<std::uint32_t>(end - start),
+                          kind, inDirective, -1});
+    }
+    
+    // Skip a quoted literal starting at the opening quote; returns the
+    // position just past the closing quote (or the end of the line)
+    size_t skipQuoted(size_t pos) const {
+        const char quote = source[pos++];
+        while (pos < source.length() && source[pos] != quote && source[pos] != '\n') {
+            pos += (source[pos] == '\\' && pos + 1 < source.length()) ? 2 : 1;
+        }
+        return pos < source.length() && source[pos] == quote ? pos + 1 : pos;
+    }
+    
+    size_t skipSuffix(size_t pos) const {
+        while (pos < source.length() && isIdentifierChar(source[pos])) {
+            ++pos;
+        }
+        return pos;
+    }
+    
+    void lex() {
+        const size_t length = source.length();
+        size_t pos = 0;
+        bool lineStart = true;
+        bool inDirective = false;
+        
+        while (pos < length) {
+            const char c = source[pos];
+            
+            if (c == '\n') {
+                lineStart = true;
+                inDirective = false;
+                ++pos;
+                continue;
+            }
+            if (c == '\\' && pos + 1 < length && source[pos + 1] == '\n') {
+                pos += 2;  // line continuation keeps a directive going
+                continue;
+            }
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') {
+                ++pos;
+                continue;
+            }
+            
+            size_t start = pos;
+            
+            if (c == '/' && pos + 1 < length && source[pos + 1] == '/') {
+                pos = source.find('\n', pos);
+                pos = pos == std::string::npos ? length : pos;
+                push(start, pos, TokenKind::Comment, inDirective);
+                continue;
+            }
+            if (c == '/' && pos + 1 < length && source[pos + 1] == '*') {
+                pos = source.find("*/", pos + 2);
+                pos = pos == std::string::npos ? length : pos + 2;
+                push(start, pos, TokenKind::Comment, inDirective);
+                continue;
+            }
+            
+            if (c == '#' && lineStart) {
+                inDirective = true;
+                lineStart = false;
+                ++pos;
+                while (pos < length && (source[pos] == ' ' || source[pos] == '\t')) {
+                    ++pos;
+                }
+                size_t nameStart = pos;
+                pos = skipSuffix(pos);
+                std::string_view directive(source.data() + nameStart, pos - nameStart);
+                
+                // Header names are opaque, not strings or comparisons
+                if (directive == "include" || directive == "import" || directive == "include_next") {
+                    size_t header = pos;
+                    while (header < length && (source[header] == ' ' || source[header] == '\t')) {
+                        ++header;
+                    }
+                    if (header < length && (source[header] == '<' || source[header] == '"')) {
+                        const char close = source[header] == '<' ? '>' : '"';
+                        size_t end = source.find_first_of(std::string(1, close) + "\n", header + 1);
+                        if (end != std::string::npos && source[end] == close) {
+                            pos = end + 1;
+                        }
+                    }
+                }
+                push(start, pos, TokenKind::Preprocessor, true);
+                continue;
+            }
+            lineStart = false;
+            
+            if (isIdentifierStart(c)) {
+                pos = skipSuffix(pos);
+                std::string_view word(source.data() + start, pos - start);
+                const bool raw = !word.empty() && word.back() == 'R' &&
+                                 (word == "R" || word == "u8R" || word == "uR" || word == "UR" || word == "LR");
+                const bool prefix = word == "u8" || word == "u" || word == "U" || word == "L";
+                
+                if (raw && pos < length && source[pos] == '"') {
+                    size_t open = source.find('(', pos + 1);
+                    if (open != std::string::npos) {
+                        std::string terminator = ")" + std::string(source.substr(pos + 1, open - pos - 1)) + "\"";
+                        size_t end = source.find(terminator, open + 1);
+                        pos = skipSuffix(end == std::string::npos ? length : end + terminator.length());
+                        push(start, pos, TokenKind::RawString, inDirective);
+                        continue;
+                    }
+                }
+                if (prefix && pos < length && (source[pos] == '"' || source[pos] == '\'')) {
+                    TokenKind kind = source[pos] == '"' ? TokenKind::String : TokenKind::Char;
+                    pos = skipSuffix(skipQuoted(pos));
+                    push(start, pos, kind, inDirective);
+                    continue;
+                }
+                push(start, pos, TokenKind::Identifier, inDirective);
+                continue;
+            }
+            
+            if ((c >= '0' && c <= '9') || (c == '.' && pos + 1 < length && source[pos + 1] >= '0' && source[pos + 1] <= '9')) {
+                // pp-number: digits, letters, '.', digit separators and exponent signs
+                ++pos;
+                while (pos < length) {
+                    const char d = source[pos];
+                    if (isIdentifierChar(d) || d == '.') {
+                        ++pos;
+                    } else if ((d == '+' || d == '-') && strchr("eEpP", source[pos - 1])) {
+                        ++pos;
+                    } else if (d == '\'' && pos + 1 < length && isIdentifierChar(source[pos + 1])) {
+                        ++pos;
+                    } else {
+                        break;
+                    }
+                }
+                push(start, pos, TokenKind::Number, inDirective);
+                continue;
+            }
+            
+            if (c == '"' || c == '\'') {
+                pos = skipSuffix(skipQuoted(pos));
+                push(start, pos, c == '"' ? TokenKind::String : TokenKind::Char, inDirective);
+                continue;
+            }
+            
+            push(start, ++pos, TokenKind::Punctuation, inDirective);
+        }
+    }
+
+public:
+    explicit SourceIR(std::string code) : storage(std::move(code)), source(storage), outputLength(source.length()) {
+        tokens.reserve(source.length() / 4);
+        lex();
+    }
+    
+    // Borrow `code` without copying it; it must outlive the IR
+    explicit SourceIR(std::string_view code) : source(code), outputLength(source.length()) {
+        tokens.reserve(source.length() / 4);
+        lex();
+    }
+    
+    // Tokens point into storage
+    SourceIR(const SourceIR&) = delete;
+    SourceIR& operator=(const SourceIR&) = delete;
+    
+    size_t size() const {
+        return tokens.size();
+    }
+    
+    size_t serializedLength() const {
+        return outputLength;
+    }
+    
+    const Token& operator[](size_t index) const {
+        return tokens[index];
+    }
+    
+    // Text of the token as it appears in the input
+    std::string_view original(size_t index) const {
+        return std::string_view(source.data() + tokens[index].offset, tokens[index].length);
+    }
+    
+    // Text of the token after any edits made by earlier passes
+    std::string_view text(size_t index) const {
+        const Token& token = tokens[index];
+        return token.edit < 0 ? original(index) : std::string_view(edits[token.edit]);
+    }
+    
+    bool isEdited(size_t index) const {
+        return tokens[index].edit >= 0;
+    }
+    
+    void replace(size_t index, std::string replacement) {
+        Token& token = tokens[index];
+        if (token.edit < 0) {
+            outputLength += replacement.length() - token.length;
+            token.edit = static_cast<std::int32_t>(edits.size());
+            edits.push_back(std::move(replacement));
+        } else {
+            outputLength += replacement.length() - edits[token.edit].length();
+            edits[token.edit] = std::move(replacement);
+        }
+    }
+    
+    // Add generated code ahead of the translation unit
+    void prepend(std::string code) {
+        outputLength += code.length();
+        prologue.insert(prologue.begin(), std::move(code));
+    }
+    
+    // Index of the next/previous token that is not a comment, or npos
+    size_t next(size_t index) const {
+        if (index == std::string::npos) {
+            return std::string::npos;
+        }
+        while (++index < tokens.size()) {
+            if (tokens[index].kind != TokenKind::Comment) {
+                return index;
+            }
+        }
+        return std::string::npos;
+    }
+    
+    size_t prev(size_t index) const {
+        if (index == std::string::npos) {
+            return std::string::npos;
+        }
+        while (index-- > 0) {
+            if (tokens[index].kind != TokenKind::Comment) {
+                return index;
+            }
+        }
+        return std::string::npos;
+    }
+    
+    bool is(size_t index, std::string_view value) const {
+        return index < tokens.size() && original(index) == value;
+    }
+    
+    // First token after `from` whose text is `value`; npos if a `stop`
+    // token comes first or the input ends
+    size_t find(size_t from, std::string_view value, std::string_view stop = {}) const {
+        if (from == std::string::npos) {
+            return std::string::npos;
+        }
+        for (size_t i = next(from); i != std::string::npos; i = next(i)) {
+            std::string_view token = original(i);
+            if (token == value) {
+                return i;
+            }
+            if (!stop.empty() && token == stop) {
+                break;
+            }
+        }
+        return std::string::npos;
+    }
+    
+    // For every ( [ { and ) ] } token, the index of its partner; npos for
+    // other tokens and for brackets that do not pair up. One pass with a
+    // stack, so a pass can jump over any nested construct in O(1).
+    // Brackets inside preprocessor lines are ignored.
+    std::vector<size_t> matchBrackets() const {
+        std::vector<size_t> match(tokens.size(), std::string::npos);
+        std::vector<size_t> open;
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            if (tokens[i].kind != TokenKind::Punctuation || tokens[i].inDirective) {
+                continue;
+            }
+            const char c = source[tokens[i].offset];
+            if (c == '(' || c == '[' || c == '{') {
+                open.push_back(i);
+            } else if (c == ')' || c == ']' || c == '}') {
+                const char expected = c == ')' ? '(' : c == ']' ? '[' : '{';
+                if (!open.empty() && source[tokens[open.back()].offset] == expected) {
+                    match[open.back()] = i;
+                    match[i] = open.back();
+                    open.pop_back();
+                }
+            }
+        }
+        return match;
+    }
+
+    std::string serialize() const {
+        std::string result;
+        result.reserve(outputLength);
+        serializeTo([&result](const char* data, size_t length) { result.append(data, length); });
+        return result;
+    }
+    
+    // Hand the output to `write(data, length)` in order, in pieces, without
+    // assembling it; stops early once write returns false
+    template <typename Write>
+    bool serializeTo(Write&& write) const {
+        auto emit = [&write](const char* data, size_t length) {
+            if constexpr (std::is_void_v<decltype(write(data, length))>) {
+                write(data, length);
+                return true;
+            } else {
+                return length == 0 || static_cast<bool>(write(data, length));
+            }
+        };
+        for (const auto& code : prologue) {
+            if (!emit(code.data(), code.length())) {
+                return false;
+            }
+        }
+        
+        size_t copied = 0;
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            if (tokens[i].edit < 0) {
+                continue;
+            }
+            const std::string& edit = edits[tokens[i].edit];
+            if (!emit(source.data() + copied, tokens[i].offset - copied) || !emit(edit.data(), edit.length())) {
+                return false;
+            }
+            copied = tokens[i].offset + tokens[i].length;
+        }
+        return emit(source.data() + copied, source.length() - copied);
+    }
+};
+
+// Deterministic key derivation: HMAC-SHA256(key, label). Each use passes its
+// own domain label so derived values never repeat across purposes.
+static void deriveBytes(const std::string& key, const std::string& label, unsigned char out[32]) {
+    unsigned int length = 0;
+    HMAC(EVP_sha256(), key.data(), static_cast<int>(key.size()),
+         reinterpret_cast<const unsigned char*>(label.data()), label.size(), out, &length);
+}
+
+// AES-256-CTR encryptor for the packed string segment. All literals of a
+// file are encrypted as one segment under one nonce. CTR needs no padding
+// and lets the runtime start the keystream at any block, so one string can
+// be decrypted without its neighbours, and lets the segment be encrypted in
+// parts on several threads. Nonces are drawn from a bulk random buffer; in
+// deterministic mode they are derived from the key and a per-file label
+// instead.
+class StringCipher {
+private:
+    static constexpr size_t IV_POOL_SIZE = 256 * AES_BLOCK_SIZE;
+    
+    std::string key;
+    std::string paddedKey;
+    std::vector<unsigned char> ivPool;
+    size_t ivOffset = IV_POOL_SIZE;
+    bool derivedIVs = false;
+    std::string ivLabel;
+    std::uint64_t ivCounter = 0;
+    unsigned char derivedIV[32];
+    
+    const unsigned char* nextIV() {
+        if (derivedIVs) {
+            std::string label = ivLabel;
+            for (int shift = 56; shift >= 0; shift -= 8) {
+                label += static_cast<char>((ivCounter >> shift) & 0xFF);
+            }
+            ++ivCounter;
+            deriveBytes(key, label, derivedIV);
+            return derivedIV;
+        }
+        if (ivOffset == IV_POOL_SIZE) {
+            if (RAND_bytes(ivPool.data(), IV_POOL_SIZE) != 1) {
+                return nullptr;
+            }
+            ivOffset = 0;
+        }
+        const unsigned char* iv = ivPool.data() + ivOffset;
+        ivOffset += AES_BLOCK_SIZE;
+        return iv;
+    }
+
+public:
+    explicit StringCipher(const std::string& encryptionKey)
+        : key(encryptionKey), paddedKey(encryptionKey), ivPool(IV_POOL_SIZE) {
+        paddedKey.resize(32, '\0');
+    }
+    
+    StringCipher(const StringCipher&) = delete;
+    StringCipher& operator=(const StringCipher&) = delete;
+    
+    const std::string& getKey() const {
+        return key;
+    }
+    
+    // The key as the runtime uses it, zero-padded to 32 bytes
+    const std::string& getPaddedKey() const {
+        return paddedKey;
+    }
+    
+    // Switch to derived IVs for the literals of one file
+    void deriveIVs(const std::string& fileLabel) {
+        derivedIVs = true;
+        ivLabel = "iv:" + fileLabel + ":";
+        ivCounter = 0;
+    }
+    
+    // Nonce of the next segment
+    bool nextNonce(unsigned char nonce[AES_BLOCK_SIZE]) {
+        const unsigned char* iv = nextIV();
+        if (iv) {
+            memcpy(nonce, iv, AES_BLOCK_SIZE);
+        }
+        return iv != nullptr;
+    }
+    
+    // Encrypt the part of a segment that starts at byte `offset`. Byte i of
+    // the segment is encrypted with counter block nonce + i / 16. Each call
+    // has its own cipher context, so parts can be encrypted concurrently.
+    bool encryptPart(std::string_view plaintext, size_t offset, const unsigned char nonce[AES_BLOCK_SIZE],
+                     std::string& ciphertext) const {
+        // nonce + offset / 16 as a 128-bit big-endian number
+        unsigned char counter[AES_BLOCK_SIZE];
+        unsigned carry = 0;
+        size_t block = offset / AES_BLOCK_SIZE;
+        for (int i = AES_BLOCK_SIZE - 1; i >= 0; --i) {
+            carry += nonce[i] + (block & 0xFF);
+            counter[i] = static_cast<unsigned char>(carry);
+            carry >>= 8;
+            block >>= 8;
+        }
+        
+        ciphertext.resize(plaintext.length());
+        unsigned char skipped[AES_BLOCK_SIZE] = {0};
+        int skip = static_cast<int>(offset % AES_BLOCK_SIZE);
+        int len = 0;
+        EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+        bool ok = ctx &&
+                  EVP_EncryptInit_ex(ctx, EVP_aes_256_ctr(), NULL,
+                                     reinterpret_cast<const unsigned char*>(paddedKey.data()), counter) == 1 &&
+                  (skip == 0 || EVP_EncryptUpdate(ctx, skipped, &len, skipped, skip) == 1) &&
+                  (plaintext.empty() ||
+                   EVP_EncryptUpdate(ctx, reinterpret_cast<unsigned char*>(&ciphertext[0]), &len,
+                                     reinterpret_cast<const unsigned char*>(plaintext.data()),
+                                     static_cast<int>(plaintext.length())) == 1);
+        EVP_CIPHER_CTX_free(ctx);
+        return ok;
+    }
+};
+
+// Throughput of the string encryption path
+struct EncryptionStats {
+    size_t literals = 0;
+    size_t bytes = 0;
+    double seconds = 0;
+    
+    double literalsPerSecond() const {
+        return seconds > 0 ? literals / seconds : 0;
+    }
+};
+
+// Heap allocations made by the current thread while counting is enabled.
+// The counters are fed by the replacement operator new next to main; a
+// build without it (PROCESSOR_NO_MAIN) reports zero allocations.
+namespace allocation_counter {
+thread_local bool enabled = false;
+thread_local size_t count = 0;
+thread_local size_t bytes = 0;
+}
+
+// Cost of one pass, summed over every file it ran on
+struct PassStats {
+    std::string name;
+    size_t runs = 0;
+    double wallSeconds = 0;
+    double cpuSeconds = 0;  // thread CPU time
+    size_t bytesIn = 0;
+    size_t bytesOut = 0;
+    size_t allocations = 0;
+    size_t allocatedBytes = 0;
+    long peakRssKb = 0;  // process high-water mark when the pass ended
+};
+
+// Counters at the start of a pass
+struct PassProbe {
+    std::chrono::steady_clock::time_point wall;
+    double cpu = 0;
+    size_t allocations = 0;
+    size_t allocatedBytes = 0;
+    
+    static double threadCpuSeconds() {
+        timespec time;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+        return time.tv_sec + time.tv_nsec / 1e9;
+    }
+    
+    static PassProbe start() {
+        PassProbe probe;
+        probe.allocations = allocation_counter::count;
+        probe.allocatedBytes = allocation_counter::bytes;
+        probe.cpu = threadCpuSeconds();
+        probe.wall = std::chrono::steady_clock::now();
+        return probe;
+    }
+    
+    void finish(PassStats& pass, size_t bytesIn, size_t bytesOut) const {
+        pass.wallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - wall).count();
+        pass.cpuSeconds += threadCpuSeconds() - cpu;
+        pass.allocations += allocation_counter::count - allocations;
+        pass.allocatedBytes += allocation_counter::bytes - allocatedBytes;
+        pass.bytesIn += bytesIn;
+        pass.bytesOut += bytesOut;
+        pass.runs++;
+        
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        pass.peakRssKb = std::max(pass.peakRssKb, static_cast<long>(usage.ru_maxrss));
+    }
+};
+
+// Instrumentation for --stats. A processor only collects it once
+// enableStats() is called; otherwise each pass costs one null check.
+struct ProcessStats {
+    std::vector<PassStats> passes;  // in pipeline order
+    size_t files = 0;
+    size_t identifiers = 0;  // identifiers renamed, summed over files
+    size_t classes = 0;
+    EncryptionStats encryption;
+    
+    PassStats& pass(const char* name) {
+        for (auto& pass : passes) {
+            if (pass.name == name) {
+                return pass;
+            }
+        }
+        passes.emplace_back();
+        passes.back().name = name;
+        return passes.back();
+    }
+    
+    void merge(const ProcessStats& other) {
+        for (const auto& from : other.passes) {
+            PassStats& to = pass(from.name.c_str());
+            to.runs += from.runs;
+            to.wallSeconds += from.wallSeconds;
+            to.cpuSeconds += from.cpuSeconds;
+            to.bytesIn += from.bytesIn;
+            to.bytesOut += from.bytesOut;
+            to.allocations += from.allocations;
+            to.allocatedBytes += from.allocatedBytes;
+            to.peakRssKb = std::max(to.peakRssKb, from.peakRssKb);
+        }
+        files += other.files;
+        identifiers += other.identifiers;
+        classes += other.classes;
+        encryption.literals += other.encryption.literals;
+        encryption.bytes += other.encryption.bytes;
+        encryption.seconds += other.encryption.seconds;
+    }
+    
+    std::string toJson(double wallSeconds) const {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        
+        std::ostringstream json;
+        char number[64];
+        auto seconds = [&](double value) {
+            std::snprintf(number, sizeof(number), "%.6f", value);
+            return number;
+        };
+        json << "{\n  \"processor\": \"cpp\",\n  \"files\": " << files
+             << ",\n  \"wallSeconds\": " << seconds(wallSeconds)
+             << ",\n  \"peakRssKb\": " << usage.ru_maxrss
+             << ",\n  \"literals\": " << encryption.literals
+             << ",\n  \"literalBytes\": " << encryption.bytes
+             << ",\n  \"encryptionSeconds\": " << seconds(encryption.seconds)
+             << ",\n  \"identifiers\": " << identifiers
+             << ",\n  \"classes\": " << classes
+             << ",\n  \"passes\": [";
+        for (size_t i = 0; i < passes.size(); ++i) {
+            const PassStats& pass = passes[i];
+            json << (i ? "," : "") << "\n    {\"name\": \"" << pass.name << "\", \"runs\": " << pass.runs
+                 << ", \"wallSeconds\": " << seconds(pass.wallSeconds)
+                 << ", \"cpuSeconds\": " << seconds(pass.cpuSeconds)
+                 << ", \"bytesIn\": " << pass.bytesIn << ", \"bytesOut\": " << pass.bytesOut
+                 << ", \"allocations\": " << pass.allocations << ", \"allocatedBytes\": " << pass.allocatedBytes
+                 << ", \"peakRssKb\": " << pass.peakRssKb << "}";
+        }
+        json << "\n  ]\n}\n";
+        return json.str();
+    }
+};
+
+// Passes that --passes can select; identifiers covers the class, template
+// and identifier renames
+enum PassFlags : unsigned {
+    PassStrings = 1,
+    PassIdentifiers = 2,
+    PassControlFlow = 4,
+    PassDeadCode = 8,
+    PassAntiDebug = 16,
+    PassAll = 31
+};
+
+// Parse a comma-separated pass list such as "strings,deadcode"
+static bool parsePassList(const std::string& list, unsigned& passes) {
+    static const std::map<std::string, unsigned> names = {
+        {"strings", PassStrings}, {"identifiers", PassIdentifiers}, {"controlflow", PassControlFlow},
+        {"deadcode", PassDeadCode}, {"antidebug", PassAntiDebug}
+    };
+    passes = 0;
+    std::stringstream items(list);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        auto it = names.find(item);
+        if (it == names.end()) {
+            if (!item.empty()) {
+                return false;
+            }
+            continue;
+        }
+        passes |= it->second;
+    }
+    return true;
+}
+
+// How much of the control-flow and dead-code protection a function gets
+enum class ProtectionLevel : std::uint8_t {
+    Full,   // every transform
+    Light,  // if-to-switch only
+    None    // left as written
+};
+
+// Hot functions from a CPU profile and the protection each one can afford.
+// Each function's share of the runtime is multiplied by the estimated
+// slowdown of its protection level, and the hottest functions are
+// downgraded until the total fits the overhead budget. Functions that are
+// not in the profile stay fully protected.
+class ObfuscationProfile {
+public:
+    // Default slowdown of a function's own time at each level, in percent,
+    // estimated from examples/benchmark_runtime.js: the dead-code snippets
+    // call into libc on function entry, an if-to-switch rewrite is nearly
+    // free. --full-cost and --light-cost replace them with measured numbers.
+    static constexpr double kFullCost = 55;
+    static constexpr double kLightCost = 5;
+    
+    // Read perf script output, a gprof flat profile or a plain list with
+    // one function per line and an optional percentage of the runtime.
+    // Listed functions without a percentage are left unprotected.
+    static bool load(const std::string& path, double budgetPercent, double fullCostPercent, double lightCostPercent,
+                     ObfuscationProfile& profile) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            return false;
+        }
+        std::vector<std::string> lines;
+        std::string line;
+        while (std::getline(file, line)) {
+            lines.push_back(line);
+        }
+        
+        profile.budget = budgetPercent / 100;
+        profile.fullCost = fullCostPercent / 100;
+        profile.lightCost = lightCostPercent / 100;
+        std::map<std::string, double> weights;
+        double total = 0;
+        bool gprof = std::any_of(lines.begin(), lines.end(),
+                                 [](const std::string& l) { return l.find("Flat profile:") != std::string::npos; });
+        bool perf = !gprof && std::any_of(lines.begin(), lines.end(),
+                                          [](const std::string& l) { return !perfFrame(l).empty(); });
+        if (gprof) {
+            // "%time cumulative self [calls self/call total/call] name"
+            for (const auto& row : lines) {
+                if (row.find("Call graph") != std::string::npos) {
+                    break;
+                }
+                std::istringstream fields(row);
+                std::string field;
+                std::vector<std::string> numbers;
+                while (fields >> field && numbers.size() < 6 && isNumber(field)) {
+                    numbers.push_back(field);
+                }
+                std::string rest;
+                std::getline(fields, rest);
+                if (numbers.size() >= 3 && !isNumber(field)) {
+                    weights[baseName(field + rest)] += std::stod(numbers[0]);
+                }
+            }
+            total = 100;
+        } else if (perf) {
+            // One sample per event; the first frame after the event line is
+            // the function the sample landed in
+            bool expectLeaf = false;
+            for (const auto& row : lines) {
+                if (row.find_first_not_of(" \t") == std::string::npos) {
+                    continue;
+                }
+                bool event = row[0] != ' ' && row[0] != '\t';
+                if (!event && !expectLeaf) {
+                    continue;
+                }
+                std::string symbol = perfFrame(row);
+                total += event;
+                expectLeaf = event && symbol.empty();
+                if (!symbol.empty() && symbol != "[unknown]") {
+                    weights[baseName(symbol)] += 1;
+                }
+            }
+        } else {
+            for (const auto& row : lines) {
+                std::istringstream fields(row);
+                std::string name, percent;
+                if (!(fields >> name) || name[0] == '#') {
+                    continue;
+                }
+                if (fields >> percent && isNumber(percent)) {
+                    weights[baseName(name)] += std::stod(percent);
+                } else {
+                    weights[baseName(name)] = -1;
+                }
+            }
+            total = 100;
+        }
+        
+        profile.functions.clear();
+        for (const auto& weight : weights) {
+            if (weight.first.empty()) {
+                continue;
+            }
+            Function function;
+            function.share = weight.second < 0 ? -1 : (total > 0 ? weight.second / total : 0);
+            function.level = function.share < 0 ? ProtectionLevel::None : ProtectionLevel::Full;
+            profile.functions[weight.first] = function;
+        }
+        profile.fitBudget();
+        return true;
+    }
+    
+    ProtectionLevel levelFor(std::string_view name) const {
+        auto it = functions.find(std::string(name));
+        return it == functions.end() ? ProtectionLevel::Full : it->second.level;
+    }
+    
+    double estimatedOverhead() const {
+        return overhead;
+    }
+    
+    // Canonical text of the decisions, for cache keys
+    std::string fingerprint() const {
+        std::string text;
+        for (const auto& function : functions) {
+            if (function.second.level != ProtectionLevel::Full) {
+                text += function.first + '=' + std::to_string(static_cast<int>(function.second.level)) + ';';
+            }
+        }
+        return text;
+    }
+    
+    void summary(std::ostream& out) const {
+        size_t light = 0, none = 0;
+        for (const auto& function : functions) {
+            light += function.second.level == ProtectionLevel::Light;
+            none += function.second.level == ProtectionLevel::None;
+        }
+        out << "Profile: " << functions.size() << " functions, " << light << " lightly protected, " << none
+            << " unprotected, estimated overhead " << overhead * 100 << "% (budget " << budget * 100 << "%)"
+            << std::endl;
+    }
+
+private:
+    struct Function {
+        double share = 0;  // fraction of the runtime, -1 when unknown
+        ProtectionLevel level = ProtectionLevel::Full;
+    };
+    
+    std::map<std::string, Function> functions;
+    double budget = 0.02;
+    double fullCost = kFullCost / 100;
+    double lightCost = kLightCost / 100;
+    double overhead = 0;
+    
+    double cost(ProtectionLevel level) const {
+        return level == ProtectionLevel::Full ? fullCost : level == ProtectionLevel::Light ? lightCost : 0;
+    }
+    
+    // Downgrade the function that costs the most, one level at a time,
+    // until the estimated overhead is within budget
+    void fitBudget() {
+        for (;;) {
+            overhead = 0;
+            Function* worst = nullptr;
+            for (auto& function : functions) {
+                double contribution = std::max(0.0, function.second.share) * cost(function.second.level);
+                overhead += contribution;
+                if (contribution > 0 && (!worst || contribution > worst->share * cost(worst->level))) {
+                    worst = &function.second;
+                }
+            }
+            if (overhead <= budget + 1e-12 || !worst) {
+                return;
+            }
+            worst->level = worst->level == ProtectionLevel::Full ? ProtectionLevel::Light : ProtectionLevel::None;
+        }
+    }
+    
+    static bool isNumber(const std::string& text) {
+        char* end = nullptr;
+        std::strtod(text.c_str(), &end);
+        return !text.empty() && end && *end == '\0';
+    }
+    
+    // Symbol of a perf script frame ("<address> <symbol>+<offset> (<dso>)"),
+    // also at the end of a single-line event; empty when there is none
+    static std::string perfFrame(const std::string& line) {
+        size_t dso = line.rfind(" (");
+        if (dso == std::string::npos || line.back() != ')') {
+            return std::string();
+        }
+        std::istringstream fields(line.substr(0, dso));
+        std::vector<std::string> words;
+        std::string word;
+        while (fields >> word) {
+            words.push_back(word);
+        }
+        if (words.size() < 2 || words[words.size() - 2].find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+            return std::string();
+        }
+        return words.back();
+    }
+    
+    // "void ns::Widget<int>::draw[abi:cxx11](int) const+0x1a" -> "draw"
+    static std::string baseName(std::string symbol) {
+        size_t offset = symbol.find("+0x");
+        if (offset != std::string::npos) {
+            symbol.erase(offset);
+        }
+        size_t depth = 0;
+        for (size_t i = 0; i < symbol.size(); ++i) {
+            if (symbol[i] == '(' && depth == 0) {
+                symbol.erase(i);
+                break;
+            }
+            depth += symbol[i] == '<';
+            depth -= symbol[i] == '>' && depth > 0;
+        }
+        for (size_t abi; (abi = symbol.find("[abi:")) != std::string::npos;) {
+            symbol.erase(abi, symbol.find(']', abi) - abi + 1);
+        }
+        while (!symbol.empty() && symbol.back() == ' ') {
+            symbol.pop_back();
+        }
+        
+        // Drop the template arguments of the function itself
+        depth = 0;
+        for (size_t i = symbol.size(); i-- > 0 && symbol.back() == '>';) {
+            depth += (symbol[i] == '>') - (symbol[i] == '<');
+            if (depth == 0) {
+                symbol.erase(i);
+                break;
+            }
+        }
+        size_t scope = symbol.rfind("::");
+        symbol = scope == std::string::npos ? symbol : symbol.substr(scope + 2);
+        size_t space = symbol.rfind(' ');
+        return space == std::string::npos ? symbol : symbol.substr(space + 1);
+    }
+};
+
+// Perfect hashing by hash-and-displace. A name's hash picks a bucket, and
+// each bucket keeps the first displacement that sends all of its names to
+// free slots, so a lookup hashes the name once and compares it with a single
+// slot. The builder is constexpr: the built-in reserved names are placed at
+// compile time, names from --preserve when a processor is created.
+namespace perfect_hash {
+
+constexpr std::uint64_t hash(std::string_view name, std::uint64_t seed) {
+    // FNV-1a, seeded so that a failed build can retry with other hashes
+    std::uint64_t value = 14695981039346656037ull ^ seed;
+    for (char c : name) {
+        value = (value ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    return value;
+}
+
+constexpr std::uint64_t mix(std::uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+constexpr std::size_t bucketOf(std::uint64_t hash, std::size_t buckets) {
+    return mix(hash) % buckets;
+}
+
+constexpr std::size_t slotOf(std::uint64_t hash, std::uint32_t displacement, std::size_t slots) {
+    return mix(hash + (displacement + 1ull) * 0x9e3779b97f4a7c15ull) & (slots - 1);
+}
+
+// At most half the slots are used, so small displacements almost always fit
+constexpr std::size_t slotCount(std::size_t names) {
+    std::size_t slots = 2;
+    while (slots < 2 * names) {
+        slots *= 2;
+    }
+    return slots;
+}
+
+constexpr std::size_t bucketCount(std::size_t names) {
+    return names / 2 + 1;
+}
+
+constexpr bool contains(std::string_view name, std::uint64_t seed, const std::string_view* slots, std::size_t slotCount,
+                        const std::uint32_t* displacements, std::size_t bucketCount) {
+    std::uint64_t value = hash(name, seed);
+    return !name.empty() && slots[slotOf(value, displacements[bucketOf(value, bucketCount)], slotCount)] == name;
+}
+
+// Place `count` distinct, non-empty names. `hashes` and `order` are scratch
+// space of `count` entries, `starts` of bucketCount + 1. False when some
+// bucket finds no free slots; the caller then retries with another seed.
+constexpr bool build(const std::string_view* names, std::size_t count, std::uint64_t seed,
+                     std::string_view* slots, std::size_t slotCount, std::uint32_t* displacements, std::size_t bucketCount,
+                     std::uint64_t* hashes, std::size_t* order, std::size_t* starts) {
+    for (std::size_t i = 0; i < slotCount; ++i) {
+        slots[i] = std::string_view();
+    }
+    for (std::size_t b = 0; b < bucketCount; ++b) {
+        displacements[b] = 0;
+        starts[b + 1] = 0;
+    }
+    
+    // Group the names by bucket
+    starts[0] = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        hashes[i] = hash(names[i], seed);
+        ++starts[bucketOf(hashes[i], bucketCount) + 1];
+    }
+    std::size_t largest = 0;
+    for (std::size_t b = 0; b < bucketCount; ++b) {
+        largest = std::max(largest, starts[b + 1]);
+        starts[b + 1] += starts[b];
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        order[starts[bucketOf(hashes[i], bucketCount)]++] = i;
+    }
+    for (std::size_t b = bucketCount; b > 0; --b) {
+        starts[b] = starts[b - 1];
+    }
+    starts[0] = 0;
+    
+    // Largest buckets first, while most slots are still free
+    for (std::size_t size = largest; size > 0; --size) {
+        for (std::size_t b = 0; b < bucketCount; ++b) {
+            if (starts[b + 1] - starts[b] != size) {
+                continue;
+            }
+            for (std::uint32_t displacement = 0;; ++displacement) {
+                if (displacement == 0xffff) {
+                    return false;
+                }
+                bool fits = true;
+                for (std::size_t k = starts[b]; k < starts[b + 1] && fits; ++k) {
+                    std::size_t slot = slotOf(hashes[order[k]], displacement, slotCount);
+                    fits = slots[slot].empty();
+                    for (std::size_t j = starts[b]; j < k && fits; ++j) {
+                        fits = slotOf(hashes[order[j]], displacement, slotCount) != slot;
+                    }
+                }
+                if (fits) {
+                    displacements[b] = displacement;
+                    break;
+                }
+            }
+            for (std::size_t k = starts[b]; k < starts[b + 1]; ++k) {
+                slots[slotOf(hashes[order[k]], displacements[b], slotCount)] = names[order[k]];
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace perfect_hash
+
+// Fixed set of names placed at compile time
+template <std::size_t N>
+class StaticNameSet {
+    static constexpr std::size_t kSlots = perfect_hash::slotCount(N);
+    static constexpr std::size_t kBuckets = perfect_hash::bucketCount(N);
+    
+    std::string_view slots[kSlots] = {};
+    std::uint32_t displacements[kBuckets] = {};
+    std::uint64_t seed = 0;
+    
+public:
+    constexpr explicit StaticNameSet(const std::string_view (&names)[N]) {
+        std::uint64_t hashes[N] = {};
+        std::size_t order[N] = {};
+        std::size_t starts[kBuckets + 1] = {};
+        while (!perfect_hash::build(names, N, seed, slots, kSlots, displacements, kBuckets, hashes, order, starts)) {
+            ++seed;
+        }
+    }
+    
+    constexpr bool contains(std::string_view name) const {
+        return perfect_hash::contains(name, seed, slots, kSlots, displacements, kBuckets);
+    }
+};
+
+// Names the identifier passes never rename: C++ keywords, contextual
+// keywords, main, preprocessor names and the standard library names every
+// source uses. Member and C library names that user code may also declare,
+// such as size, count or time, are in cpp_library_names.txt for --preserve.
+constexpr std::string_view kReservedNameList[] = {
+    // Keywords
+    "alignas", "alignof", "and", "and_eq", "asm", "atomic_cancel", "atomic_commit",
+    "atomic_noexcept", "auto", "bitand", "bitor", "bool", "break", "case",
+    "catch", "char", "char8_t", "char16_t", "char32_t", "class", "compl",
+    "concept", "const", "consteval", "constexpr", "constinit", "const_cast",
+    "continue", "co_await", "co_return", "co_yield", "decltype", "default",
+    "delete", "do", "double", "dynamic_cast", "else", "enum", "explicit",
+    "export", "extern", "false", "float", "for", "friend", "goto", "if",
+    "inline", "int", "long", "mutable", "namespace", "new", "noexcept",
+    "not", "not_eq", "nullptr", "operator", "or", "or_eq", "private",
+    "protected", "public", "reflexpr", "register", "reinterpret_cast",
+    "requires", "return", "short", "signed", "sizeof", "static",
+    "static_assert", "static_cast", "struct", "switch", "synchronized",
+    "template", "this", "thread_local", "throw", "true", "try", "typedef",
+    "typeid", "typename", "union", "unsigned", "using", "virtual", "void",
+    "volatile", "wchar_t", "while", "xor", "xor_eq", "override", "final",
+    "main",
+    // Preprocessor
+    "include", "define", "undef", "ifdef", "ifndef", "elif", "endif", "pragma", "error", "defined",
+    "NULL", "EOF", "EXIT_SUCCESS", "EXIT_FAILURE", "__FILE__", "__LINE__", "__func__",
+    // Standard library
+    "std", "cout", "cin", "endl", "string", "vector", "map", "set", "list", "iostream", "fstream", "sstream",
+    "algorithm", "iterator", "memory", "shared_ptr", "unique_ptr", "make_shared", "make_unique"
+};
+
+constexpr StaticNameSet kReservedNames(kReservedNameList);
+
+// The reserved names plus a list from --preserve, with the same single
+// probe per lookup
+class NameSet {
+    std::vector<std::string> extra;
+    std::vector<std::string_view> slots;
+    std::vector<std::uint32_t> displacements;
+    std::uint64_t seed = 0;
+    
+public:
+    // `list` holds one name per line
+    explicit NameSet(std::string_view list) {
+        std::vector<std::string_view> names(std::begin(kReservedNameList), std::end(kReservedNameList));
+        while (!list.empty()) {
+            size_t end = std::min(list.find('\n'), list.size());
+            std::string_view name = list.substr(0, end);
+            if (!name.empty() && !kReservedNames.contains(name)) {
+                extra.emplace_back(name);
+            }
+            list.remove_prefix(std::min(end + 1, list.size()));
+        }
+        std::sort(extra.begin(), extra.end());
+        extra.erase(std::unique(extra.begin(), extra.end()), extra.end());
+        names.insert(names.end(), extra.begin(), extra.end());
+        
+        slots.resize(perfect_hash::slotCount(names.size()));
+        displacements.resize(perfect_hash::bucketCount(names.size()));
+        std::vector<std::uint64_t> hashes(names.size());
+        std::vector<std::size_t> order(names.size());
+        std::vector<std::size_t> starts(displacements.size() + 1);
+        while (!perfect_hash::build(names.data(), names.size(), seed, slots.data(), slots.size(), displacements.data(),
+                                    displacements.size(), hashes.data(), order.data(), starts.data())) {
+            ++seed;
+        }
+    }
+    
+    NameSet(const NameSet&) = delete;  // slots point into `extra`
+    NameSet& operator=(const NameSet&) = delete;
+    
+    bool contains(std::string_view name) const {
+        return perfect_hash::contains(name, seed, slots.data(), slots.size(), displacements.data(), displacements.size());
+    }
+    
+    // Read a --preserve file: names separated by whitespace, '#' starts a
+    // comment. The names come back sorted, one per line.
+    static bool readList(const std::string& path, std::string& list) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            return false;
+        }
+        std::set<std::string> names;
+        std::string line;
+        while (std::getline(file, line)) {
+            line.erase(std::min(line.find('#'), line.size()));
+            std::istringstream words(line);
+            std::string name;
+            while (words >> name) {
+                names.insert(name);
+            }
+        }
+        list.clear();
+        for (const auto& name : names) {
+            list += name + '\n';
+        }
+        return true;
+    }
+};
+
+// Renames shared by every file of a project so that identifiers stay
+// consistent across translation units. Passes resolve all the names a
+// file needs under one lock and then rewrite from a local copy.
+struct SymbolTable {
+    std::unordered_map<std::string, std::string> identifiers;
+    std::unordered_map<std::string, std::string> classes;
+    NameGenerator names{};  // keyed from the encryption key
+    std::mutex mutex;
+    
+    // Set once every class of a project has been declared up front
+    bool classesDeclared = false;
+    
+    // Ordered mode: files take turns, in a fixed order, to draw new names
+    // so the generator hands out the same names on every run
+    bool ordered = false;
+    size_t nextTurn = 0;
+    std::condition_variable turnChanged;
+    
+    void waitTurn(std::unique_lock<std::mutex>& lock, size_t turn) {
+        turnChanged.wait(lock, [&] { return !ordered || nextTurn >= turn; });
+    }
+    
+    // Pass the turn on, once per file; later calls for that file are no-ops
+    void endTurn(size_t turn) {
+        if (ordered && nextTurn == turn) {
+            ++nextTurn;
+            turnChanged.notify_all();
+        }
+    }
+    
+    // For files that draw no names in this phase
+    void skipTurn(size_t turn) {
+        if (!ordered) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        waitTurn(lock, turn);
+        endTurn(turn);
+    }
+};
+
+// What the cache keeps per file: the obfuscated output plus the identifier
+// and class renames that file used
+struct CacheEntry {
+    std::string output;
+    std::vector<std::pair<std::string, std::string>> identifiers;
+    std::vector<std::pair<std::string, std::string>> classes;
+};
+
+// On-disk cache of processed files keyed by a SHA-256 of the source, the
+// options and the encryption key. DIR/<key>.out holds the output and
+// DIR/<key>.map the renames, one "I|C original renamed" line each.
+class ObfuscationCache {
+private:
+    std::filesystem::path directory;
+    
+public:
+    explicit ObfuscationCache(std::filesystem::path dir) : directory(std::move(dir)) {
+        std::error_code ignored;
+        std::filesystem::create_directories(directory, ignored);
+    }
+    
+    static std::string key(const std::string& source, const std::map<std::string, std::string>& options) {
+        std::string material = "cpp-cache-1\n";
+        for (const auto& option : options) {
+            material += option.first + '=' + option.second + '\n';
+        }
+        material += '\0';
+        material += source;
+        
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int digestLength = 0;
+        if (EVP_Digest(material.data(), material.size(), digest, &digestLength, EVP_sha256(), nullptr) != 1) {
+            return std::string();
+        }
+        
+        static const char hex[] = "0123456789abcdef";
+        std::string result;
+        for (unsigned int i = 0; i < digestLength; ++i) {
+            result += hex[digest[i] >> 4];
+            result += hex[digest[i] & 15];
+        }
+        return result;
+    }
+    
+    bool load(const std::string& key, CacheEntry& entry) const {
+        std::ifstream output(directory / (key + ".out"), std::ios::binary);
+        std::ifstream map(directory / (key + ".map"));
+        if (key.empty() || !output.is_open() || !map.is_open()) {
+            return false;
+        }
+        
+        std::stringstream buffer;
+        buffer << output.rdbuf();
+        entry.output = buffer.str();
+        
+        std::string kind, original, renamed;
+        while (map >> kind >> original >> renamed) {
+            (kind == "C" ? entry.classes : entry.identifiers).emplace_back(original, renamed);
+        }
+        return map.eof();
+    }
+    
+    // Entries are written under a temporary name and renamed into place so
+    // concurrent runs never see a partial file. The map goes last; load()
+    // needs both.
+    bool store(const std::string& key, const CacheEntry& entry) const {
+        if (key.empty()) {
+            return false;
+        }
+        
+        std::ostringstream suffix;
+        suffix << ".tmp" << std::this_thread::get_id();
+        std::string map;
+        for (const auto& rename : entry.identifiers) {
+            map += "I " + rename.first + ' ' + rename.second + '\n';
+        }
+        for (const auto& rename : entry.classes) {
+            map += "C " + rename.first + ' ' + rename.second + '\n';
+        }
+        return write(key + ".out", suffix.str(), entry.output) && write(key + ".map", suffix.str(), map);
+    }
+    
+private:
+    bool write(const std::string& name, const std::string& suffix, const std::string& content) const {
+        std::filesystem::path target = directory / name;
+        std::filesystem::path temporary = directory / (name + suffix);
+        {
+            std::ofstream out(temporary, std::ios::binary);
+            out << content;
+            if (!out) {
+                return false;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, target, error);
+        return !error;
+    }
+};
+
+// Add a cached file's renames to the table unless one of them contradicts a
+// rename that is already there
+bool mergeCachedSymbols(SymbolTable& symbols, const CacheEntry& entry) {
+    std::lock_guard<std::mutex> lock(symbols.mutex);
+    for (const auto& rename : entry.identifiers) {
+        auto it = symbols.identifiers.find(rename.first);
+        if (it != symbols.identifiers.end() && it->second != rename.second) {
+            return false;
+        }
+    }
+    for (const auto& rename : entry.classes) {
+        auto it = symbols.classes.find(rename.first);
+        if (it != symbols.classes.end() && it->second != rename.second) {
+            return false;
+        }
+    }
+    symbols.identifiers.insert(entry.identifiers.begin(), entry.identifiers.end());
+    symbols.classes.insert(entry.classes.begin(), entry.classes.end());
+    
+    // Cached names came from the same key; keep the generator past them
+    for (const auto& rename : entry.identifiers) {
+        nameGeneratorReserve(&symbols.names, rename.second.data(), rename.second.size());
+    }
+    for (const auto& rename : entry.classes) {
+        if (rename.second.rfind("_C", 0) == 0) {
+            nameGeneratorReserve(&symbols.names, rename.second.data() + 2, rename.second.size() - 2);
+        }
+    }
+    return true;
+}
+
+void runWorkStealing(size_t taskCount, size_t workerCount, const std::function<void(size_t, size_t)>& run,
+                     bool inOrder = false);
+
+// Key for strings and names when the options give none
+constexpr const char* kDefaultEncryptionKey = "default_encryption_key_32_chars_";
+
+// The key in `options`, or the default
+static std::string encryptionKeyOption(const std::map<std::string, std::string>& options) {
+    auto key = options.find("encryptionKey");
+    return key != options.end() ? key->second : kDefaultEncryptionKey;
+}
+
+class CppProcessor {
+private:
+    std::map<std::string, std::string> options;
+    std::shared_ptr<SymbolTable> symbols;
+    std::map<std::string, std::string> stringMap;
+    std::unordered_map<std::string, std::string> usedIdentifiers;  // renames used by the last file
+    std::unordered_map<std::string, std::string> usedClasses;
+    std::unique_ptr<StringCipher> cipher;
+    EncryptionStats encryptionStats;
+    std::unique_ptr<ProcessStats> stats;  // null unless --stats
+    std::mt19937 rng;
+    unsigned passes = PassAll;
+    size_t literalJobs = 1;  // threads of the string pass
+    size_t turn = 0;  // this file's turn in an ordered SymbolTable
+    std::shared_ptr<const ObfuscationProfile> profile;
+    std::vector<ProtectionLevel> protection;  // per token; empty without a profile
+    std::unique_ptr<const NameSet> preserved;  // null unless --preserve
+
+public:
+    CppProcessor(const std::map<std::string, std::string>& opts = {},
+                 std::shared_ptr<SymbolTable> sharedSymbols = nullptr)
+        : options(opts),
+          symbols(sharedSymbols ? sharedSymbols : std::make_shared<SymbolTable>()),
+          rng(std::chrono::steady_clock::now().time_since_epoch().count()) {
+        if (options.find("encryptionKey") == options.end()) {
+            options["encryptionKey"] = kDefaultEncryptionKey;
+        }
+        if (options.find("stringMode") == options.end()) {
+            options["stringMode"] = "static";
+        }
+        if (options.count("passes") && !parsePassList(options["passes"], passes)) {
+            passes = PassAll;
+        }
+        if (options.count("preserve")) {
+            preserved.reset(new NameSet(options["preserve"]));
+        }
+        if (!sharedSymbols) {  // a shared table is keyed once by its owner
+            const std::string& key = options["encryptionKey"];
+            nameGeneratorInit(&symbols->names, key.data(), key.size());
+        }
+    }
+    
+    StringCipher& cipherFor(const std::string& key) {
+        if (!cipher || cipher->getKey() != key) {
+            cipher.reset(new StringCipher(key));
+        }
+        return *cipher;
+    }
+    
+    const EncryptionStats& getEncryptionStats() const {
+        return encryptionStats;
+    }
+    
+    void enableStats() {
+        if (!stats) {
+            stats.reset(new ProcessStats());
+        }
+    }
+    
+    // Per-pass statistics of every file processed so far; null unless
+    // enableStats() was called
+    const ProcessStats* getStats() {
+        if (stats) {
+            stats->encryption = encryptionStats;
+        }
+        return stats.get();
+    }
+    
+    // Run one pass over the IR, timing it when stats are enabled
+    template <typename Pass>
+    void runPass(const char* name, SourceIR& ir, Pass pass) {
+        if (!stats) {
+            pass(ir);
+            return;
+        }
+        size_t bytesIn = ir.serializedLength();
+        PassProbe probe = PassProbe::start();
+        pass(ir);
+        probe.finish(stats->pass(name), bytesIn, ir.serializedLength());
+    }
+    
+    // Encrypt the literals of large files on up to `jobs` threads; the output
+    // does not depend on the count
+    void setLiteralJobs(size_t jobs) {
+        literalJobs = std::max<size_t>(1, jobs);
+    }
+    
+    // Protect hot functions according to a CPU profile
+    void setProfile(std::shared_ptr<const ObfuscationProfile> value) {
+        profile = std::move(value);
+    }
+    
+    ProtectionLevel protectionAt(size_t index) const {
+        return index < protection.size() ? protection[index] : ProtectionLevel::Full;
+    }
+    
+    // Name of the function whose body opens at `brace`, or empty when the
+    // brace opens anything else. Skips trailing qualifiers and constructor
+    // initializer lists back to the parameter list.
+    static std::string_view functionName(const SourceIR& ir, size_t brace) {
+        static const std::set<std::string_view> qualifiers = {
+            "const", "volatile", "noexcept", "override", "final", "mutable", "&"
+        };
+        static const std::set<std::string_view> statements = {
+            "if", "for", "while", "switch", "catch", "return", "sizeof", "decltype", "alignof", "noexcept"
+        };
+        
+        size_t close = ir.prev(brace);
+        while (close != std::string::npos && qualifiers.count(ir.original(close))) {
+            close = ir.prev(close);
+        }
+        while (ir.is(close, ")")) {
+            size_t open = close;
+            for (int depth = 0; open != std::string::npos; open = ir.prev(open)) {
+                depth += ir.is(open, ")") - ir.is(open, "(");
+                if (depth == 0) {
+                    break;
+                }
+            }
+            size_t name = ir.prev(open);
+            if (name == std::string::npos || ir[name].kind != TokenKind::Identifier || statements.count(ir.original(name))) {
+                return std::string_view();
+            }
+            
+            size_t before = ir.prev(name);
+            if (ir.is(before, ",") || (ir.is(before, ":") && !ir.is(ir.prev(before), ":"))) {
+                close = ir.prev(before);  // an initializer list entry
+                continue;
+            }
+            return ir.original(name);
+        }
+        return std::string_view();
+    }
+    
+    // Give every token the protection level of the innermost function body
+    // around it; tokens outside any function are fully protected
+    void assignProtection(const SourceIR& ir) {
+        protection.clear();
+        if (!profile) {
+            return;
+        }
+        
+        protection.resize(ir.size(), ProtectionLevel::Full);
+        std::vector<ProtectionLevel> enclosing;
+        ProtectionLevel current = ProtectionLevel::Full;
+        for (size_t i = 0; i < ir.size(); ++i) {
+            if (ir[i].kind == TokenKind::Punctuation && !ir[i].inDirective) {
+                if (ir.is(i, "{")) {
+                    enclosing.push_back(current);
+                    std::string_view name = functionName(ir, i);
+                    current = name.empty() ? current : profile->levelFor(name);
+                } else if (ir.is(i, "}") && !enclosing.empty()) {
+                    protection[i] = current;
+                    current = enclosing.back();
+                    enclosing.pop_back();
+                    continue;
+                }
+            }
+            protection[i] = current;
+        }
+    }
+    
+    // Deterministic mode derives all randomness from the key: the rng seed
+    // and the IVs come from HMAC over per-file labels, so identical inputs
+    // give byte-identical output
+    bool isDeterministic() {
+        return options["deterministic"] == "1";
+    }
+    
+    void setTurn(size_t value) {
+        turn = value;
+    }
+    
+    // Callers hold symbols->mutex
+    std::string generateObfuscatedName() {
+        char name[NAME_GENERATOR_BUFFER_SIZE];
+        size_t length = nameGeneratorNext(&symbols->names, name);
+        return std::string(name, length);
+    }
+    
+    bool isReservedIdentifier(std::string_view identifier) const {
+        return preserved ? preserved->contains(identifier) : kReservedNames.contains(identifier);
+    }
+    
+    // Bytes of a literal body with its escape sequences resolved. Fails on
+    // universal character names, whose bytes depend on the execution
+    // character set, and on escapes that do not fit a byte.
+    static bool unescapeLiteral(std::string_view body, std::string& out) {
+        out.clear();
+        for (size_t i = 0; i < body.length(); ++i) {
+            if (body[i] != '\\') {
+                out += body[i];
+                continue;
+            }
+            if (++i == body.length()) {
+                return false;
+            }
+            unsigned value = 0;
+            switch (body[i]) {
+            case 'n': out += '\n'; break;
+            case 't': out += '\t'; break;
+            case 'r': out += '\r'; break;
+            case 'a': out += '\a'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'v': out += '\v'; break;
+            case 'u':
+            case 'U':
+                return false;
+            case '\r':
+                i += i + 1 < body.length() && body[i + 1] == '\n';
+                break;  // line continuation
+            case '\n':
+                break;
+            case 'x':
+                if (i + 1 == body.length() || !std::isxdigit(static_cast<unsigned char>(body[i + 1]))) {
+                    return false;
+                }
+                while (i + 1 < body.length() && std::isxdigit(static_cast<unsigned char>(body[i + 1]))) {
+                    char digit = body[++i];
+                    value = value * 16 + (std::isdigit(static_cast<unsigned char>(digit)) ? digit - '0' : (digit | 0x20) - 'a' + 10);
+                    if (value > 0xFF) {
+                        return false;
+                    }
+                }
+                out += static_cast<char>(value);
+                break;
+            case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7':
+                value = body[i] - '0';
+                for (int digits = 1; digits < 3 && i + 1 < body.length() && body[i + 1] >= '0' && body[i + 1] <= '7'; ++digits) {
+                    value = value * 8 + (body[++i] - '0');
+                }
+                if (value > 0xFF) {
+                    return false;
+                }
+                out += static_cast<char>(value);
+                break;
+            default:
+                out += body[i];  // \\ \" \' \?
+                break;
+            }
+        }
+        return true;
+    }
+    
+    // Append `bytes` as three-digit octal escapes, which can never run into
+    // the character after them. `position` is the index of the first byte
+    // in the whole literal; every 20 bytes the literal continues on a new line.
+    static void appendOctalBytes(std::string& out, std::string_view bytes, size_t position) {
+        size_t start = out.length();
+        out.resize(start + bytes.length() * 4 + (bytes.length() / 20 + 1) * 7);
+        char* dst = &out[start];
+        for (size_t i = 0; i < bytes.length(); ++i) {
+            if ((position + i) % 20 == 0 && position + i > 0) {
+                memcpy(dst, "\"\n    \"", 7);
+                dst += 7;
+            }
+            unsigned char byte = static_cast<unsigned char>(bytes[i]);
+            dst[0] = '\\';
+            dst[1] = static_cast<char>('0' + (byte >> 6));
+            dst[2] = static_cast<char>('0' + ((byte >> 3) & 7));
+            dst[3] = static_cast<char>('0' + (byte & 7));
+            dst += 4;
+        }
+        out.resize(dst - out.data());
+    }
+    
+    static void appendByteLiteral(std::string& out, std::string_view bytes) {
+        out += "    \"";
+        appendOctalBytes(out, bytes, 0);
+        out += "\";\n";
+    }
+    
+    // Slots per unit of work in the string pass
+    static constexpr size_t LITERAL_CHUNK_SIZE = 4096;
+    
+    // Only plain narrow literals in ordinary code can become std::string
+    // variables. Prefixed or suffixed literals, directive operands, linkage
+    // specifications and adjacent literals that concatenate are left alone.
+    static bool isEncryptableString(const SourceIR& ir, size_t index) {
+        const Token& token = ir[index];
+        if (token.kind != TokenKind::String || token.inDirective) {
+            return false;
+        }
+        
+        std::string_view literal = ir.original(index);
+        if (literal.length() < 2 || literal.front() != '"' || literal.back() != '"') {
+            return false;
+        }
+        
+        size_t prev = ir.prev(index);
+        size_t next = ir.next(index);
+        auto isLiteral = [&ir](size_t i) {
+            return i != std::string::npos && (ir[i].kind == TokenKind::String || ir[i].kind == TokenKind::RawString);
+        };
+        return !isLiteral(prev) && !isLiteral(next) && !ir.is(prev, "extern") && !ir.is(prev, "operator");
+    }
+    
+    // Encryptable literals of the file, each identical literal once. Every
+    // token maps to the slot of its text; slots are in order of first use.
+    struct InternedLiterals {
+        std::vector<size_t> tokens;
+        std::vector<size_t> slotOfToken;
+        std::vector<std::string_view> slots;  // with quotes
+    };
+    
+    static InternedLiterals internLiterals(const SourceIR& ir) {
+        InternedLiterals literals;
+        std::unordered_map<std::string_view, size_t> slotOf;
+        for (size_t i = 0; i < ir.size(); ++i) {
+            if (!isEncryptableString(ir, i)) {
+                continue;
+            }
+            std::string_view literal = ir.original(i);
+            auto slot = slotOf.emplace(literal, literals.slots.size());
+            if (slot.second) {
+                literals.slots.push_back(literal);
+            }
+            literals.tokens.push_back(i);
+            literals.slotOfToken.push_back(slot.first->second);
+        }
+        return literals;
+    }
+    
+    // Emit literals as compile-time encrypted constants. Encryption runs in
+    // constexpr constructors and decryption is a short inlined xorshift
+    // keystream into a function-local static, so the output needs neither
+    // OpenSSL nor the heap. Requires C++14.
+    void encryptStringsConstexpr(SourceIR& ir) {
+        InternedLiterals literals = internLiterals(ir);
+        
+        // One accessor per distinct literal, so its copies share one static
+        std::string accessors;
+        for (size_t slot = 0; slot < literals.slots.size(); ++slot) {
+            // xorshift32 needs a non-zero state
+            std::uint32_t seed = static_cast<std::uint32_t>(rng()) | 1u;
+            char seedText[16];
+            std::snprintf(seedText, sizeof(seedText), "0x%08xu", seed);
+            accessors += "static const char* _qs_str_" + std::to_string(slot) + "() { return _QS_STR(" +
+                         seedText + ", " + std::string(literals.slots[slot]) + "); }\n";
+        }
+        for (size_t n = 0; n < literals.tokens.size(); ++n) {
+            ir.replace(literals.tokens[n], "_qs_str_" + std::to_string(literals.slotOfToken[n]) + "()");
+        }
+        
+        std::string constexprRuntime = R"(
+// Compile-time string encryption
+#include <cstddef>
+#include <cstdint>
+
+namespace _qs {
+constexpr std::uint32_t next(std::uint32_t state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+template <std::size_t N>
+struct literal {
+    char data[N];
+    
+    constexpr literal(const char (&plain)[N], std::uint32_t state) : data{} {
+        for (std::size_t i = 0; i < N; ++i) {
+            state = next(state);
+            data[i] = static_cast<char>(plain[i] ^ static_cast<char>(state));
+        }
+    }
+};
+
+template <std::size_t N>
+struct buffer {
+    char data[N];
+};
+
+template <std::size_t N>
+inline buffer<N> decrypt(const literal<N>& encrypted, std::uint32_t seed) {
+    // Read the seed through volatile so the plaintext is never folded
+    // back into the binary at compile time
+    volatile std::uint32_t guard = seed;
+    std::uint32_t state = guard;
+    buffer<N> plain{};
+    for (std::size_t i = 0; i < N; ++i) {
+        state = next(state);
+        plain.data[i] = static_cast<char>(encrypted.data[i] ^ static_cast<char>(state));
+    }
+    return plain;
+}
+}
+
+#define _QS_STR(seed, text) ([]() -> const char* { \
+    static constexpr ::_qs::literal<sizeof(text)> encrypted(text, seed); \
+    static const ::_qs::buffer<sizeof(text)> plain = ::_qs::decrypt(encrypted, seed); \
+    return plain.data; }())
+
+)";
+        
+        ir.prepend(constexprRuntime + accessors);
+    }
+    
+    void encryptStrings(SourceIR& ir, const std::string& key) {
+        if (options["stringMode"] == "constexpr") {
+            encryptStringsConstexpr(ir);
+            return;
+        }
+        
+        const bool lazy = options["stringMode"] == "lazy";
+        
+        // Identical literals share one slot. The slots' bytes are packed into
+        // one segment; the table holds each one's offset and length.
+        InternedLiterals literals = internLiterals(ir);
+        if (literals.slots.empty()) {
+            return;
+        }
+        
+        // The slots are processed in chunks, on several threads when there is
+        // more than one. Chunks are unescaped first; once their sizes give
+        // each one its offset and first string index, each encrypts and
+        // formats its part. Only the split depends on the thread count, so
+        // the output is the same as with one thread.
+        struct LiteralChunk {
+            size_t firstSlot = 0;
+            size_t endSlot = 0;
+            std::string packed;          // unescaped bytes of its strings
+            std::vector<size_t> lengths; // per slot; npos where not encryptable
+            size_t offset = 0;           // of `packed` in the segment
+            size_t firstString = 0;
+            size_t strings = 0;
+            std::string segment;         // `packed` encrypted, as octal escapes
+            std::string table;
+            std::string declarations;
+            double seconds = 0;          // spent encrypting
+            bool ok = true;
+        };
+        std::vector<LiteralChunk> chunks((literals.slots.size() + LITERAL_CHUNK_SIZE - 1) / LITERAL_CHUNK_SIZE);
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            chunks[c].firstSlot = c * LITERAL_CHUNK_SIZE;
+            chunks[c].endSlot = std::min(literals.slots.size(), (c + 1) * LITERAL_CHUNK_SIZE);
+        }
+        runWorkStealing(chunks.size(), literalJobs, [&](size_t c, size_t) {
+            LiteralChunk& chunk = chunks[c];
+            std::string bytes;
+            for (size_t slot = chunk.firstSlot; slot < chunk.endSlot; ++slot) {
+                std::string_view literal = literals.slots[slot];
+                if (unescapeLiteral(literal.substr(1, literal.length() - 2), bytes)) {
+                    chunk.lengths.push_back(bytes.length());
+                    chunk.packed += bytes;
+                    ++chunk.strings;
+                } else {
+                    chunk.lengths.push_back(std::string::npos);
+                }
+            }
+        });
+        
+        size_t segmentLength = 0;
+        size_t strings = 0;
+        for (LiteralChunk& chunk : chunks) {
+            chunk.offset = segmentLength;
+            chunk.firstString = strings;
+            segmentLength += chunk.packed.length();
+            strings += chunk.strings;
+        }
+        unsigned char nonce[AES_BLOCK_SIZE];
+        StringCipher& cipher = cipherFor(key);
+        if (strings == 0 || !cipher.nextNonce(nonce)) {
+            return;
+        }
+        
+        std::vector<std::string> references(literals.slots.size());
+        runWorkStealing(chunks.size(), literalJobs, [&](size_t c, size_t) {
+            LiteralChunk& chunk = chunks[c];
+            auto start = std::chrono::steady_clock::now();
+            std::string ciphertext;
+            chunk.ok = cipher.encryptPart(chunk.packed, chunk.offset, nonce, ciphertext);
+            chunk.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            appendOctalBytes(chunk.segment, ciphertext, chunk.offset);
+            
+            size_t offset = chunk.offset;
+            size_t index = chunk.firstString;
+            for (size_t slot = chunk.firstSlot; slot < chunk.endSlot; ++slot) {
+                size_t length = chunk.lengths[slot - chunk.firstSlot];
+                if (length == std::string::npos) {
+                    continue;
+                }
+                chunk.table += (index % 8 ? " {" : "\n    {") + std::to_string(offset) + ", " +
+                               std::to_string(length) + "},";
+                offset += length;
+                
+                std::string varName = "_str_" + std::to_string(index);
+                std::string decryptCall = "_decrypt_str(" + std::to_string(index) + ")";
+                ++index;
+                if (lazy) {
+                    // Decrypted on first use behind the function-local static guard
+                    chunk.declarations += "static const std::string& " + varName + "() {\n"
+                                          "    static const std::string value = " + decryptCall + ";\n"
+                                          "    return value;\n"
+                                          "}\n";
+                    references[slot] = varName + "()";
+                } else {
+                    chunk.declarations += "static std::string " + varName + " = " + decryptCall + ";\n";
+                    references[slot] = varName;
+                }
+            }
+        });
+        for (const LiteralChunk& chunk : chunks) {
+            if (!chunk.ok) {
+                return;
+            }
+            encryptionStats.seconds += chunk.seconds;
+        }
+        encryptionStats.literals += strings;
+        encryptionStats.bytes += segmentLength;
+        
+        // Splice the references in place of the literals
+        for (size_t n = 0; n < literals.tokens.size(); ++n) {
+            const std::string& reference = references[literals.slotOfToken[n]];
+            if (!reference.empty()) {
+                ir.replace(literals.tokens[n], reference);
+            }
+        }
+        
+        // Add decryption function
+        std::string decryptFunction = R"(
+// String decryption: AES-256-CTR from the string's own counter block
+static std::string _decrypt_str(std::uint32_t index) {
+    std::uint32_t offset = _qs_table[index][0];
+    std::uint32_t length = _qs_table[index][1];
+    std::uint32_t skip = offset % 16;
+    
+    // Counter block of the string's first byte: the nonce plus its block
+    // index, as a 128-bit big-endian number
+    unsigned char counter[16];
+    unsigned int carry = 0;
+    std::uint32_t block = offset / 16;
+    for (int i = 15; i >= 0; --i) {
+        carry += _qs_nonce[i] + (block & 0xFF);
+        counter[i] = static_cast<unsigned char>(carry);
+        carry >>= 8;
+        block >>= 8;
+    }
+    
+    std::string plain(skip + length, '\0');
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    int written = 0;
+    bool ok = ctx && EVP_DecryptInit_ex(ctx, EVP_aes_256_ctr(), NULL, _qs_key, counter) == 1 &&
+              (plain.empty() || EVP_DecryptUpdate(ctx, reinterpret_cast<unsigned char*>(&plain[0]), &written,
+                                                  _qs_segment + offset - skip, static_cast<int>(skip + length)) == 1);
+    EVP_CIPHER_CTX_free(ctx);
+    return ok ? plain.substr(skip) : std::string();
+}
+
+)";
+        
+        // The segment and its table are plain data: no pointers, so no
+        // relocations, and no base64 to decode at run time. The chunks'
+        // pieces go into the prologue as they are, last first.
+        for (size_t c = chunks.size(); c-- > 0;) {
+            ir.prepend(std::move(chunks[c].declarations));
+        }
+        ir.prepend(std::move(decryptFunction));
+        ir.prepend("\";\n");
+        for (size_t c = chunks.size(); c-- > 0;) {
+            ir.prepend(std::move(chunks[c].segment));
+        }
+        ir.prepend("\n};\nstatic const unsigned char _qs_segment[] =\n    \"");
+        for (size_t c = chunks.size(); c-- > 0;) {
+            ir.prepend(std::move(chunks[c].table));
+        }
+        
+        std::string head = "\n// Encrypted strings\n"
+                           "#include <cstdint>\n"
+                           "#include <cstring>\n"
+                           "#include <string>\n"
+                           "#include <openssl/evp.h>\n\n"
+                           "static const unsigned char _qs_key[] =\n";
+        appendByteLiteral(head, cipher.getPaddedKey());
+        head += "static const unsigned char _qs_nonce[] =\n";
+        appendByteLiteral(head, std::string_view(reinterpret_cast<const char*>(nonce), sizeof(nonce)));
+        head += "static const std::uint32_t _qs_table[][2] = {";
+        ir.prepend(std::move(head));
+    }
+    
+    std::string encryptStrings(const std::string& code, const std::string& key) {
+        SourceIR ir(code);
+        encryptStrings(ir, key);
+        return ir.serialize();
+    }
+    
+    void obfuscateIdentifiers(SourceIR& ir) {
+        std::vector<std::string> fileIdentifiers;
+        std::string identifier;
+        
+        // Collect identifiers; `defined` in #if lines is an operator
+        for (size_t i = 0; i < ir.size(); ++i) {
+            if (ir[i].kind != TokenKind::Identifier || (ir[i].inDirective && ir.is(i, "defined"))) {
+                continue;
+            }
+            identifier.assign(ir.text(i));
+            if (identifier.length() > 1 && !isReservedIdentifier(identifier)) {
+                fileIdentifiers.push_back(identifier);
+            }
+        }
+        
+        // Generate obfuscated names in sorted order so the mapping matches
+        // the order names were always drawn from rng
+        std::sort(fileIdentifiers.begin(), fileIdentifiers.end());
+        fileIdentifiers.erase(std::unique(fileIdentifiers.begin(), fileIdentifiers.end()), fileIdentifiers.end());
+        
+        std::unordered_map<std::string, std::string> renames;
+        renames.reserve(fileIdentifiers.size());
+        {
+            std::unique_lock<std::mutex> lock(symbols->mutex);
+            symbols->waitTurn(lock, turn);
+            for (const auto& name : fileIdentifiers) {
+                auto it = symbols->identifiers.find(name);
+                if (it == symbols->identifiers.end()) {
+                    it = symbols->identifiers.emplace(name, generateObfuscatedName()).first;
+                }
+                renames.emplace(name, it->second);
+            }
+            symbols->endTurn(turn);
+        }
+        
+        // Rename with one map lookup per identifier token
+        for (size_t i = 0; i < ir.size(); ++i) {
+            if (ir[i].kind != TokenKind::Identifier || (ir[i].inDirective && ir.is(i, "defined"))) {
+                continue;
+            }
+            identifier.assign(ir.text(i));
+            auto it = renames.find(identifier);
+            if (it != renames.end()) {
+                ir.replace(i, it->second);
+            }
+        }
+        usedIdentifiers = std::move(renames);
+    }
+    
+    std::string obfuscateIdentifiers(const std::string& code) {
+        SourceIR ir(code);
+        obfuscateIdentifiers(ir);
+        return ir.serialize();
+    }
+    
+    // Not synchronized; only read it while no pass is running
+    const std::unordered_map<std::string, std::string>& getIdentifierMap() const {
+        return symbols->identifiers;
+    }
+    
+    // The slice of the symbol table used by the last processed file
+    void exportSymbols(CacheEntry& entry) const {
+        entry.identifiers.assign(usedIdentifiers.begin(), usedIdentifiers.end());
+        entry.classes.assign(usedClasses.begin(), usedClasses.end());
+    }
+    
+    // Jumps in a block that a new switch around it would capture
+    enum BlockJumps : std::uint8_t {
+        JumpBreak = 1,  // break
+        JumpLabel = 2   // case or default label
+    };
+    
+    // For every '{', the jumps its block contains that bind to something
+    // outside it. A loop body keeps its breaks, a switch body keeps its
+    // breaks and labels; any other block passes them to its parent.
+    static std::vector<std::uint8_t> blockJumps(const SourceIR& ir, const std::vector<size_t>& match) {
+        std::vector<std::uint8_t> jumps(ir.size(), 0);
+        std::vector<size_t> blocks;
+        for (size_t i = 0; i < ir.size(); ++i) {
+            if (ir[i].inDirective || (ir[i].kind != TokenKind::Identifier && ir[i].kind != TokenKind::Punctuation)) {
+                continue;
+            }
+            if (ir.is(i, "{")) {
+                blocks.push_back(i);
+            } else if (ir.is(i, "}") && !blocks.empty() && match[i] == blocks.back()) {
+                size_t open = blocks.back();
+                blocks.pop_back();
+                
+                size_t head = ir.prev(open);
+                std::uint8_t kept = ir.is(head, "do") ? JumpBreak : 0;
+                if (ir.is(head, ")") && match[head] != std::string::npos) {
+                    size_t keyword = ir.prev(match[head]);
+                    kept = ir.is(keyword, "switch") ? JumpBreak | JumpLabel
+                         : ir.is(keyword, "for") || ir.is(keyword, "while") ? JumpBreak : 0;
+                }
+                if (!blocks.empty()) {
+                    jumps[blocks.back()] |= jumps[open] & ~kept;
+                }
+            } else if (!blocks.empty() && ir[i].kind == TokenKind::Identifier) {
+                if (ir.is(i, "break")) {
+                    jumps[blocks.back()] |= JumpBreak;
+                } else if (ir.is(i, "case") || (ir.is(i, "default") && ir.is(ir.next(i), ":"))) {
+                    jumps[blocks.back()] |= JumpLabel;
+                }
+            }
+        }
+        return jumps;
+    }
+    
+    // A condition that can be evaluated as `(condition) ? 1 : 0`: no C++17
+    // init-statement and no declaration or assignment at its top level
+    static bool isPlainCondition(const SourceIR& ir, const std::vector<size_t>& match, size_t open, size_t close) {
+        for (size_t i = ir.next(open); i != std::string::npos && i < close; i = ir.next(i)) {
+            if (match[i] != std::string::npos && match[i] > i) {
+                i = match[i];
+            } else if (ir.is(i, ";")) {
+                return false;
+            } else if (ir.is(i, "=") && !ir.is(ir.next(i), "=")) {
+                std::string_view before = ir.original(ir.prev(i));
+                if (before.length() != 1 || !strchr("=!<>+-*/%&|^", before[0])) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+    
+    void addControlFlowObfuscation(SourceIR& ir) {
+        // Convert if / else if / else chains into nested switches:
+        //
+        //   { int _swN = (cond) ? 1 : 0;
+        //   switch (_swN) {
+        //       case 1: { then } break;
+        //       default: { else, or the next link of the chain } }
+        //   }
+        //
+        // Brackets are matched once up front, so every step is O(1) and
+        // nested blocks are handled by visiting the ifs inside them in turn.
+        // Only ifs that start a statement are rewritten, all bodies must be
+        // braced, and a body must not contain a break or case label that a
+        // new switch would capture. A chain is rewritten whole or not at all.
+        std::vector<size_t> match = ir.matchBrackets();
+        std::vector<std::uint8_t> jumps = blockJumps(ir, match);
+        std::vector<size_t> chain;  // if tokens
+        
+        for (size_t i = 0; i < ir.size(); ++i) {
+            if (ir[i].kind != TokenKind::Identifier || ir[i].inDirective || !ir.is(i, "if") ||
+                protectionAt(i) == ProtectionLevel::None) {
+                continue;
+            }
+            size_t before = ir.prev(i);
+            if (before != std::string::npos && !ir.is(before, ";") && !ir.is(before, "{") && !ir.is(before, "}")) {
+                continue;
+            }
+            
+            // Walk the chain; `last` ends up on the '}' closing it
+            chain.clear();
+            size_t last = std::string::npos;
+            size_t elseToken = std::string::npos;
+            for (size_t link = i; ; ) {
+                size_t open = ir.next(link);
+                size_t close = ir.is(open, "(") ? match[open] : std::string::npos;
+                size_t body = ir.next(close);
+                if (close == std::string::npos || close == ir.next(open) || !ir.is(body, "{") ||
+                    match[body] == std::string::npos || jumps[body] != 0 || !isPlainCondition(ir, match, open, close)) {
+                    last = std::string::npos;
+                    break;
+                }
+                chain.push_back(link);
+                last = match[body];
+                
+                elseToken = ir.next(last);
+                if (!ir.is(elseToken, "else")) {
+                    elseToken = std::string::npos;
+                    break;
+                }
+                size_t next = ir.next(elseToken);
+                if (ir.is(next, "if")) {
+                    link = next;
+                    continue;
+                }
+                if (!ir.is(next, "{") || match[next] == std::string::npos || jumps[next] != 0) {
+                    last = std::string::npos;
+                } else {
+                    last = match[next];
+                }
+                break;
+            }
+            if (last == std::string::npos) {
+                continue;
+            }
+            
+            for (size_t link : chain) {
+                std::string switchVar = "_sw" + std::to_string(rng() % 10000);
+                size_t close = match[ir.next(link)];
+                ir.replace(link, "{ int " + switchVar + " =");
+                ir.replace(close, ") ? 1 : 0;\nswitch (" + switchVar + ") {\n    case 1:\n        ");
+                size_t linkEnd = match[ir.next(close)];
+                if (linkEnd != last) {
+                    ir.replace(linkEnd, "}\n        break;\n    default:\n        ");
+                    ir.replace(ir.next(linkEnd), "");  // else
+                }
+            }
+            
+            std::string closing(ir.original(last));
+            closing += "\n        break;\n";
+            for (size_t n = 0; n < chain.size(); ++n) {
+                closing += "} }\n";
+            }
+            closing.pop_back();
+            ir.replace(last, std::move(closing));
+        }
+    }
+    
+    std::string addControlFlowObfuscation(const std::string& code) {
+        SourceIR ir(code);
+        addControlFlowObfuscation(ir);
+        return ir.serialize();
+    }
+    
+    void addDeadCode(SourceIR& ir) {
+        std::vector<std::string> deadCodeSnippets = {
+            "volatile int _dummy1 = std::rand() % 100;\n",
+            "volatile auto _dummy2 = std::chrono::steady_clock::now().time_since_epoch().count() & 0xFF;\n",
+            "{ volatile int _dummy3 = std::rand() % 100; if (_dummy3 > 200) { std::cout << \"Never executed\"; } }\n",
+            "{ volatile int _dummy4 = 0; for (int _i = 0; _i < 0; ++_i) { _dummy4++; } }\n",
+            "std::vector<int> _dummy_vec; _dummy_vec.reserve(0);\n"
+        };
+        
+        // Insert dead code after the first function body openings that no
+        // earlier pass has rewritten, in functions the profile leaves fully
+        // protected. Class bodies, namespaces and brace initializers cannot
+        // hold statements.
+        int insertions = 0;
+        for (size_t i = 0; i < ir.size() && insertions < 3; ++i) {
+            if (ir[i].kind != TokenKind::Punctuation || ir[i].inDirective || !ir.is(i, "{") || ir.isEdited(i)) {
+                continue;
+            }
+            std::string_view function = functionName(ir, i);
+            if (function.empty() || (profile && profile->levelFor(function) != ProtectionLevel::Full)) {
+                continue;
+            }
+            ir.replace(i, "{" + deadCodeSnippets[rng() % deadCodeSnippets.size()]);
+            ++insertions;
+        }
+        if (insertions > 0) {
+            ir.prepend("#include <chrono>\n#include <cstdlib>\n#include <iostream>\n#include <vector>\n");
+        }
+    }
+    
+    std::string addDeadCode(const std::string& code) {
+        SourceIR ir(code);
+        addDeadCode(ir);
+        return ir.serialize();
+    }
+    
+    void addAntiDebugging(SourceIR& ir) {
+        if (options.count("antiDebug") && options["antiDebug"] == "monitor") {
+            addAntiDebugMonitor(ir);
+            return;
+        }
+        std::string antiDebugCode = R"(
+// Anti-debugging measures
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#include <debugapi.h>
+#else
+#include <sys/ptrace.h>
+#include <unistd.h>
+#endif
+
+class AntiDebug {
+public:
+    static void check() {
+#ifdef _WIN32
+        if (IsDebuggerPresent()) {
+            std::exit(1);
+        }
+        
+        BOOL debuggerPresent = FALSE;
+        CheckRemoteDebuggerPresent(GetCurrentProcess(), &debuggerPresent);
+        if (debuggerPresent) {
+            std::exit(1);
+        }
+#else
+        if (ptrace(PTRACE_TRACEME, 0, 1, 0) == -1) {
+            std::exit(1);
+        }
+#endif
+        
+        // Timing check
+        auto start = std::chrono::high_resolution_clock::now();
+        volatile int dummy = 0;
+        for (int i = 0; i < 1000; ++i) {
+            dummy += i;
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+        if (duration.count() > 10000) {
+            std::exit(1);
+        }
+    }
+};
+
+)";
+        
+        ir.prepend(antiDebugCode);
+        insertIntoMain(ir, "AntiDebug::check();");
+    }
+    
+    // Check for a debugger on a detached thread every antiDebugInterval
+    // milliseconds instead of once, blocking, at the top of main. On Linux a
+    // sample is one pread of /proc/self/status through a descriptor opened on
+    // the first sample, and a TracerPid lookup in it; main only pays for
+    // starting the thread.
+    void addAntiDebugMonitor(SourceIR& ir) {
+        long interval = options.count("antiDebugInterval") ? std::atol(options["antiDebugInterval"].c_str()) : 100;
+        std::string monitorCode = R"(
+// Anti-debugging monitor
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#include <debugapi.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+class AntiDebug {
+public:
+    static void start() {
+        std::thread(monitor).detach();
+    }
+
+private:
+    static void monitor() {
+#ifndef _WIN32
+        int status = open("/proc/self/status", O_RDONLY | O_CLOEXEC);
+        if (status < 0) {
+            return;
+        }
+#endif
+        for (;;) {
+#ifdef _WIN32
+            BOOL debuggerPresent = FALSE;
+            CheckRemoteDebuggerPresent(GetCurrentProcess(), &debuggerPresent);
+            if (IsDebuggerPresent() || debuggerPresent) {
+                std::_Exit(1);
+            }
+#else
+            if (traced(status)) {
+                std::_Exit(1);
+            }
+#endif
+            std::this_thread::sleep_for(std::chrono::milliseconds(INTERVAL));
+        }
+    }
+
+#ifndef _WIN32
+    static bool traced(int status) {
+        char buffer[4096];
+        ssize_t length = pread(status, buffer, sizeof(buffer) - 1, 0);
+        if (length <= 0) {
+            return false;
+        }
+        buffer[length] = '\0';
+        const char* field = std::strstr(buffer, "TracerPid:");
+        return field && std::strtol(field + 10, nullptr, 10) != 0;
+    }
+#endif
+};
+
+)";
+        monitorCode.replace(monitorCode.find("INTERVAL"), 8, std::to_string(std::max(1L, interval)));
+        ir.prepend(monitorCode);
+        insertIntoMain(ir, "AntiDebug::start();");
+    }
+    
+    // Insert `statement` at the beginning of main
+    void insertIntoMain(SourceIR& ir, const std::string& statement) {
+        for (size_t i = 0; i < ir.size(); ++i) {
+            if (ir[i].inDirective || !ir.is(i, "int")) {
+                continue;
+            }
+            size_t name = ir.next(i);
+            size_t open = ir.next(name);
+            if (!ir.is(name, "main") || !ir.is(open, "(")) {
+                continue;
+            }
+            size_t brace = ir.next(ir.find(open, ")"));
+            if (ir.is(brace, "{")) {
+                std::string body(ir.text(brace).substr(1));
+                ir.replace(brace, "{\n    " + statement + body);
+            }
+        }
+    }
+    
+    std::string addAntiDebugging(const std::string& code) {
+        SourceIR ir(code);
+        addAntiDebugging(ir);
+        return ir.serialize();
+    }
+    
+    // Register the classes declared in this file in the symbol table
+    void declareClasses(const SourceIR& ir) {
+        std::vector<std::string> declared;
+        for (size_t i = 0; i < ir.size(); ++i) {
+            if (ir[i].kind != TokenKind::Identifier || !ir.is(i, "class")) {
+                continue;
+            }
+            size_t name = ir.next(i);
+            if (name == std::string::npos || ir[name].kind != TokenKind::Identifier) {
+                continue;
+            }
+            std::string className(ir.text(name));
+            if (!isReservedIdentifier(className)) {
+                declared.push_back(className);
+            }
+        }
+        
+        std::unique_lock<std::mutex> lock(symbols->mutex);
+        symbols->waitTurn(lock, turn);
+        for (const auto& className : declared) {
+            if (symbols->classes.find(className) == symbols->classes.end()) {
+                symbols->classes[className] = "_C" + generateObfuscatedName();
+            }
+        }
+        symbols->endTurn(turn);
+    }
+    
+    void addClassObfuscation(SourceIR& ir) {
+        // Obfuscate class names, including classes declared in other files
+        // of the project
+        if (!symbols->classesDeclared) {
+            declareClasses(ir);
+        }
+        
+        std::unordered_map<std::string, std::string> classMap;
+        std::string identifier;
+        for (size_t i = 0; i < ir.size(); ++i) {
+            if (ir[i].kind == TokenKind::Identifier) {
+                classMap.emplace(ir.text(i), std::string());
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(symbols->mutex);
+            for (auto it = classMap.begin(); it != classMap.end();) {
+                auto found = symbols->classes.find(it->first);
+                if (found == symbols->classes.end()) {
+                    it = classMap.erase(it);
+                } else {
+                    (it++)->second = found->second;
+                }
+            }
+        }
+        usedClasses = classMap;
+        
+        if (classMap.empty()) {
+            return;
+        }
+        
+        // Replace class names
+        for (size_t i = 0; i < ir.size(); ++i) {
+            if (ir[i].kind != TokenKind::Identifier) {
+                continue;
+            }
+            identifier.assign(ir.text(i));
+            auto it = classMap.find(identifier);
+            if (it != classMap.end()) {
+                ir.replace(i, it->second);
+            }
+        }
+    }
+    
+    std::string addClassObfuscation(const std::string& code) {
+        SourceIR ir(code);
+        addClassObfuscation(ir);
+        return ir.serialize();
+    }
+    
+    // End of the declaration introduced at `from`: the first ';' outside
+    // brackets, or the '}' closing the first top-level block
+    static size_t findDeclarationEnd(const SourceIR& ir, size_t from) {
+        int depth = 0;
+        for (size_t i = ir.next(from); i != std::string::npos; i = ir.next(i)) {
+            std::string_view token = ir.original(i);
+            if (token == "(" || token == "[" || token == "{") {
+                ++depth;
+            } else if (token == ")" || token == "]" || token == "}") {
+                if (--depth == 0 && token == "}") {
+                    return i;
+                }
+            } else if (token == ";" && depth == 0) {
+                return i;
+            }
+        }
+        return ir.size() - 1;
+    }
+    
+    void addTemplateObfuscation(SourceIR& ir) {
+        // Obfuscate template parameter names throughout the template they
+        // belong to. Nested templates are visited later and take precedence.
+        for (size_t i = 0; i < ir.size(); ++i) {
+            if (ir[i].kind != TokenKind::Identifier || !ir.is(i, "template")) {
+                continue;
+            }
+            size_t open = ir.next(i);
+            if (!ir.is(open, "<")) {
+                continue;
+            }
+            
+            // The declared name is the last identifier of each parameter,
+            // ignoring default arguments
+            std::map<std::string, std::string> params;
+            size_t close = std::string::npos;
+            size_t declared = std::string::npos;
+            bool first = true;
+            bool inDefault = false;
+            int depth = 0;
+            for (size_t j = ir.next(open); j != std::string::npos; j = ir.next(j)) {
+                std::string_view token = ir.original(j);
+                if (token == "<" || token == "(") {
+                    ++depth;
+                } else if ((token == ">" || token == ")") && depth > 0) {
+                    --depth;
+                } else if (depth == 0 && (token == "," || token == ">")) {
+                    if (declared != std::string::npos) {
+                        params[std::string(ir.original(declared))];
+                    }
+                    declared = std::string::npos;
+                    first = true;
+                    inDefault = false;
+                    if (token == ">") {
+                        close = j;
+                        break;
+                    }
+                    continue;
+                } else if (depth == 0 && token == "=") {
+                    inDefault = true;
+                } else if (depth == 0 && !inDefault && !first && ir[j].kind == TokenKind::Identifier &&
+                           !isReservedIdentifier(token)) {
+                    declared = j;
+                }
+                first = false;
+            }
+            
+            if (close == std::string::npos || params.empty()) {
+                continue;
+            }
+            
+            std::set<std::string> used;
+            for (auto& param : params) {
+                do {
+                    param.second = "_T" + std::to_string(rng() % 1000);
+                } while (!used.insert(param.second).second);
+            }
+            
+            size_t end = findDeclarationEnd(ir, close);
+            std::string identifier;
+            for (size_t j = open; j <= end; ++j) {
+                if (ir[j].kind != TokenKind::Identifier) {
+                    continue;
+                }
+                identifier.assign(ir.original(j));
+                auto it = params.find(identifier);
+                if (it != params.end()) {
+                    ir.replace(j, it->second);
+                }
+            }
+        }
+    }
+    
+    std::string addTemplateObfuscation(const std::string& code) {
+        SourceIR ir(code);
+        addTemplateObfuscation(ir);
+        return ir.serialize();
+    }
+    
+    std::string process(std::string_view code, const std::map<std::string, std::string>& processingOptions = {}) {
+        return transform(code, processingOptions, [](const SourceIR& ir) { return ir.serialize(); });
+    }
+    
+    // Lex `code` without copying it, run every enabled pass, and hand the
+    // finished IR to `emit`, which serializes it; returns what emit returns
+    template <typename Emit>
+    auto transform(std::string_view code, const std::map<std::string, std::string>& processingOptions, Emit emit)
+        -> decltype(emit(std::declval<const SourceIR&>())) {
+        std::string key = processingOptions.count("key") ? 
+                         processingOptions.at("key") : 
+                         options["encryptionKey"];
+        
+        if (isDeterministic()) {
+            unsigned char digest[EVP_MAX_MD_SIZE];
+            unsigned int digestLength = 0;
+            EVP_Digest(code.data(), code.size(), digest, &digestLength, EVP_sha256(), nullptr);
+            std::string fileLabel(reinterpret_cast<const char*>(digest), digestLength);
+            
+            unsigned char seed[32];
+            deriveBytes(key, "rng:" + fileLabel, seed);
+            std::seed_seq sequence(seed, seed + sizeof(seed));
+            rng.seed(sequence);
+            cipherFor(key).deriveIVs(fileLabel);
+        }
+        
+        allocation_counter::enabled = stats != nullptr;
+        PassProbe probe;
+        if (stats) {
+            probe = PassProbe::start();
+        }
+        
+        // Lex once; every pass annotates the same token stream and the
+        // result is serialized a single time
+        SourceIR ir(code);
+        usedIdentifiers.clear();
+        usedClasses.clear();
+        if (stats) {
+            probe.finish(stats->pass("lex"), code.size(), code.size());
+        }
+        assignProtection(ir);
+        
+        // Apply C++-specific obfuscations
+        if (passes & PassStrings) {
+            runPass("encryptStrings", ir, [&](SourceIR& ir) { encryptStrings(ir, key); });
+        }
+        if (passes & PassIdentifiers) {
+            runPass("classObfuscation", ir, [&](SourceIR& ir) { addClassObfuscation(ir); });
+            runPass("templateObfuscation", ir, [&](SourceIR& ir) { addTemplateObfuscation(ir); });
+            runPass("obfuscateIdentifiers", ir, [&](SourceIR& ir) { obfuscateIdentifiers(ir); });
+        }
+        if (passes & PassControlFlow) {
+            runPass("controlFlow", ir, [&](SourceIR& ir) { addControlFlowObfuscation(ir); });
+        }
+        if (passes & PassDeadCode) {
+            runPass("deadCode", ir, [&](SourceIR& ir) { addDeadCode(ir); });
+        }
+        if (passes & PassAntiDebug) {
+            runPass("antiDebugging", ir, [&](SourceIR& ir) { addAntiDebugging(ir); });
+        }
+        
+        if (!stats) {
+            return emit(ir);
+        }
+        probe = PassProbe::start();
+        auto result = emit(ir);
+        probe.finish(stats->pass("serialize"), ir.serializedLength(), ir.serializedLength());
+        stats->files++;
+        stats->identifiers += usedIdentifiers.size();
+        stats->classes += usedClasses.size();
+        allocation_counter::enabled = false;
+        return result;
+    }
+};
+
+// Run tasks on a fixed set of threads. Each worker owns a deque that is
+// seeded round-robin; it pops from the back of its own deque and, once that
+// is empty, steals from the front of the others. Tasks never spawn new
+// tasks, so a worker that finds every deque empty is done. With inOrder all
+// tasks sit in one deque and are started in index order.
+void runWorkStealing(size_t taskCount, size_t workerCount, const std::function<void(size_t, size_t)>& run,
+                     bool inOrder) {
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+    
+    workerCount = std::max<size_t>(1, std::min(workerCount, taskCount));
+    std::vector<WorkQueue> queues(workerCount);
+    for (size_t task = 0; task < taskCount; ++task) {
+        queues[inOrder ? 0 : task % workerCount].tasks.push_back(task);
+    }
+    
+    auto worker = [&](size_t self) {
+        for (;;) {
+            size_t task = 0;
+            bool found = false;
+            {
+                WorkQueue& own = queues[inOrder ? 0 : self];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (!own.tasks.empty()) {
+                    task = inOrder ? own.tasks.front() : own.tasks.back();
+                    inOrder ? own.tasks.pop_front() : own.tasks.pop_back();
+                    found = true;
+                }
+            }
+            for (size_t k = 1; !found && k < workerCount; ++k) {
+                WorkQueue& victim = queues[(self + k) % workerCount];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.tasks.empty()) {
+                    task = victim.tasks.front();
+                    victim.tasks.pop_front();
+                    found = true;
+                }
+            }
+            if (!found) {
+                return;
+            }
+            run(task, self);
+        }
+    };
+    
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < workerCount; ++i) {
+        threads.emplace_back(worker, i);
+    }
+    worker(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// Extract the value of a string member from a JSON object body
+static bool jsonStringField(const std::string& object, const std::string& field, std::string& value) {
+    size_t pos = object.find("\"" + field + "\"");
+    if (pos == std::string::npos || (pos = object.find(':', pos)) == std::string::npos ||
+        (pos = object.find('"', pos)) == std::string::npos) {
+        return false;
+    }
+    
+    value.clear();
+    for (++pos; pos < object.length() && object[pos] != '"'; ++pos) {
+        if (object[pos] == '\\' && pos + 1 < object.length()) {
+            ++pos;
+        }
+        value += object[pos];
+    }
+    return true;
+}
+
+// Index of the '}' closing the JSON object that opens at `pos`, skipping
+// nested objects and quoted strings (commands may hold braces like -DX={1})
+static size_t jsonObjectEnd(const std::string& json, size_t pos) {
+    int depth = 0;
+    for (; pos < json.length(); ++pos) {
+        if (json[pos] == '"') {
+            for (++pos; pos < json.length() && json[pos] != '"'; ++pos) {
+                if (json[pos] == '\\') {
+                    ++pos;
+                }
+            }
+        } else if (json[pos] == '{') {
+            ++depth;
+        } else if (json[pos] == '}' && --depth == 0) {
+            return pos;
+        }
+    }
+    return std::string::npos;
+}
+
+// Translation units listed in a compile_commands.json database
+static std::vector<std::filesystem::path> readCompileCommands(const std::filesystem::path& database) {
+    std::ifstream file(database);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string json = buffer.str();
+    
+    std::vector<std::filesystem::path> files;
+    std::set<std::filesystem::path> seen;
+    size_t pos = 0;
+    while ((pos = json.find('{', pos)) != std::string::npos) {
+        size_t end = jsonObjectEnd(json, pos);
+        if (end == std::string::npos) {
+            break;
+        }
+        std::string object = json.substr(pos, end - pos);
+        pos = end + 1;
+        
+        std::string directory;
+        std::string name;
+        if (!jsonStringField(object, "file", name)) {
+            continue;
+        }
+        std::filesystem::path path(name);
+        if (path.is_relative() && jsonStringField(object, "directory", directory)) {
+            path = std::filesystem::path(directory) / path;
+        }
+        path = path.lexically_normal();
+        if (seen.insert(path).second) {
+            files.push_back(path);
+        }
+    }
+    return files;
+}
+
+static bool isCppSource(const std::filesystem::path& path) {
+    static const std::set<std::string> extensions = {
+        ".cpp", ".cc", ".cxx", ".c++", ".C", ".hpp", ".hh", ".hxx", ".h", ".inl", ".ipp"
+    };
+    return extensions.count(path.extension().string()) > 0;
+}
+
+// Write a --stats report to `path`, or to stderr when the path is "-"
+static bool writeStats(const ProcessStats& stats, double wallSeconds, const std::string& path) {
+    std::string json = stats.toJson(wallSeconds);
+    if (path == "-") {
+        std::cerr << json;
+        return true;
+    }
+    std::ofstream out(path, std::ios::binary);
+    out << json;
+    if (!out) {
+        std::cerr << "Error: Cannot write stats to " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Obfuscate every translation unit of a project (a directory tree or a
+// compile_commands.json) on a work-stealing pool. All workers share one
+// SymbolTable so renames stay consistent across files; class names are
+// discovered in a first parallel phase so every file renames them alike.
+// With a cache, unchanged files are copied from it and their renames are
+// merged into the table before anything else is processed. A non-empty
+// statsPath sums every worker's pass statistics into one report, and a
+// profile lightens the protection of hot functions in every file.
+int runProject(const std::string& input, const std::string& outDir, size_t jobs,
+               const std::map<std::string, std::string>& options, const std::string& cacheDir,
+               const std::string& statsPath = std::string(),
+               std::shared_ptr<const ObfuscationProfile> profile = nullptr) {
+    namespace fs = std::filesystem;
+    
+    std::vector<fs::path> files;
+    fs::path root = fs::path(input);
+    std::error_code error;
+    if (fs::is_directory(root, error)) {
+        for (const auto& entry : fs::recursive_directory_iterator(root, error)) {
+            if (entry.is_regular_file() && isCppSource(entry.path())) {
+                files.push_back(entry.path());
+            }
+        }
+    } else if (fs::is_regular_file(root, error)) {
+        files = readCompileCommands(root);
+        root = root.parent_path();
+    } else {
+        std::cerr << "Error: Cannot open project " << input << std::endl;
+        return 1;
+    }
+    
+    // Largest files first keeps the tail of the schedule short
+    std::vector<std::uintmax_t> sizes(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        sizes[i] = fs::file_size(files[i], error);
+    }
+    std::vector<size_t> order(files.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+    
+    // Deterministic runs go in path order and draw names one file at a time
+    bool deterministic = options.count("deterministic") && options.at("deterministic") == "1";
+    if (deterministic) {
+        std::sort(order.begin(), order.end(), [&files](size_t a, size_t b) { return files[a] < files[b]; });
+    }
+    
+    auto symbols = std::make_shared<SymbolTable>();
+    symbols->ordered = deterministic;
+    std::string key = encryptionKeyOption(options);
+    nameGeneratorInit(&symbols->names, key.data(), key.size());
+    std::vector<std::unique_ptr<CppProcessor>> processors;
+    for (size_t i = 0; i < jobs; ++i) {
+        processors.emplace_back(new CppProcessor(options, symbols));
+        processors.back()->setProfile(profile);
+        if (!statsPath.empty()) {
+            processors.back()->enableStats();
+        }
+    }
+    
+    std::unique_ptr<ObfuscationCache> cache;
+    if (!cacheDir.empty()) {
+        cache.reset(new ObfuscationCache(cacheDir));
+    }
     
-    // Reserved C++ keywords
-    std::vector<std::string> reservedKeywords = {
-        "alignas", "alignof", "and", "and_eq", "asm", "atomic_cancel", "atomic_commit",
-        "atomic_noexcept", "auto", "bitand", "bitor", "bool", "break", "case",
-        "catch", "char", "char8_t", "char16_t", "char32_t", "class", "compl",
-        "concept", "const", "consteval", "constexpr", "constinit", "const_cast",
-        "continue", "co_await", "co_return", "co_yield", "decltype", "default",
-        "delete", "do", "double", "dynamic_cast", "else", "enum", "explicit",
-        "export", "extern", "false", "float", "for", "friend", "goto", "if",
-        "inline", "int", "long", "mutable", "namespace", "new", "noexcept",
-        "not", "not_eq", "nullptr", "operator", "or", "or_eq", "private",
-        "protected", "public", "reflexpr", "register", "reinterpret_cast",
-        "requires", "return", "short", "signed", "sizeof", "static",
-        "static_assert", "static_cast", "struct", "switch", "synchronized",
-        "template", "this", "thread_local", "throw", "true", "try", "typedef",
-        "typeid", "typename", "union", "unsigned", "using", "virtual", "void",
-        "volatile", "wchar_t", "while", "xor", "xor_eq"
-    };
+    std::vector<std::string> sources(files.size());
+    std::vector<std::string> keys(files.size());
+    std::vector<CacheEntry> cached(files.size());
+    std::vector<char> failed(files.size(), false);  // not vector<bool>: written concurrently
+    std::vector<char> hit(files.size(), false);
+    auto start = std::chrono::steady_clock::now();
     
-    // Standard library identifiers to preserve
-    std::vector<std::string> stdIdentifiers = {
-        "std", "cout", "cin", "endl", "string", "vector", "map", "set", "list",
-        "iostream", "fstream", "sstream", "algorithm", "iterator", "memory",
-        "shared_ptr", "unique_ptr", "make_shared", "make_unique"
-    };
-
-public:
-    CppProcessor(const std::map<std::string, std::string>& opts = {}) 
-        : options(opts), rng(std::chrono::steady_clock::now().time_since_epoch().count()) {
-        if (options.find("encryptionKey") == options.end()) {
-            options["encryptionKey"] = "default_encryption_key_32_chars_";
+    // Phase 0: read every file and look it up in the cache
+    runWorkStealing(files.size(), jobs, [&](size_t task, size_t) {
+        size_t index = order[task];
+        std::ifstream file(files[index], std::ios::binary);
+        if (!file.is_open()) {
+            failed[index] = true;
+            return;
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        sources[index] = buffer.str();
+        if (cache) {
+            keys[index] = ObfuscationCache::key(sources[index], options);
+            hit[index] = cache->load(keys[index], cached[index]);
+        }
+    });
+    
+    // Merge cached renames in a fixed order. A file whose renames disagree
+    // with one merged before it is processed again.
+    for (size_t index : order) {
+        if (hit[index] && !mergeCachedSymbols(*symbols, cached[index])) {
+            hit[index] = false;
         }
     }
     
-    std::string encryptString(const std::string& plaintext, const std::string& key) {
-        EVP_CIPHER_CTX *ctx;
-        int len;
-        int ciphertext_len;
-        unsigned char *ciphertext;
-        unsigned char iv[AES_BLOCK_SIZE];
-        
-        // Generate random IV
-        if (RAND_bytes(iv, AES_BLOCK_SIZE) != 1) {
-            return "";
+    // Phase 1: register the classes declared by every file not taken from
+    // the cache (cached files' classes were merged above)
+    runWorkStealing(files.size(), jobs, [&](size_t task, size_t worker) {
+        size_t index = order[task];
+        if (!failed[index] && !hit[index]) {
+            SourceIR ir(sources[index]);
+            processors[worker]->setTurn(task);
+            processors[worker]->declareClasses(ir);
         }
-        
-        // Create and initialize the context
-        if (!(ctx = EVP_CIPHER_CTX_new())) {
-            return "";
+        symbols->skipTurn(task);
+    }, deterministic);
+    symbols->classesDeclared = true;
+    symbols->nextTurn = 0;
+    
+    // A cached file that uses a name another file now declares as a class
+    // would not rename it like the others do
+    for (size_t index = 0; index < files.size(); ++index) {
+        for (size_t i = 0; hit[index] && i < cached[index].identifiers.size(); ++i) {
+            hit[index] = symbols->classes.count(cached[index].identifiers[i].first) == 0;
         }
-        
-        // Initialize the encryption operation
-        std::string keyPadded = key;
-        keyPadded.resize(32, '\0');
-        
-        if (EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), NULL, 
-                              reinterpret_cast<const unsigned char*>(keyPadded.c_str()), iv) != 1) {
-            EVP_CIPHER_CTX_free(ctx);
-            return "";
+    }
+    
+    // Phase 2: obfuscate and write each file under the output directory
+    runWorkStealing(files.size(), jobs, [&](size_t task, size_t worker) {
+        size_t index = order[task];
+        if (failed[index]) {
+            symbols->skipTurn(task);
+            return;
         }
         
-        // Allocate memory for ciphertext
-        ciphertext = new unsigned char[plaintext.length() + AES_BLOCK_SIZE + AES_BLOCK_SIZE];
-        
-        // Copy IV to beginning of ciphertext
-        memcpy(ciphertext, iv, AES_BLOCK_SIZE);
-        
-        // Encrypt the plaintext
-        if (EVP_EncryptUpdate(ctx, ciphertext + AES_BLOCK_SIZE, &len, 
-                             reinterpret_cast<const unsigned char*>(plaintext.c_str()), 
-                             plaintext.length()) != 1) {
-            delete[] ciphertext;
-            EVP_CIPHER_CTX_free(ctx);
-            return "";
+        fs::path relative = files[index].lexically_relative(root);
+        if (relative.empty() || *relative.begin() == "..") {
+            relative = files[index].relative_path();
         }
-        ciphertext_len = len;
+        fs::path target = fs::path(outDir) / relative;
         
-        // Finalize the encryption
-        if (EVP_EncryptFinal_ex(ctx, ciphertext + AES_BLOCK_SIZE + len, &len) != 1) {
-            delete[] ciphertext;
-            EVP_CIPHER_CTX_free(ctx);
-            return "";
+        CacheEntry& entry = cached[index];
+        if (!hit[index]) {
+            processors[worker]->setTurn(task);
+            entry.output = processors[worker]->process(sources[index]);
+            if (cache) {
+                processors[worker]->exportSymbols(entry);
+                cache->store(keys[index], entry);
+            }
         }
-        ciphertext_len += len;
-        
-        // Clean up
-        EVP_CIPHER_CTX_free(ctx);
-        
-        // Convert to base64
-        BIO *bio, *b64;
-        BUF_MEM *bufferPtr;
-        
-        b64 = BIO_new(BIO_f_base64());
-        bio = BIO_new(BIO_s_mem());
-        bio = BIO_push(b64, bio);
-        
-        BIO_set_flags(bio, BIO_FLAGS_BASE64_NO_NL);
-        BIO_write(bio, ciphertext, ciphertext_len + AES_BLOCK_SIZE);
-        BIO_flush(bio);
-        BIO_get_mem_ptr(bio, &bufferPtr);
-        
-        std::string result(bufferPtr->data, bufferPtr->length);
+        symbols->skipTurn(task);
+        std::string().swap(sources[index]);
         
-        BIO_free_all(bio);
-        delete[] ciphertext;
-        
-        return result;
+        std::error_code ignored;
+        fs::create_directories(target.parent_path(), ignored);
+        std::ofstream out(target, std::ios::binary);
+        out << entry.output;
+        failed[index] = !out;
+        entry = CacheEntry();
+    }, deterministic);
+    
+    size_t failures = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (failed[i]) {
+            std::cerr << "Error: Cannot process file " << files[i].string() << std::endl;
+            ++failures;
+        }
     }
     
-    std::string generateObfuscatedName() {
-        const std::string charset = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
-        std::uniform_int_distribution<> lengthDist(8, 16);
-        std::uniform_int_distribution<> charDist(0, charset.length() - 1);
-        
-        int length = lengthDist(rng);
-        std::string result;
-        result.reserve(length);
-        
-        // First character must be a letter
-        result += charset[charDist(rng)];
-        
-        // Remaining characters can be letters or numbers
-        const std::string fullCharset = charset + "0123456789";
-        std::uniform_int_distribution<> fullCharDist(0, fullCharset.length() - 1);
-        
-        for (int i = 1; i < length; ++i) {
-            result += fullCharset[fullCharDist(rng)];
+    size_t hits = std::count(hit.begin(), hit.end(), true);
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "Processed " << files.size() - failures << " of " << files.size() << " files with " << jobs
+              << " workers in " << elapsed << " ms (" << symbols->identifiers.size() << " identifiers, "
+              << hits << " from cache)" << std::endl;
+    
+    if (!statsPath.empty()) {
+        ProcessStats total;
+        for (auto& processor : processors) {
+            total.merge(*processor->getStats());
+        }
+        if (!writeStats(total, elapsed / 1000, statsPath)) {
+            return 1;
         }
-        
-        return result;
     }
     
-    bool isReservedIdentifier(const std::string& identifier) {
-        return std::find(reservedKeywords.begin(), reservedKeywords.end(), identifier) != reservedKeywords.end() ||
-               std::find(stdIdentifiers.begin(), stdIdentifiers.end(), identifier) != stdIdentifiers.end();
+    return failures ? 1 : 0;
+}
+
+// Server mode (--serve). Requests and responses are frames: a 4-byte
+// big-endian payload length followed by the payload. A request payload is
+// a one-line header holding an opaque request id, then the source:
+//
+//   "<id>\n<source>"
+//
+// and the response payload echoes the id with a status:
+//
+//   "<id> ok\n<output>"  or  "<id> error <message>\n"
+//
+// Requests are processed concurrently, so responses on one stream can come
+// back in any order. Each worker keeps its processor, cipher context and
+// keyword tables between requests, and all workers share one symbol table:
+// a name is renamed the same way in every file the server sees.
+class ObfuscationServer {
+public:
+    static constexpr std::uint32_t kMaxFrame = 256u << 20;
+    
+    ObfuscationServer(const std::map<std::string, std::string>& options, size_t jobs,
+                      std::shared_ptr<const ObfuscationProfile> profile)
+        : symbols(std::make_shared<SymbolTable>()) {
+        std::string key = encryptionKeyOption(options);
+        nameGeneratorInit(&symbols->names, key.data(), key.size());
+        for (size_t i = 0; i < std::max<size_t>(1, jobs); ++i) {
+            processors.emplace_back(new CppProcessor(options, symbols));
+            processors.back()->setProfile(profile);
+        }
+        for (size_t i = 0; i < processors.size(); ++i) {
+            workers.emplace_back(&ObfuscationServer::work, this, i);
+        }
     }
     
-    std::string encryptStrings(const std::string& code, const std::string& key) {
-        std::string result = code;
-        std::regex stringPattern(R"("([^"\\]|\\.)*")");
-        std::sregex_iterator iter(code.begin(), code.end(), stringPattern);
-        std::sregex_iterator end;
+    ~ObfuscationServer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        queueChanged.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+    
+    // Serve one stream until the client closes it, then wait for its
+    // outstanding responses
+    void serve(int in, int out) {
+        auto connection = std::make_shared<Connection>();
+        connection->out = out;
+        std::string payload;
+        while (readFrame(in, payload)) {
+            size_t newline = payload.find('\n');
+            Request request;
+            request.connection = connection;
+            request.id = payload.substr(0, newline);
+            request.source = newline == std::string::npos ? std::string() : payload.substr(newline + 1);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                queue.push_back(std::move(request));
+                connection->pending++;
+            }
+            queueChanged.notify_one();
+        }
         
-        std::vector<std::pair<std::string, std::string>> replacements;
-        int stringIndex = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        connection->drained.wait(lock, [&] { return connection->pending == 0; });
+    }
+    
+    // Accept connections on a Unix socket, one reader thread each
+    int serveSocket(const std::string& path) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            std::cerr << "Error: Socket path too long: " << path << std::endl;
+            return 1;
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
         
-        for (; iter != end; ++iter) {
-            std::string originalString = iter->str();
-            std::string content = originalString.substr(1, originalString.length() - 2); // Remove quotes
-            
-            std::string encrypted = encryptString(content, key);
-            if (!encrypted.empty()) {
-                std::string varName = "_str_" + std::to_string(stringIndex++);
-                
-                encryptedStrings.push_back(
-                    "static std::string " + varName + " = _decrypt_str(\"" + encrypted + "\", \"" + key + "\");"
-                );
-                
-                replacements.push_back({originalString, varName});
+        int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(path.c_str());
+        if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            listen(listener, 64) != 0) {
+            std::cerr << "Error: Cannot listen on " << path << ": " << std::strerror(errno) << std::endl;
+            if (listener >= 0) {
+                close(listener);
             }
+            return 1;
         }
+        std::cerr << "Listening on " << path << " with " << processors.size() << " workers" << std::endl;
         
-        // Replace strings with variable references
-        for (const auto& replacement : replacements) {
-            size_t pos = 0;
-            while ((pos = result.find(replacement.first, pos)) != std::string::npos) {
-                result.replace(pos, replacement.first.length(), replacement.second);
-                pos += replacement.second.length();
+        for (;;) {
+            int client = accept(listener, nullptr, nullptr);
+            if (client < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
             }
+            std::thread([this, client] {
+                serve(client, client);
+                close(client);
+            }).detach();
         }
-        
-        // Add decryption function
-        std::string decryptFunction = R"(
-// String decryption function
-#include <openssl/evp.h>
-#include <openssl/bio.h>
-#include <openssl/buffer.h>
+        close(listener);
+        return 1;
+    }
 
-std::string _decrypt_str(const std::string& encrypted, const std::string& key) {
-    // Base64 decode
-    BIO *bio, *b64;
-    int decodeLen = encrypted.length();
-    unsigned char *buffer = new unsigned char[decodeLen];
-    
-    bio = BIO_new_mem_buf(encrypted.c_str(), -1);
-    b64 = BIO_new(BIO_f_base64());
-    bio = BIO_push(b64, bio);
-    
-    BIO_set_flags(bio, BIO_FLAGS_BASE64_NO_NL);
-    int length = BIO_read(bio, buffer, encrypted.length());
-    BIO_free_all(bio);
-    
-    // Extract IV
-    unsigned char iv[16];
-    memcpy(iv, buffer, 16);
-    
-    // Decrypt
-    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
-    std::string keyPadded = key;
-    keyPadded.resize(32, '\0');
-    
-    EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), NULL, 
-                      reinterpret_cast<const unsigned char*>(keyPadded.c_str()), iv);
-    
-    unsigned char *plaintext = new unsigned char[length];
-    int len, plaintext_len;
-    
-    EVP_DecryptUpdate(ctx, plaintext, &len, buffer + 16, length - 16);
-    plaintext_len = len;
-    EVP_DecryptFinal_ex(ctx, plaintext + len, &len);
-    plaintext_len += len;
+private:
+    struct Connection {
+        int out = -1;
+        std::mutex writeMutex;
+        size_t pending = 0;  // guarded by the server mutex
+        std::condition_variable drained;
+    };
     
-    std::string result(reinterpret_cast<char*>(plaintext), plaintext_len);
+    struct Request {
+        std::shared_ptr<Connection> connection;
+        std::string id;
+        std::string source;
+    };
     
-    EVP_CIPHER_CTX_free(ctx);
-    delete[] buffer;
-    delete[] plaintext;
+    std::shared_ptr<SymbolTable> symbols;
+    std::vector<std::unique_ptr<CppProcessor>> processors;
+    std::vector<std::thread> workers;
+    std::deque<Request> queue;
+    std::mutex mutex;
+    std::condition_variable queueChanged;
+    bool stopping = false;
     
-    return result;
-}
-
-)";
-        
-        // Add string declarations
-        std::string stringDeclarations;
-        for (const auto& str : encryptedStrings) {
-            stringDeclarations += str + "\n";
+    static bool readFully(int fd, char* data, size_t length) {
+        while (length > 0) {
+            ssize_t n = read(fd, data, length);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            data += n;
+            length -= static_cast<size_t>(n);
         }
-        
-        return decryptFunction + stringDeclarations + result;
+        return true;
     }
     
-    std::string obfuscateIdentifiers(const std::string& code) {
-        std::string result = code;
-        std::regex identifierPattern(R"(\b[a-zA-Z_][a-zA-Z0-9_]*\b)");
-        std::sregex_iterator iter(code.begin(), code.end(), identifierPattern);
-        std::sregex_iterator end;
-        
-        std::set<std::string> identifiersToObfuscate;
-        
-        // Collect identifiers
-        for (; iter != end; ++iter) {
-            std::string identifier = iter->str();
-            if (!isReservedIdentifier(identifier) && identifier.length() > 1) {
-                identifiersToObfuscate.insert(identifier);
+    static bool writeFully(int fd, const char* data, size_t length) {
+        while (length > 0) {
+            ssize_t n = write(fd, data, length);
+            if (n < 0 && errno == EINTR) {
+                continue;
             }
-        }
-        
-        // Generate obfuscated names
-        for (const auto& identifier : identifiersToObfuscate) {
-            if (identifierMap.find(identifier) == identifierMap.end()) {
-                identifierMap[identifier] = generateObfuscatedName();
+            if (n <= 0) {
+                return false;
             }
+            data += n;
+            length -= static_cast<size_t>(n);
         }
-        
-        // Replace identifiers
-        for (const auto& mapping : identifierMap) {
-            std::regex replacePattern("\\b" + mapping.first + "\\b");
-            result = std::regex_replace(result, replacePattern, mapping.second);
+        return true;
+    }
+    
+    static bool readFrame(int fd, std::string& payload) {
+        unsigned char header[4];
+        if (!readFully(fd, reinterpret_cast<char*>(header), sizeof(header))) {
+            return false;
         }
-        
-        return result;
+        std::uint32_t length = (std::uint32_t(header[0]) << 24) | (std::uint32_t(header[1]) << 16) |
+                               (std::uint32_t(header[2]) << 8) | std::uint32_t(header[3]);
+        if (length > kMaxFrame) {
+            std::cerr << "Error: Request of " << length << " bytes exceeds the frame limit" << std::endl;
+            return false;
+        }
+        payload.resize(length);
+        return readFully(fd, &payload[0], length);
     }
     
-    std::string addControlFlowObfuscation(const std::string& code) {
-        std::string result = code;
-        
-        // Convert if-else to switch statements
-        std::regex ifPattern(R"(if\s*\(([^)]+)\)\s*\{([^}]+)\}(?:\s*else\s*\{([^}]+)\})?)");
-        
-        result = std::regex_replace(result, ifPattern, [this](const std::smatch& match) {
-            std::string condition = match[1].str();
-            std::string ifBlock = match[2].str();
-            std::string elseBlock = match[3].str();
-            
-            std::string switchVar = "_sw" + std::to_string(rng() % 10000);
-            std::string replacement = "int " + switchVar + " = (" + condition + ") ? 1 : 0;\n";
-            replacement += "switch (" + switchVar + ") {\n";
-            replacement += "    case 1:\n        " + ifBlock + "\n        break;\n";
+    static void writeFrame(Connection& connection, const std::string& head, const std::string& body) {
+        std::uint32_t length = static_cast<std::uint32_t>(head.size() + body.size());
+        std::string frame;
+        frame.reserve(4 + length);
+        frame += static_cast<char>(length >> 24);
+        frame += static_cast<char>(length >> 16);
+        frame += static_cast<char>(length >> 8);
+        frame += static_cast<char>(length);
+        frame += head;
+        frame += body;
+        std::lock_guard<std::mutex> lock(connection.writeMutex);
+        writeFully(connection.out, frame.data(), frame.size());
+    }
+    
+    void work(size_t self) {
+        for (;;) {
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                queueChanged.wait(lock, [&] { return stopping || !queue.empty(); });
+                if (queue.empty()) {
+                    return;
+                }
+                request = std::move(queue.front());
+                queue.pop_front();
+            }
             
-            if (!elseBlock.empty()) {
-                replacement += "    default:\n        " + elseBlock + "\n        break;\n";
+            try {
+                std::string output = processors[self]->process(request.source);
+                writeFrame(*request.connection, request.id + " ok\n", output);
+            } catch (const std::exception& error) {
+                writeFrame(*request.connection, request.id + " error " + error.what() + "\n", std::string());
             }
             
-            replacement += "}";
-            return replacement;
-        });
-        
-        return result;
-    }
-    
-    std::string addDeadCode(const std::string& code) {
-        std::vector<std::string> deadCodeSnippets = {
-            "volatile int _dummy1 = std::rand() % 100;\n",
-            "volatile auto _dummy2 = std::chrono::steady_clock::now().time_since_epoch().count() & 0xFF;\n",
-            "if (_dummy1 > 200) { std::cout << \"Never executed\"; }\n",
-            "for (int _i = 0; _i < 0; ++_i) { _dummy2++; }\n",
-            "std::vector<int> _dummy_vec; _dummy_vec.reserve(0);\n"
-        };
-        
-        std::string result = code;
-        std::uniform_int_distribution<> snippetDist(0, deadCodeSnippets.size() - 1);
-        
-        // Find function bodies and insert dead code
-        std::regex functionPattern(R"(\{)");
-        std::sregex_iterator iter(code.begin(), code.end(), functionPattern);
-        std::sregex_iterator end;
-        
-        int insertions = 0;
-        for (; iter != end && insertions < 3; ++iter, ++insertions) {
-            size_t pos = iter->position() + 1;
-            std::string deadCode = deadCodeSnippets[snippetDist(rng)];
-            result.insert(pos + insertions * deadCode.length(), deadCode);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--request.connection->pending == 0) {
+                request.connection->drained.notify_all();
+            }
         }
-        
-        return result;
     }
-    
-    std::string addAntiDebugging(const std::string& code) {
-        std::string antiDebugCode = R"(
-// Anti-debugging measures
-#include <chrono>
-#include <thread>
-#ifdef _WIN32
-#include <windows.h>
-#include <debugapi.h>
-#else
-#include <sys/ptrace.h>
-#include <unistd.h>
-#endif
+};
 
-class AntiDebug {
-public:
-    static void check() {
-#ifdef _WIN32
-        if (IsDebuggerPresent()) {
-            std::exit(1);
+// C ABI, declared in ObfuscatorApi.h. No exception crosses it.
+
+// A field of the caller's options, or `fallback` when the caller was built
+// against an older, shorter ObfuscatorOptions
+#define OBFUSCATOR_OPTION(options, field, fallback) \
+    ((options) && (options)->structSize >= offsetof(ObfuscatorOptions, field) + sizeof((options)->field) \
+         ? (options)->field : (fallback))
+
+struct CppObfuscator {
+    std::unique_ptr<CppProcessor> processor;
+    std::string result;  // output kept when the caller's buffer was too small
+};
+
+extern "C" CppObfuscator* cppObfuscatorCreate(const ObfuscatorOptions* options) {
+    try {
+        std::map<std::string, std::string> settings;
+        const char* key = OBFUSCATOR_OPTION(options, encryptionKey, nullptr);
+        settings["encryptionKey"] = key ? key : kDefaultEncryptionKey;
+        if (const char* passes = OBFUSCATOR_OPTION(options, passes, nullptr)) {
+            unsigned flags = 0;
+            if (!parsePassList(passes, flags)) {
+                return nullptr;
+            }
+            settings["passes"] = passes;
         }
-        
-        BOOL debuggerPresent = FALSE;
-        CheckRemoteDebuggerPresent(GetCurrentProcess(), &debuggerPresent);
-        if (debuggerPresent) {
-            std::exit(1);
+        if (OBFUSCATOR_OPTION(options, deterministic, 0)) {
+            settings["deterministic"] = "1";
         }
-#else
-        if (ptrace(PTRACE_TRACEME, 0, 1, 0) == -1) {
-            std::exit(1);
+        if (const char* stringMode = OBFUSCATOR_OPTION(options, stringMode, nullptr)) {
+            settings["stringMode"] = stringMode;
         }
-#endif
-        
-        // Timing check
-        auto start = std::chrono::high_resolution_clock::now();
-        volatile int dummy = 0;
-        for (int i = 0; i < 1000; ++i) {
-            dummy += i;
+        if (const char* antiDebug = OBFUSCATOR_OPTION(options, antiDebugMode, nullptr)) {
+            if (std::strcmp(antiDebug, "check") != 0 && std::strcmp(antiDebug, "monitor") != 0) {
+                return nullptr;
+            }
+            settings["antiDebug"] = antiDebug;
+            settings["antiDebugInterval"] = std::to_string(std::max(1, OBFUSCATOR_OPTION(options, antiDebugInterval, 100)));
+        }
+        const char* preservePath = OBFUSCATOR_OPTION(options, preservePath, nullptr);
+        if (preservePath && !NameSet::readList(preservePath, settings["preserve"])) {
+            return nullptr;
         }
-        auto end = std::chrono::high_resolution_clock::now();
         
-        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-        if (duration.count() > 10000) {
-            std::exit(1);
+        std::unique_ptr<CppObfuscator> obfuscator(new CppObfuscator());
+        obfuscator->processor.reset(new CppProcessor(settings));
+        if (const char* profilePath = OBFUSCATOR_OPTION(options, profilePath, nullptr)) {
+            auto profile = std::make_shared<ObfuscationProfile>();
+            if (!ObfuscationProfile::load(profilePath, OBFUSCATOR_OPTION(options, overheadBudget, 2.0),
+                                          OBFUSCATOR_OPTION(options, fullCost, ObfuscationProfile::kFullCost),
+                                          OBFUSCATOR_OPTION(options, lightCost, ObfuscationProfile::kLightCost), *profile)) {
+                return nullptr;
+            }
+            obfuscator->processor->setProfile(profile);
         }
+        return obfuscator.release();
+    } catch (...) {
+        return nullptr;
     }
-};
+}
 
-)";
-        
-        std::string result = antiDebugCode + code;
-        
-        // Insert anti-debug call at the beginning of main
-        std::regex mainPattern(R"(int\s+main\s*\([^)]*\)\s*\{)");
-        result = std::regex_replace(result, mainPattern, "$&\n    AntiDebug::check();");
-        
-        return result;
+extern "C" void cppObfuscatorDestroy(CppObfuscator* obfuscator) {
+    delete obfuscator;
+}
+
+extern "C" ObfuscatorStatus cppObfuscatorProcess(CppObfuscator* obfuscator, const char* source, size_t length,
+                                                 char* output, size_t capacity, size_t* outputLength) {
+    if (!obfuscator || (!source && length > 0) || (!output && capacity > 0) || !outputLength) {
+        return OBFUSCATOR_INVALID_ARGUMENT;
     }
-    
-    std::string addClassObfuscation(const std::string& code) {
-        std::string result = code;
-        
-        // Obfuscate class names
-        std::regex classPattern(R"(class\s+([a-zA-Z_][a-zA-Z0-9_]*))");
-        std::sregex_iterator iter(code.begin(), code.end(), classPattern);
-        std::sregex_iterator end;
-        
-        std::map<std::string, std::string> classMap;
-        
-        for (; iter != end; ++iter) {
-            std::string className = iter->str(1);
-            if (classMap.find(className) == classMap.end()) {
-                classMap[className] = "_C" + generateObfuscatedName().substr(0, 8);
+    try {
+        obfuscator->result.clear();
+        std::string_view code(source ? source : "", length);
+        return obfuscator->processor->transform(code, {}, [&](const SourceIR& ir) {
+            // The IR knows its output length, so output that fits is
+            // serialized straight into the caller's buffer
+            *outputLength = ir.serializedLength();
+            if (*outputLength > capacity) {
+                obfuscator->result = ir.serialize();
+                return OBFUSCATOR_BUFFER_TOO_SMALL;
             }
-        }
-        
-        // Replace class names
-        for (const auto& mapping : classMap) {
-            std::regex replacePattern("\\b" + mapping.first + "\\b");
-            result = std::regex_replace(result, replacePattern, mapping.second);
-        }
-        
-        return result;
-    }
-    
-    std::string addTemplateObfuscation(const std::string& code) {
-        std::string result = code;
-        
-        // Obfuscate template parameters
-        std::regex templatePattern(R"(template\s*<([^>]+)>)");
-        
-        result = std::regex_replace(result, templatePattern, [this](const std::smatch& match) {
-            std::string params = match[1].str();
-            
-            // Simple obfuscation of template parameter names
-            std::regex paramPattern(R"(\b([a-zA-Z_][a-zA-Z0-9_]*)\b)");
-            params = std::regex_replace(params, paramPattern, [this](const std::smatch& paramMatch) {
-                std::string param = paramMatch[1].str();
-                if (param != "typename" && param != "class" && param != "int" && param != "bool") {
-                    return "_T" + std::to_string(rng() % 1000);
-                }
-                return param;
+            char* at = output;
+            ir.serializeTo([&at](const char* data, size_t size) {
+                if (size > 0) {
+                    std::memcpy(at, data, size);
+                    at += size;
+                }
             });
-            
-            return "template<" + params + ">";
+            return OBFUSCATOR_OK;
         });
-        
-        return result;
+    } catch (const std::bad_alloc&) {
+        return OBFUSCATOR_OUT_OF_MEMORY;
+    } catch (...) {
+        return OBFUSCATOR_PROCESSING_FAILED;
     }
-    
-    std::string process(const std::string& code, const std::map<std::string, std::string>& processingOptions = {}) {
-        std::string key = processingOptions.count("key") ? 
-                         processingOptions.at("key") : 
-                         options["encryptionKey"];
-        
-        std::string result = code;
-        
-        // Apply C++-specific obfuscations
-        result = encryptStrings(result, key);
-        result = addClassObfuscation(result);
-        result = addTemplateObfuscation(result);
-        result = obfuscateIdentifiers(result);
-        result = addControlFlowObfuscation(result);
-        result = addDeadCode(result);
-        result = addAntiDebugging(result);
-        
-        return result;
+}
+
+extern "C" ObfuscatorStatus cppObfuscatorProcessStream(CppObfuscator* obfuscator, const char* source, size_t length,
+                                                       ObfuscatorWriteFn write, void* context) {
+    if (!obfuscator || (!source && length > 0) || !write) {
+        return OBFUSCATOR_INVALID_ARGUMENT;
     }
-};
+    try {
+        std::string_view code(source ? source : "", length);
+        return obfuscator->processor->transform(code, {}, [&](const SourceIR& ir) {
+            bool complete = ir.serializeTo([&](const char* data, size_t size) { return write(context, data, size) == 0; });
+            return complete ? OBFUSCATOR_OK : OBFUSCATOR_WRITE_ABORTED;
+        });
+    } catch (const std::bad_alloc&) {
+        return OBFUSCATOR_OUT_OF_MEMORY;
+    } catch (...) {
+        return OBFUSCATOR_PROCESSING_FAILED;
+    }
+}
+
+extern "C" ObfuscatorStatus cppObfuscatorCopyResult(CppObfuscator* obfuscator, char* output, size_t capacity,
+                                                    size_t* outputLength) {
+    if (!obfuscator || (!output && capacity > 0) || !outputLength) {
+        return OBFUSCATOR_INVALID_ARGUMENT;
+    }
+    *outputLength = obfuscator->result.size();
+    if (*outputLength > capacity) {
+        return OBFUSCATOR_BUFFER_TOO_SMALL;
+    }
+    if (*outputLength > 0) {
+        std::memcpy(output, obfuscator->result.data(), *outputLength);
+    }
+    return OBFUSCATOR_OK;
+}
+
+// Main processor interface. Define PROCESSOR_NO_MAIN to include this file
+// in another program, e.g. the benchmarks under examples/benchmarks.
+#ifndef PROCESSOR_NO_MAIN
+
+// Count allocations for --stats. Only threads that enabled the counter pay
+// for the two increments. The operators stay out of line so the compiler
+// does not pair an inlined free() with a new expression.
+__attribute__((noinline)) void* operator new(std::size_t size) {
+    if (allocation_counter::enabled) {
+        allocation_counter::count++;
+        allocation_counter::bytes += size;
+    }
+    void* memory = std::malloc(size ? size : 1);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+__attribute__((noinline)) void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+__attribute__((noinline)) void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
 
-// Main processor interface
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
+    // Initialize processor with options
+    std::map<std::string, std::string> options;
+    options["encryptionKey"] = kDefaultEncryptionKey;
+    
+    std::string inputFile;
+    std::string project;
+    std::string outDir = "obfuscated";
+    std::string cacheDir;
+    size_t jobs = std::max(1u, std::thread::hardware_concurrency());
+    std::string statsPath;  // "-" for stderr
+    std::string profilePath;
+    double overheadBudget = 2;  // percent
+    double fullCost = ObfuscationProfile::kFullCost;
+    double lightCost = ObfuscationProfile::kLightCost;
+    std::string preservePath;
+    bool serve = false;
+    std::string socketPath;  // empty: serve stdin/stdout
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--stats") {
+            statsPath = "-";
+        } else if (arg.rfind("--stats=", 0) == 0) {
+            statsPath = arg.substr(std::strlen("--stats="));
+        } else if (arg.rfind("--string-mode=", 0) == 0) {
+            options["stringMode"] = arg.substr(std::strlen("--string-mode="));
+        } else if (arg.rfind("--anti-debug=", 0) == 0) {
+            options["antiDebug"] = arg.substr(std::strlen("--anti-debug="));
+            if (options["antiDebug"] != "check" && options["antiDebug"] != "monitor") {
+                std::cerr << "Error: Unknown mode in " << arg << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--anti-debug-interval=", 0) == 0) {
+            options["antiDebugInterval"] =
+                std::to_string(std::max(1, std::atoi(arg.c_str() + std::strlen("--anti-debug-interval="))));
+        } else if (arg.rfind("--project=", 0) == 0) {
+            project = arg.substr(std::strlen("--project="));
+        } else if (arg.rfind("--out=", 0) == 0) {
+            outDir = arg.substr(std::strlen("--out="));
+        } else if (arg.rfind("--jobs=", 0) == 0) {
+            jobs = std::max(1, std::atoi(arg.c_str() + std::strlen("--jobs=")));
+        } else if (arg == "--deterministic") {
+            options["deterministic"] = "1";
+        } else if (arg.rfind("--profile=", 0) == 0) {
+            profilePath = arg.substr(std::strlen("--profile="));
+        } else if (arg.rfind("--overhead-budget=", 0) == 0) {
+            overheadBudget = std::max(0.0, std::atof(arg.c_str() + std::strlen("--overhead-budget=")));
+        } else if (arg.rfind("--full-cost=", 0) == 0) {
+            fullCost = std::max(0.0, std::atof(arg.c_str() + std::strlen("--full-cost=")));
+        } else if (arg.rfind("--light-cost=", 0) == 0) {
+            lightCost = std::max(0.0, std::atof(arg.c_str() + std::strlen("--light-cost=")));
+        } else if (arg.rfind("--preserve=", 0) == 0) {
+            preservePath = arg.substr(std::strlen("--preserve="));
+        } else if (arg.rfind("--passes=", 0) == 0) {
+            unsigned passes = 0;
+            options["passes"] = arg.substr(std::strlen("--passes="));
+            if (!parsePassList(options["passes"], passes)) {
+                std::cerr << "Error: Unknown pass in " << arg << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--cache=", 0) == 0) {
+            cacheDir = arg.substr(std::strlen("--cache="));
+        } else if (arg == "--serve") {
+            serve = true;
+        } else if (arg.rfind("--serve=", 0) == 0) {
+            serve = true;
+            socketPath = arg.substr(std::strlen("--serve="));
+        } else if (inputFile.empty()) {
+            inputFile = arg;
+        }
+    }
+    
+    if (inputFile.empty() && project.empty() && !serve) {
         std::cout << "Usage: " << argv[0] << " <input_file> [options]" << std::endl;
+        std::cout << "       " << argv[0] << " --project=<dir|compile_commands.json> [--out=DIR] [--jobs=N] [options]" << std::endl;
+        std::cout << "       " << argv[0] << " --serve[=SOCKET] [--jobs=N] [options]" << std::endl;
+        std::cout << "Options:" << std::endl;
+        std::cout << "  --stats[=FILE]              Write per-pass timing, allocation and memory statistics" << std::endl;
+        std::cout << "                              as JSON to FILE (default: stderr)" << std::endl;
+        std::cout << "  --string-mode=MODE          How encrypted literals are emitted:" << std::endl;
+        std::cout << "                                static    decrypted before main (default)" << std::endl;
+        std::cout << "                                lazy      decrypted on first use" << std::endl;
+        std::cout << "                                constexpr encrypted at compile time, no OpenSSL" << std::endl;
+        std::cout << "  --anti-debug=MODE           How the anti-debugging pass checks for a debugger:" << std::endl;
+        std::cout << "                                check     once, at the top of main (default)" << std::endl;
+        std::cout << "                                monitor   on a background thread, periodically" << std::endl;
+        std::cout << "  --anti-debug-interval=MS    Milliseconds between monitor checks (default: 100)" << std::endl;
+        std::cout << "  --passes=LIST               Run only these passes (default: all): strings, identifiers," << std::endl;
+        std::cout << "                              controlflow, deadcode, antidebug" << std::endl;
+        std::cout << "  --profile=FILE              CPU profile (perf script, gprof flat or a list of hot" << std::endl;
+        std::cout << "                              functions); hot functions get lighter protection" << std::endl;
+        std::cout << "  --overhead-budget=PERCENT   Estimated runtime overhead allowed with --profile (default: 2)" << std::endl;
+        std::cout << "  --full-cost=PERCENT         Slowdown of a function's own time with full protection (default: "
+                  << ObfuscationProfile::kFullCost << ")" << std::endl;
+        std::cout << "  --light-cost=PERCENT        The same with control flow only (default: " << ObfuscationProfile::kLightCost
+                  << "); measure both with benchmark_runtime.js" << std::endl;
+        std::cout << "  --preserve=FILE             Never rename the names listed in FILE (whitespace-separated," << std::endl;
+        std::cout << "                              '#' comments), in addition to keywords and library names" << std::endl;
+        std::cout << "  --project=PATH              Obfuscate a source tree or compile_commands.json" << std::endl;
+        std::cout << "  --out=DIR                   Output directory for project mode (default: obfuscated)" << std::endl;
+        std::cout << "  --jobs=N                    Worker threads for project mode, or for the string pass of a" << std::endl;
+        std::cout << "                              single file (default: all cores)" << std::endl;
+        std::cout << "  --cache=DIR                 Reuse outputs of unchanged files from DIR" << std::endl;
+        std::cout << "  --deterministic             Derive all randomness from the key; identical input gives identical output" << std::endl;
+        std::cout << "  --serve[=SOCKET]            Keep running and answer length-framed requests on stdin/stdout," << std::endl;
+        std::cout << "                              or on a Unix socket; --jobs sets the worker count" << std::endl;
+        return 1;
+    }
+    
+    if (!preservePath.empty() && !NameSet::readList(preservePath, options["preserve"])) {
+        std::cerr << "Error: Cannot open preserve list " << preservePath << std::endl;
         return 1;
     }
     
+    std::shared_ptr<ObfuscationProfile> profile;
+    if (!profilePath.empty()) {
+        profile = std::make_shared<ObfuscationProfile>();
+        if (!ObfuscationProfile::load(profilePath, overheadBudget, fullCost, lightCost, *profile)) {
+            std::cerr << "Error: Cannot open profile " << profilePath << std::endl;
+            return 1;
+        }
+        profile->summary(std::cerr);
+        options["profile"] = profile->fingerprint();  // part of the cache key
+    }
+    
+    if (serve) {
+        std::signal(SIGPIPE, SIG_IGN);  // a client that hangs up only fails its own writes
+        ObfuscationServer server(options, jobs, profile);
+        if (!socketPath.empty()) {
+            return server.serveSocket(socketPath);
+        }
+        server.serve(STDIN_FILENO, STDOUT_FILENO);
+        return 0;
+    }
+    
+    if (!project.empty()) {
+        return runProject(project, outDir, jobs, options, cacheDir, statsPath, profile);
+    }
+    
     // Read input file
-    std::ifstream file(argv[1]);
+    std::ifstream file(inputFile);
     if (!file.is_open()) {
-        std::cerr << "Error: Cannot open file " << argv[1] << std::endl;
+        std::cerr << "Error: Cannot open file " << inputFile << std::endl;
         return 1;
     }
     
@@ -488,17 +3463,41 @@ int main(int argc, char* argv[]) {
     std::string code = buffer.str();
     file.close();
     
-    // Initialize processor with options
-    std::map<std::string, std::string> options;
-    options["encryptionKey"] = "default_encryption_key_32_chars_";
-    
     CppProcessor processor(options);
+    processor.setProfile(profile);
+    processor.setLiteralJobs(jobs);
+    if (!statsPath.empty()) {
+        processor.enableStats();
+    }
+    auto start = std::chrono::steady_clock::now();
     
-    // Process the code
-    std::string obfuscated = processor.process(code);
+    // Process the code unless the cache already has it
+    std::unique_ptr<ObfuscationCache> cache;
+    std::string cacheKey;
+    CacheEntry entry;
+    if (!cacheDir.empty()) {
+        cache.reset(new ObfuscationCache(cacheDir));
+        cacheKey = ObfuscationCache::key(code, options);
+    }
+    if (!cache || !cache->load(cacheKey, entry)) {
+        entry.output = processor.process(code);
+        if (cache) {
+            processor.exportSymbols(entry);
+            cache->store(cacheKey, entry);
+        }
+    }
+    const std::string& obfuscated = entry.output;
     
     // Output result
     std::cout << obfuscated << std::endl;
     
+    if (!statsPath.empty()) {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!writeStats(*processor.getStats(), elapsed, statsPath)) {
+            return 1;
+        }
+    }
+    
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -0,0 +1,158 @@
+#ifndef NAME_GENERATOR_H
+#define NAME_GENERATOR_H
+
+// Collision-free obfuscated names, shared by the C and C++ processors.
+//
+// A counter is mapped through a keyed Feistel permutation and spelled as an
+// identifier: an uppercase letter, a lowercase letter, then base62 digits.
+// The first 676 names have two characters, the next 41912 three, and so on,
+// so names only grow with the number of symbols. Distinct counters always
+// give distinct names, and the mixed-case prefix keeps them clear of
+// keywords, standard library names and all-caps macros.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define NAME_GENERATOR_MIN_LENGTH 2
+#define NAME_GENERATOR_MAX_LENGTH 10
+#define NAME_GENERATOR_BUFFER_SIZE (NAME_GENERATOR_MAX_LENGTH + 1)
+#define NAME_GENERATOR_ROUNDS 4
+
+typedef struct {
+    uint64_t keys[NAME_GENERATOR_ROUNDS];
+    uint64_t counter;
+} NameGenerator;
+
+static const char nameGeneratorDigits[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+static inline uint64_t nameGeneratorMix(uint64_t x) {
+    // splitmix64 finalizer
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+static inline uint64_t nameGeneratorPower62(int exponent) {
+    uint64_t result = 1;
+    while (exponent-- > 0) {
+        result *= 62;
+    }
+    return result;
+}
+
+// Derive the round keys from an arbitrary byte string, e.g. the encryption
+// key. The same key always yields the same sequence of names.
+static inline void nameGeneratorInit(NameGenerator* generator, const char* key, size_t length) {
+    uint64_t hash = 14695981039346656037ull;  // FNV-1a
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 1099511628211ull;
+    }
+    for (int r = 0; r < NAME_GENERATOR_ROUNDS; r++) {
+        hash = nameGeneratorMix(hash + (uint64_t)r);
+        generator->keys[r] = hash;
+    }
+    generator->counter = 0;
+}
+
+// Names of one length form the domain A x B with |A| = 26 * 62^p and
+// |B| = 26 * 62^q. Each round maps (x, y) in Z_m x Z_n to
+// (y, (x + F(y)) mod m) in Z_n x Z_m, so an even number of rounds is a
+// bijection on the domain without cycle walking.
+static inline void nameGeneratorHalves(int length, uint64_t* a, uint64_t* b) {
+    int p = (length - 2) / 2;
+    *a = 26 * nameGeneratorPower62(p);
+    *b = 26 * nameGeneratorPower62(length - 2 - p);
+}
+
+static inline uint64_t nameGeneratorPermute(const NameGenerator* generator, int length, uint64_t index) {
+    uint64_t a, b;
+    nameGeneratorHalves(length, &a, &b);
+    uint64_t m = a, n = b;
+    uint64_t x = index / b, y = index % b;
+    for (int r = 0; r < NAME_GENERATOR_ROUNDS; r++) {
+        uint64_t t = (x + nameGeneratorMix(y ^ generator->keys[r]) % m) % m;
+        x = y;
+        y = t;
+        uint64_t swap = m;
+        m = n;
+        n = swap;
+    }
+    return x * b + y;
+}
+
+static inline uint64_t nameGeneratorUnpermute(const NameGenerator* generator, int length, uint64_t value) {
+    uint64_t a, b;
+    nameGeneratorHalves(length, &a, &b);
+    uint64_t m = a, n = b;
+    uint64_t x = value / b, y = value % b;
+    for (int r = NAME_GENERATOR_ROUNDS - 1; r >= 0; r--) {
+        uint64_t swap = m;
+        m = n;
+        n = swap;
+        uint64_t previous = y;
+        y = x;
+        x = (previous + m - nameGeneratorMix(y ^ generator->keys[r]) % m) % m;
+    }
+    return x * b + y;
+}
+
+static inline uint64_t nameGeneratorBandSize(int length) {
+    return 676 * nameGeneratorPower62(length - 2);
+}
+
+// Write the next name into `out` (at least NAME_GENERATOR_BUFFER_SIZE bytes)
+// and return its length
+static inline size_t nameGeneratorNext(NameGenerator* generator, char* out) {
+    uint64_t index = generator->counter++;
+    int length = NAME_GENERATOR_MIN_LENGTH;
+    while (length < NAME_GENERATOR_MAX_LENGTH && index >= nameGeneratorBandSize(length)) {
+        index -= nameGeneratorBandSize(length);
+        length++;
+    }
+
+    uint64_t value = nameGeneratorPermute(generator, length, index % nameGeneratorBandSize(length));
+    out[0] = (char)('A' + value % 26);
+    value /= 26;
+    out[1] = (char)('a' + value % 26);
+    value /= 26;
+    for (int i = 2; i < length; i++) {
+        out[i] = nameGeneratorDigits[value % 62];
+        value /= 62;
+    }
+    out[length] = '\0';
+    return (size_t)length;
+}
+
+// Mark a name produced earlier with the same key as used, so the generator
+// never hands it out again. Used when renames are restored from a cache.
+static inline void nameGeneratorReserve(NameGenerator* generator, const char* name, size_t length) {
+    if (length < NAME_GENERATOR_MIN_LENGTH || length > NAME_GENERATOR_MAX_LENGTH ||
+        name[0] < 'A' || name[0] > 'Z' || name[1] < 'a' || name[1] > 'z') {
+        return;
+    }
+
+    uint64_t value = 0;
+    for (size_t i = length; i-- > 2;) {
+        const char* digit = NULL;
+        for (int d = 0; d < 62 && !digit; d++) {
+            digit = nameGeneratorDigits[d] == name[i] ? &nameGeneratorDigits[d] : NULL;
+        }
+        if (!digit) {
+            return;
+        }
+        value = value * 62 + (uint64_t)(digit - nameGeneratorDigits);
+    }
+    value = (value * 26 + (uint64_t)(name[1] - 'a')) * 26 + (uint64_t)(name[0] - 'A');
+
+    uint64_t index = nameGeneratorUnpermute(generator, (int)length, value);
+    for (int l = NAME_GENERATOR_MIN_LENGTH; l < (int)length; l++) {
+        index += nameGeneratorBandSize(l);
+    }
+    if (index >= generator->counter) {
+        generator->counter = index + 1;
+    }
+}
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef OBFUSCATOR_API_H
+#define OBFUSCATOR_API_H
+
+// C ABI of the native C and C++ processors, for use in-process (an N-API
+// addon, a build tool) instead of spawning a processor per file. Both
+// processors build into one shared or static library; see "Embedding" in
+// notes/USAGE.md.
+//
+// Input is a pointer and a length and is never copied. Output goes either
+// into a caller-provided buffer or, in pieces as it is produced, to a write
+// callback. A handle keeps its state between calls: cipher context, keyword
+// tables and the rename table, so an identifier is renamed the same way in
+// every file processed through the same handle. A handle must not be used by
+// two threads at once; create one per thread instead.
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OBFUSCATOR_API_VERSION 1
+
+#if defined(__GNUC__)
+#define OBFUSCATOR_API __attribute__((visibility("default")))
+#else
+#define OBFUSCATOR_API
+#endif
+
+typedef enum {
+    OBFUSCATOR_OK = 0,
+    OBFUSCATOR_INVALID_ARGUMENT,
+    OBFUSCATOR_BUFFER_TOO_SMALL,   // *outputLength holds the size needed
+    OBFUSCATOR_PROCESSING_FAILED,
+    OBFUSCATOR_OUT_OF_MEMORY,
+    OBFUSCATOR_WRITE_ABORTED       // the write callback returned non-zero
+} ObfuscatorStatus;
+
+// Settings of a handle; the same as the command-line flags. Initialize with
+// obfuscatorOptionsInit() so fields added later get their defaults.
+typedef struct {
+    size_t structSize;             // sizeof(ObfuscatorOptions) of the caller
+    const char* encryptionKey;     // NULL: the built-in default key
+    const char* passes;            // as --passes; NULL: all passes
+    int deterministic;             // as --deterministic
+    const char* stringMode;        // C++ only, as --string-mode; NULL: static
+    const char* profilePath;       // as --profile; NULL: none
+    double overheadBudget;         // as --overhead-budget, in percent
+    const char* preservePath;      // as --preserve; NULL: none
+    const char* antiDebugMode;     // as --anti-debug; NULL: check
+    int antiDebugInterval;         // as --anti-debug-interval, in milliseconds
+    double fullCost;               // as --full-cost, in percent
+    double lightCost;              // as --light-cost, in percent
+} ObfuscatorOptions;
+
+// Receives output in order; return non-zero to stop processing
+typedef int (*ObfuscatorWriteFn)(void* context, const char* data, size_t length);
+
+typedef struct CObfuscator CObfuscator;
+typedef struct CppObfuscator CppObfuscator;
+
+static inline void obfuscatorOptionsInit(ObfuscatorOptions* options) {
+    options->structSize = sizeof(ObfuscatorOptions);
+    options->encryptionKey = NULL;
+    options->passes = NULL;
+    options->deterministic = 0;
+    options->stringMode = NULL;
+    options->profilePath = NULL;
+    options->overheadBudget = 2;
+    options->preservePath = NULL;
+    options->antiDebugMode = NULL;
+    options->antiDebugInterval = 100;
+    options->fullCost = 55;
+    options->lightCost = 5;
+}
+
+static inline const char* obfuscatorStatusString(ObfuscatorStatus status) {
+    switch (status) {
+    case OBFUSCATOR_OK: return "ok";
+    case OBFUSCATOR_INVALID_ARGUMENT: return "invalid argument";
+    case OBFUSCATOR_BUFFER_TOO_SMALL: return "output buffer too small";
+    case OBFUSCATOR_PROCESSING_FAILED: return "processing failed";
+    case OBFUSCATOR_OUT_OF_MEMORY: return "out of memory";
+    case OBFUSCATOR_WRITE_ABORTED: return "write aborted";
+    }
+    return "unknown status";
+}
+
+// Each processor has the same five calls.
+//
+// Create returns NULL when an option is invalid (an unknown pass, an
+// unreadable profile or preserve list, an unknown anti-debug mode) or memory
+// runs out; options may be NULL for defaults.
+//
+// Process writes the output into `output` when it fits in `capacity` bytes.
+// Otherwise it returns OBFUSCATOR_BUFFER_TOO_SMALL, keeps the output in the
+// handle, and CopyResult fetches it without processing again. Either way
+// *outputLength is the length of the output. The output is not
+// NUL-terminated.
+//
+// ProcessStream passes the output to `write` in pieces instead.
+OBFUSCATOR_API CObfuscator* cObfuscatorCreate(const ObfuscatorOptions* options);
+OBFUSCATOR_API void cObfuscatorDestroy(CObfuscator* obfuscator);
+OBFUSCATOR_API ObfuscatorStatus cObfuscatorProcess(CObfuscator* obfuscator, const char* source, size_t length,
+                                                   char* output, size_t capacity, size_t* outputLength);
+OBFUSCATOR_API ObfuscatorStatus cObfuscatorProcessStream(CObfuscator* obfuscator, const char* source, size_t length,
+                                                         ObfuscatorWriteFn write, void* context);
+OBFUSCATOR_API ObfuscatorStatus cObfuscatorCopyResult(CObfuscator* obfuscator, char* output, size_t capacity,
+                                                      size_t* outputLength);
+
+OBFUSCATOR_API CppObfuscator* cppObfuscatorCreate(const ObfuscatorOptions* options);
+OBFUSCATOR_API void cppObfuscatorDestroy(CppObfuscator* obfuscator);
+OBFUSCATOR_API ObfuscatorStatus cppObfuscatorProcess(CppObfuscator* obfuscator, const char* source, size_t length,
+                                                     char* output, size_t capacity, size_t* outputLength);
+OBFUSCATOR_API ObfuscatorStatus cppObfuscatorProcessStream(CppObfuscator* obfuscator, const char* source, size_t length,
+                                                           ObfuscatorWriteFn write, void* context);
+OBFUSCATOR_API ObfuscatorStatus cppObfuscatorCopyResult(CppObfuscator* obfuscator, char* output, size_t capacity,
+                                                        size_t* outputLength);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
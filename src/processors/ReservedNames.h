@@ -0,0 +1,109 @@
+// Generated by src/processors/generate_reserved_names.js; do not edit.
+#ifndef RESERVED_NAMES_H
+#define RESERVED_NAMES_H
+
+// Names the C processor never renames, as a perfect hash table: one slot
+// compare per lookup.
+
+#include <stddef.h>
+#include <string.h>
+
+#define RESERVED_NAME_COUNT 229
+#define RESERVED_NAME_SEED 0u
+#define RESERVED_NAME_BUCKETS 115
+#define RESERVED_NAME_SLOTS 512
+
+static const unsigned short reservedNameDisplacements[RESERVED_NAME_BUCKETS] = {
+    0, 0, 2, 2, 0, 0, 2, 0, 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 2, 0, 0, 1,
+    2, 0, 0, 2, 1, 2, 2, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 3, 0, 1, 0, 0, 0, 0, 3, 3, 0, 0, 0,
+    2, 0, 0, 0, 0, 1, 6, 0, 0, 1, 0, 0, 1, 3, 0, 1, 0, 2, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 3, 0, 3, 2,
+    3, 0, 2, 0, 1, 0, 0, 0, 4, 0, 3, 4, 1, 0, 0, 1, 2, 0, 0,
+};
+
+static const char* const reservedNameSlots[RESERVED_NAME_SLOTS] = {
+    NULL, "int", NULL, NULL, "math", "_exit", "pthread_mutex_unlock", NULL, NULL, "strncmp", NULL,
+    "pthread_t", NULL, NULL, "sprintf", "sqrt", "atol", "CLOCK_MONOTONIC", "_Imaginary", NULL,
+    NULL, NULL, NULL, NULL, NULL, NULL, "__FILE__", "pthread_mutex_t", "char", NULL, NULL,
+    "memcmp", "const", "fprintf", "unsigned", NULL, NULL, NULL, NULL, NULL, NULL, "ceil",
+    "CLOCKS_PER_SEC", NULL, NULL, NULL, "scanf", "vprintf", "_Generic", NULL, "stdint", NULL, NULL,
+    "double", NULL, "case", NULL, "atexit", "uint8_t", NULL, NULL, "memory_order_acquire", NULL,
+    "union", "ftell", "inline", "sscanf", NULL, "int64_t", NULL, "_Static_assert", "timespec",
+    NULL, "errno", NULL, NULL, "fflush", NULL, NULL, NULL, "stdbool", NULL, "uint64_t", NULL, NULL,
+    NULL, NULL, "ptrace", NULL, NULL, NULL, "exp", NULL, NULL, NULL, "exit", "isupper", NULL, NULL,
+    "va_start", NULL, "bool", "void", "pthread", "limits", NULL, "fscanf", "ctype", NULL, NULL,
+    "tv_sec", NULL, NULL, NULL, NULL, NULL, NULL, "endif", "O_RDONLY", NULL, "stdlib", NULL,
+    "open", NULL, NULL, NULL, NULL, "int8_t", NULL, "typedef", "uintptr_t", NULL, NULL, "pow",
+    NULL, NULL, "PTRACE_TRACEME", NULL, NULL, NULL, "fgets", "signed", "fgetc", NULL, NULL,
+    "pthread_mutex_lock", "ifdef", NULL, "strcat", NULL, "ptrdiff_t", NULL, NULL, NULL, NULL, NULL,
+    "memmove", NULL, NULL, "size_t", "time", "strrchr", NULL, NULL, "fabs", NULL, NULL, NULL, NULL,
+    NULL, NULL, NULL, "uint32_t", "CLOCK_REALTIME", NULL, "for", "assert", "int32_t", NULL, NULL,
+    "memory_order_relaxed", "fread", NULL, NULL, "fputs", NULL, NULL, "elif", NULL, "undef", NULL,
+    "intptr_t", "_Thread_local", NULL, "atoll", NULL, "realloc", "clock_gettime", NULL, "isspace",
+    "true", NULL, "do", NULL, "stddef", "strncpy", "ssize_t", NULL, "time_t", "static", NULL,
+    "register", NULL, NULL, NULL, "fwrite", NULL, NULL, "floor", NULL, NULL, "EVP_aes_256_ctr",
+    NULL, "EOF", "perror", NULL, NULL, NULL, NULL, "va_arg", NULL, NULL, NULL, NULL, NULL, NULL,
+    NULL, "rename", NULL, NULL, "putchar", NULL, "auto", NULL, "struct", "sin", NULL, NULL,
+    "isalpha", "float", NULL, NULL, "short", "uint16_t", "puts", NULL, NULL, "strstr",
+    "memory_order_release", NULL, NULL, NULL, NULL, "tv_nsec", NULL, NULL, "strcpy", "labs", NULL,
+    "stdatomic", "abs", "_Alignas", NULL, NULL, "rewind", "false", "strtoull", NULL, NULL, NULL,
+    "memset", NULL, NULL, NULL, "clock_t", NULL, "__LINE__", "strlen", NULL, NULL, NULL, NULL,
+    NULL, NULL, "stdin", "FILE", NULL, "signal", NULL, "strtod", NULL, NULL, NULL, NULL,
+    "snprintf", "log", NULL, "strdup", NULL, "isdigit", NULL, NULL, NULL, "toupper", "unistd",
+    NULL, "default", "fcntl", NULL, "pread", "atoi", NULL, NULL, NULL, "volatile", "isalnum",
+    "vsnprintf", NULL, NULL, NULL, "printf", NULL, "_Complex", NULL, "atomic_load_explicit", NULL,
+    "atomic_store_explicit", "include", NULL, NULL, NULL, NULL, "string", NULL, NULL, NULL, NULL,
+    NULL, NULL, "vfprintf", NULL, "ifndef", "fseek", "continue", NULL, NULL, "pthread_create",
+    "cos", "strcmp", NULL, "_Atomic", NULL, "va_end", NULL, "fputc", NULL, NULL, "if", "getchar",
+    "pragma", "define", "main", "islower", NULL, NULL, NULL, NULL, "EVP_CIPHER_CTX_new", NULL,
+    NULL, "break", "tolower", NULL, "calloc", "error", "EXIT_FAILURE", NULL, "EVP_DecryptInit_ex",
+    "PTHREAD_MUTEX_INITIALIZER", "rand", NULL, NULL, NULL, "strncat", "stdarg", "defined", NULL,
+    NULL, NULL, "atof", NULL, NULL, NULL, NULL, NULL, NULL, "strtol", NULL, NULL, "EXIT_SUCCESS",
+    "memchr", "restrict", NULL, NULL, NULL, NULL, "EVP_CIPHER_CTX_free", NULL, NULL, NULL, "else",
+    "enum", NULL, "strerror", "extern", NULL, "stdout", "while", NULL, "strchr", "srand", "fclose",
+    "bsearch", NULL, NULL, NULL, NULL, NULL, NULL, "nanosleep", NULL, NULL, "strtok", NULL,
+    "O_CLOEXEC", "clock", NULL, NULL, "EVP_CIPHER_CTX", "switch", NULL, NULL, "long", NULL,
+    "malloc", NULL, "qsort", "remove", "memcpy", NULL, NULL, NULL, "stderr", NULL, "_Bool", NULL,
+    NULL, NULL, "system", NULL, NULL, "va_list", "goto", NULL, "strtoul", "pthread_detach",
+    "close", NULL, "abort", NULL, "NULL", "stdio", NULL, "__func__", NULL, NULL, NULL,
+    "EVP_DecryptUpdate", NULL, "_POSIX_C_SOURCE", NULL, NULL, "_Alignof", NULL, "int16_t", NULL,
+    NULL, "return", NULL, "_Noreturn", "getenv", "sizeof", NULL, NULL, NULL, NULL, NULL, NULL,
+    "strtoll", NULL, "fopen", "free",
+};
+
+static const unsigned char reservedNameLengths[RESERVED_NAME_SLOTS] = {
+    0, 3, 0, 0, 4, 5, 20, 0, 0, 7, 0, 9, 0, 0, 7, 4, 4, 15, 10, 0, 0, 0, 0, 0, 0, 0, 8, 15, 4, 0,
+    0, 6, 5, 7, 8, 0, 0, 0, 0, 0, 0, 4, 14, 0, 0, 0, 5, 7, 8, 0, 6, 0, 0, 6, 0, 4, 0, 6, 7, 0, 0,
+    20, 0, 5, 5, 6, 6, 0, 7, 0, 14, 8, 0, 5, 0, 0, 6, 0, 0, 0, 7, 0, 8, 0, 0, 0, 0, 6, 0, 0, 0, 3,
+    0, 0, 0, 4, 7, 0, 0, 8, 0, 4, 4, 7, 6, 0, 6, 5, 0, 0, 6, 0, 0, 0, 0, 0, 0, 5, 8, 0, 6, 0, 4, 0,
+    0, 0, 0, 6, 0, 7, 9, 0, 0, 3, 0, 0, 14, 0, 0, 0, 5, 6, 5, 0, 0, 18, 5, 0, 6, 0, 9, 0, 0, 0, 0,
+    0, 7, 0, 0, 6, 4, 7, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 8, 14, 0, 3, 6, 7, 0, 0, 20, 5, 0, 0, 5, 0,
+    0, 4, 0, 5, 0, 8, 13, 0, 5, 0, 7, 13, 0, 7, 4, 0, 2, 0, 6, 7, 7, 0, 6, 6, 0, 8, 0, 0, 0, 6, 0,
+    0, 5, 0, 0, 15, 0, 3, 6, 0, 0, 0, 0, 6, 0, 0, 0, 0, 0, 0, 0, 6, 0, 0, 7, 0, 4, 0, 6, 3, 0, 0,
+    7, 5, 0, 0, 5, 8, 4, 0, 0, 6, 20, 0, 0, 0, 0, 7, 0, 0, 6, 4, 0, 9, 3, 8, 0, 0, 6, 5, 8, 0, 0,
+    0, 6, 0, 0, 0, 7, 0, 8, 6, 0, 0, 0, 0, 0, 0, 5, 4, 0, 6, 0, 6, 0, 0, 0, 0, 8, 3, 0, 6, 0, 7, 0,
+    0, 0, 7, 6, 0, 7, 5, 0, 5, 4, 0, 0, 0, 8, 7, 9, 0, 0, 0, 6, 0, 8, 0, 20, 0, 21, 7, 0, 0, 0, 0,
+    6, 0, 0, 0, 0, 0, 0, 8, 0, 6, 5, 8, 0, 0, 14, 3, 6, 0, 7, 0, 6, 0, 5, 0, 0, 2, 7, 6, 6, 4, 7,
+    0, 0, 0, 0, 18, 0, 0, 5, 7, 0, 6, 5, 12, 0, 18, 25, 4, 0, 0, 0, 7, 6, 7, 0, 0, 0, 4, 0, 0, 0,
+    0, 0, 0, 6, 0, 0, 12, 6, 8, 0, 0, 0, 0, 19, 0, 0, 0, 4, 4, 0, 8, 6, 0, 6, 5, 0, 6, 5, 6, 7, 0,
+    0, 0, 0, 0, 0, 9, 0, 0, 6, 0, 9, 5, 0, 0, 14, 6, 0, 0, 4, 0, 6, 0, 5, 6, 6, 0, 0, 0, 6, 0, 5,
+    0, 0, 0, 6, 0, 0, 7, 4, 0, 7, 14, 5, 0, 5, 0, 4, 5, 0, 8, 0, 0, 0, 17, 0, 15, 0, 0, 8, 0, 7, 0,
+    0, 6, 0, 9, 6, 6, 0, 0, 0, 0, 0, 0, 7, 0, 5, 4,
+};
+
+static inline unsigned int reservedNameMix(unsigned int x) {
+    // murmur3 finalizer
+    x = (x ^ (x >> 16)) * 0x85ebca6bu;
+    x = (x ^ (x >> 13)) * 0xc2b2ae35u;
+    return x ^ (x >> 16);
+}
+
+// Whether the `length` bytes at `name` are a reserved name; `hash` is
+// their 32-bit FNV-1a hash
+static inline int reservedNameFind(const char* name, size_t length, unsigned int hash) {
+    unsigned int seeded = hash ^ RESERVED_NAME_SEED;
+    unsigned int displacement = reservedNameDisplacements[reservedNameMix(seeded) % RESERVED_NAME_BUCKETS];
+    unsigned int slot = reservedNameMix(seeded + (displacement + 1u) * 0x9e3779b9u) & (RESERVED_NAME_SLOTS - 1);
+    return reservedNameLengths[slot] == length && memcmp(reservedNameSlots[slot], name, length) == 0;
+}
+
+#endif
@@ -0,0 +1,184 @@
+const fs = require('fs');
+const path = require('path');
+
+// Generates ReservedNames.h, the CProcessor's perfect hash table of names
+// that are never renamed.
+//
+// Usage: node src/processors/generate_reserved_names.js
+//
+// Hash-and-displace: a name's FNV-1a hash (the hash the identifier table
+// already computes) is mixed with a seed to pick a bucket, and each bucket
+// keeps the first displacement that sends all of its names to free slots.
+// A lookup then compares the name with a single slot. Edit the list below
+// and rerun; the output is deterministic.
+
+const names = [
+  // Keywords
+  'auto', 'break', 'case', 'char', 'const', 'continue', 'default', 'do',
+  'double', 'else', 'enum', 'extern', 'float', 'for', 'goto', 'if',
+  'int', 'long', 'register', 'return', 'short', 'signed', 'sizeof', 'static',
+  'struct', 'switch', 'typedef', 'union', 'unsigned', 'void', 'volatile', 'while',
+  'inline', 'restrict', '_Bool', '_Complex', '_Imaginary', '_Alignas', '_Alignof',
+  '_Atomic', '_Generic', '_Noreturn', '_Static_assert', '_Thread_local',
+  'main',
+  // Preprocessor
+  'include', 'define', 'undef', 'ifdef', 'ifndef', 'elif', 'endif', 'pragma', 'error', 'defined',
+  'NULL', 'EOF', 'EXIT_SUCCESS', 'EXIT_FAILURE', '__FILE__', '__LINE__', '__func__',
+  // Headers
+  'stdio', 'stdlib', 'string', 'stddef', 'stdint', 'stdbool', 'stdarg', 'math', 'ctype',
+  'errno', 'assert', 'limits', 'signal', 'unistd', 'pthread', 'fcntl',
+  // Types and objects
+  'bool', 'true', 'false', 'size_t', 'ssize_t', 'ptrdiff_t', 'intptr_t', 'uintptr_t',
+  'int8_t', 'int16_t', 'int32_t', 'int64_t', 'uint8_t', 'uint16_t', 'uint32_t', 'uint64_t',
+  'FILE', 'stdin', 'stdout', 'stderr', 'va_list', 'va_start', 'va_arg', 'va_end',
+  // stdio.h, stdlib.h
+  'printf', 'fprintf', 'sprintf', 'snprintf', 'vprintf', 'vfprintf', 'vsnprintf',
+  'puts', 'fputs', 'putchar', 'fputc', 'getchar', 'fgetc', 'fgets', 'scanf', 'sscanf', 'fscanf',
+  'fopen', 'fclose', 'fread', 'fwrite', 'fflush', 'fseek', 'ftell', 'rewind', 'perror', 'remove', 'rename',
+  'malloc', 'calloc', 'realloc', 'free', 'exit', 'abort', 'atexit', 'getenv', 'system',
+  'atoi', 'atol', 'atoll', 'atof', 'strtol', 'strtoul', 'strtoll', 'strtoull', 'strtod',
+  'abs', 'labs', 'rand', 'srand', 'qsort', 'bsearch',
+  // string.h, ctype.h, math.h
+  'memcpy', 'memmove', 'memset', 'memcmp', 'memchr', 'strlen', 'strcpy', 'strncpy', 'strcat', 'strncat',
+  'strcmp', 'strncmp', 'strchr', 'strrchr', 'strstr', 'strdup', 'strtok', 'strerror',
+  'isalpha', 'isdigit', 'isalnum', 'isspace', 'isupper', 'islower', 'toupper', 'tolower',
+  'sqrt', 'pow', 'fabs', 'floor', 'ceil', 'sin', 'cos', 'exp', 'log',
+  // time.h
+  'time', 'clock', 'time_t', 'clock_t', 'CLOCKS_PER_SEC', 'clock_gettime', 'timespec', 'tv_sec', 'tv_nsec',
+  'CLOCK_MONOTONIC', 'CLOCK_REALTIME',
+  // OpenSSL, called by the encrypted string runtime
+  'EVP_CIPHER_CTX', 'EVP_CIPHER_CTX_new', 'EVP_CIPHER_CTX_free', 'EVP_DecryptInit_ex', 'EVP_DecryptUpdate',
+  'EVP_aes_256_ctr',
+  // POSIX, called by the anti-debugging runtimes
+  '_POSIX_C_SOURCE', 'ptrace', 'PTRACE_TRACEME', 'open', 'close', 'pread', 'O_RDONLY', 'O_CLOEXEC', 'nanosleep', '_exit',
+  'pthread_t', 'pthread_create', 'pthread_detach',
+  // Locking and atomics of the encrypted string runtime
+  'pthread_mutex_t', 'PTHREAD_MUTEX_INITIALIZER', 'pthread_mutex_lock', 'pthread_mutex_unlock', 'stdatomic',
+  'atomic_load_explicit', 'atomic_store_explicit', 'memory_order_relaxed', 'memory_order_acquire',
+  'memory_order_release'
+];
+
+function fnv1a(name) {
+  let hash = 2166136261;
+  for (const byte of Buffer.from(name)) {
+    hash = Math.imul(hash ^ byte, 16777619) >>> 0;
+  }
+  return hash;
+}
+
+// murmur3 finalizer
+function mix(x) {
+  x = Math.imul(x ^ (x >>> 16), 0x85ebca6b) >>> 0;
+  x = Math.imul(x ^ (x >>> 13), 0xc2b2ae35) >>> 0;
+  return (x ^ (x >>> 16)) >>> 0;
+}
+
+function slotOf(hash, seed, displacement, slots) {
+  return mix((((hash ^ seed) >>> 0) + Math.imul(displacement + 1, 0x9e3779b9)) >>> 0) & (slots - 1);
+}
+
+function build(seed, slotCount, bucketCount) {
+  const buckets = Array.from({ length: bucketCount }, () => []);
+  for (const name of names) {
+    buckets[mix((fnv1a(name) ^ seed) >>> 0) % bucketCount].push(name);
+  }
+  const slots = new Array(slotCount).fill(null);
+  const displacements = new Array(bucketCount).fill(0);
+  const byBucketSize = [...buckets.keys()].sort((a, b) => buckets[b].length - buckets[a].length || a - b);
+  for (const b of byBucketSize) {
+    let displacement = 0;
+    for (;; displacement++) {
+      if (displacement === 0xffff) {
+        return null;
+      }
+      const taken = buckets[b].map(name => slotOf(fnv1a(name), seed, displacement, slotCount));
+      if (taken.every((slot, i) => slots[slot] === null && taken.indexOf(slot) === i)) {
+        break;
+      }
+    }
+    for (const name of buckets[b]) {
+      slots[slotOf(fnv1a(name), seed, displacement, slotCount)] = name;
+    }
+    displacements[b] = displacement;
+  }
+  return { seed, slots, displacements };
+}
+
+function wrap(items, indent, width = 100) {
+  const lines = [];
+  let line = indent;
+  for (const item of items) {
+    if (line.length + item.length + 1 > width && line.trim()) {
+      lines.push(line.trimEnd());
+      line = indent;
+    }
+    line += item + ' ';
+  }
+  lines.push(line.trimEnd());
+  return lines.join('\n');
+}
+
+function main() {
+  if (new Set(names).size !== names.length || new Set(names.map(fnv1a)).size !== names.length) {
+    throw new Error('duplicate name or FNV-1a hash in the list');
+  }
+  let slotCount = 2;
+  while (slotCount < 2 * names.length) {
+    slotCount *= 2;
+  }
+  const bucketCount = Math.floor(names.length / 2) + 1;
+  let table = null;
+  for (let seed = 0; !table; seed++) {
+    table = build(seed, slotCount, bucketCount);
+  }
+
+  const header = `// Generated by src/processors/generate_reserved_names.js; do not edit.
+#ifndef RESERVED_NAMES_H
+#define RESERVED_NAMES_H
+
+// Names the C processor never renames, as a perfect hash table: one slot
+// compare per lookup.
+
+#include <stddef.h>
+#include <string.h>
+
+#define RESERVED_NAME_COUNT ${names.length}
+#define RESERVED_NAME_SEED ${table.seed}u
+#define RESERVED_NAME_BUCKETS ${bucketCount}
+#define RESERVED_NAME_SLOTS ${slotCount}
+
+static const unsigned short reservedNameDisplacements[RESERVED_NAME_BUCKETS] = {
+${wrap(table.displacements.map(d => `${d},`), '    ')}
+};
+
+static const char* const reservedNameSlots[RESERVED_NAME_SLOTS] = {
+${wrap(table.slots.map(name => (name === null ? 'NULL,' : `"${name}",`)), '    ')}
+};
+
+static const unsigned char reservedNameLengths[RESERVED_NAME_SLOTS] = {
+${wrap(table.slots.map(name => `${name === null ? 0 : Buffer.byteLength(name)},`), '    ')}
+};
+
+static inline unsigned int reservedNameMix(unsigned int x) {
+    // murmur3 finalizer
+    x = (x ^ (x >> 16)) * 0x85ebca6bu;
+    x = (x ^ (x >> 13)) * 0xc2b2ae35u;
+    return x ^ (x >> 16);
+}
+
+// Whether the \`length\` bytes at \`name\` are a reserved name; \`hash\` is
+// their 32-bit FNV-1a hash
+static inline int reservedNameFind(const char* name, size_t length, unsigned int hash) {
+    unsigned int seeded = hash ^ RESERVED_NAME_SEED;
+    unsigned int displacement = reservedNameDisplacements[reservedNameMix(seeded) % RESERVED_NAME_BUCKETS];
+    unsigned int slot = reservedNameMix(seeded + (displacement + 1u) * 0x9e3779b9u) & (RESERVED_NAME_SLOTS - 1);
+    return reservedNameLengths[slot] == length && memcmp(reservedNameSlots[slot], name, length) == 0;
+}
+
+#endif
+`;
+  fs.writeFileSync(path.join(__dirname, 'ReservedNames.h'), header);
+  console.log(`ReservedNames.h: ${names.length} names, ${slotCount} slots, seed ${table.seed}`);
+}
+
+main();